@@ -1,35 +1,473 @@
 /**
  * Wrapping for memory allocation functions
- * to exit on a failure with corresponding message.
+ * to exit on a failure with corresponding message (or jump, see `alloc_failure_catch').
+ * Also arena (bump) allocator for data with a common lifetime.
  *
  * @authors: Denis Chernikov, Vladislav Kuleykin
  */
 
+#include <pthread.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "alloc_wrap.h"
 
-void *my_malloc(size_t size, char *description)
+_Thread_local ALLOC_COUNTERS alloc_counters = {0, 0};
+
+/// Place allocation failures of the current thread jump to, NULL - exit.
+static _Thread_local ALLOC_FAILURE *failure_target = NULL;
+
+/// Profile of the allocations with one description.
+typedef struct
+{
+    const char *description;
+    /// Calls of `my_malloc' (and `my_realloc' of NULL)
+    size_t calls;
+    /// Calls of `my_realloc' of allocated memory
+    size_t reallocs;
+    size_t frees;
+    /// Sum of all the sizes requested
+    size_t total_bytes;
+    size_t live_bytes;
+    size_t peak_bytes;
+    /// Numbers of requests by size class
+    size_t sizes[ALLOC_PROFILE_SIZE_CLASSES];
+    /// Number of memory blocks grown by `my_realloc' at least once
+    size_t chains;
+    /// The most reallocations of one memory block
+    size_t longest_chain;
+    /// Sum of the sizes memory had before reallocations, the most `realloc' could copy
+    size_t regrown_bytes;
+}
+ALLOC_SITE;
+
+/// Memory allocated while profiling.
+typedef struct
+{
+    void *memory;
+    size_t size;
+    /// Index of the site in `sites'
+    size_t site;
+    /// Number of reallocations of the memory so far
+    size_t reallocs;
+}
+ALLOC_BLOCK;
+
+/// Is profiling on?
+static _Bool profiling = false;
+
+/// Guards everything of the profile below.
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/// Profiles by description.
+static ALLOC_SITE *sites = NULL;
+static size_t site_number = 0, site_capacity = 0;
+
+/// Live memory (open addressing, linear probing), number of slots is a power of 2.
+static ALLOC_BLOCK *blocks = NULL;
+static size_t block_number = 0, block_capacity = 0;
+
+/// Live bytes of all the sites, now and at most.
+static size_t live_bytes = 0, peak_bytes = 0;
+
+/// Allocate memory of the profile itself, exits on a failure.
+///
+/// \param memory Memory to reallocate, may be NULL
+/// \param size Size to allocate
+/// \return New allocated memory
+static void *profile_realloc(void *memory, size_t size)
 {
-    void *res = malloc(size);
+    void *res = realloc(memory, size);
     if (!res)
     {
         fprintf(stderr, "FATAL ERROR!\n"
-                        "Memory for %s cannot be allocated!\n", description);
+                        "Memory for allocation profile cannot be allocated!\n");
         exit(-1);
     }
     return res;
 }
 
-void *my_realloc(void *memory, size_t size, char *description)
+/// Get the index of the size class.
+///
+/// \param size Size requested
+/// \return Index of its class
+static size_t size_class(size_t size)
 {
+    size_t res = 0;
+    for (size_t limit = 16; res < ALLOC_PROFILE_SIZE_CLASSES - 1 && size > limit; limit *= 4) ++res;
+    return res;
+}
+
+/// Find or add the profile of the description. NOTE: `profile_lock' must be held.
+///
+/// \param description Description of an allocation
+/// \return Index of the profile in `sites'
+static size_t find_site(const char *description)
+{
+    for (size_t i = 0; i < site_number; ++i)
+    {
+        if (sites[i].description == description || strcmp(sites[i].description, description) == 0) return i;
+    }
+    if (site_number == site_capacity)
+    {
+        site_capacity = site_capacity ? site_capacity * 2 : 64;
+        sites = (ALLOC_SITE *) profile_realloc(sites, sizeof(ALLOC_SITE) * site_capacity);
+    }
+    memset(&sites[site_number], 0, sizeof(ALLOC_SITE));
+    sites[site_number].description = description;
+    return site_number++;
+}
+
+/// Home slot of the memory in `blocks'.
+///
+/// \param memory Allocated memory
+/// \return Index of the slot
+static size_t block_home(const void *memory)
+{
+    return (size_t) (((uint64_t) (uintptr_t) memory >> 4) * UINT64_C(0x9E3779B97F4A7C15) >> 20)
+           & (block_capacity - 1);
+}
+
+/// Find the slot of the memory. NOTE: `profile_lock' must be held, `blocks' must have a free slot.
+///
+/// \param memory Allocated memory
+/// \return Slot of the memory, or the empty one where it would be
+static ALLOC_BLOCK *find_block(const void *memory)
+{
+    size_t i = block_home(memory);
+    while (blocks[i].memory && blocks[i].memory != memory) i = (i + 1) & (block_capacity - 1);
+    return &blocks[i];
+}
+
+/// Forget the memory, its live bytes are taken from its site. NOTE: `profile_lock' must be held.
+///
+/// \param slot Occupied slot of `blocks'
+static void remove_block(ALLOC_BLOCK *slot)
+{
+    sites[slot->site].live_bytes -= slot->size;
+    live_bytes -= slot->size;
+    --block_number;
+    // Move back the following blocks which would not be found past the hole otherwise
+    size_t hole = (size_t) (slot - blocks);
+    for (size_t i = (hole + 1) & (block_capacity - 1); blocks[i].memory; i = (i + 1) & (block_capacity - 1))
+    {
+        size_t home = block_home(blocks[i].memory);
+        if (((i - home) & (block_capacity - 1)) >= ((i - hole) & (block_capacity - 1)))
+        {
+            blocks[hole] = blocks[i];
+            hole = i;
+        }
+    }
+    blocks[hole].memory = NULL;
+}
+
+/// Double the number of slots of `blocks'. NOTE: `profile_lock' must be held.
+static void grow_blocks()
+{
+    ALLOC_BLOCK *old = blocks;
+    size_t old_capacity = block_capacity;
+    block_capacity = old_capacity ? old_capacity * 2 : 4096;
+    blocks = (ALLOC_BLOCK *) profile_realloc(NULL, sizeof(ALLOC_BLOCK) * block_capacity);
+    memset(blocks, 0, sizeof(ALLOC_BLOCK) * block_capacity);
+    for (size_t i = 0; i < old_capacity; ++i)
+    {
+        if (old[i].memory) *find_block(old[i].memory) = old[i];
+    }
+    free(old);
+}
+
+/// `realloc' recording the request in the profile. The lock is held around it,
+/// so nobody gets the same memory before it is recorded.
+///
+/// \param memory Memory to reallocate, NULL - allocate
+/// \param size Size to allocate
+/// \param description Description of the allocation
+/// \return New allocated memory, NULL on a failure
+static void *profiled_realloc(void *memory, size_t size, const char *description)
+{
+    pthread_mutex_lock(&profile_lock);
+    if ((block_number + 1) * 2 > block_capacity) grow_blocks();
+    // The old memory is looked up while it is still allocated, and put back if it stays
+    ALLOC_BLOCK old = {NULL, 0, 0, 0};
+    if (memory)
+    {
+        ALLOC_BLOCK *slot = find_block(memory);
+        old = *slot;
+        if (slot->memory) remove_block(slot);
+    }
     void *res = realloc(memory, size);
     if (!res)
     {
-        fprintf(stderr, "FATAL ERROR!\n"
-                        "Memory for %s cannot be reallocated!\n", description);
-        exit(-1);
+        if (old.memory)
+        {
+            *find_block(memory) = old;
+            ++block_number;
+            sites[old.site].live_bytes += old.size;
+            live_bytes += old.size;
+        }
+        pthread_mutex_unlock(&profile_lock);
+        return NULL;
     }
+    size_t site_index = find_site(description);
+    ALLOC_SITE *site = &sites[site_index];
+    size_t reallocs = 0;
+    if (memory)
+    {
+        ++site->reallocs;
+        if (old.memory)
+        {
+            reallocs = old.reallocs;
+            site->regrown_bytes += old.size;
+        }
+        if (++reallocs == 1) ++site->chains;
+        if (reallocs > site->longest_chain) site->longest_chain = reallocs;
+    }
+    else
+    {
+        ++site->calls;
+    }
+    site->total_bytes += size;
+    ++site->sizes[size_class(size)];
+
+    ALLOC_BLOCK *slot = find_block(res);
+    if (slot->memory)
+    {
+        // Freed by plain `free' and given out again
+        sites[slot->site].live_bytes -= slot->size;
+        live_bytes -= slot->size;
+    }
+    else
+    {
+        ++block_number;
+    }
+    *slot = (ALLOC_BLOCK) {res, size, site_index, reallocs};
+    site->live_bytes += size;
+    if (site->live_bytes > site->peak_bytes) site->peak_bytes = site->live_bytes;
+    live_bytes += size;
+    if (live_bytes > peak_bytes) peak_bytes = live_bytes;
+    pthread_mutex_unlock(&profile_lock);
     return res;
 }
+
+/// `free' recording it in the profile.
+///
+/// \param memory Memory to release
+static void profiled_free(void *memory)
+{
+    pthread_mutex_lock(&profile_lock);
+    if (block_capacity)
+    {
+        ALLOC_BLOCK *slot = find_block(memory);
+        if (slot->memory)
+        {
+            ++sites[slot->site].frees;
+            remove_block(slot);
+        }
+    }
+    free(memory);
+    pthread_mutex_unlock(&profile_lock);
+}
+
+void alloc_profile_start()
+{
+    profiling = true;
+}
+
+/// Compare profiles by total bytes, descending, for `qsort'.
+static int by_total_bytes(const void *a, const void *b)
+{
+    size_t ta = ((const ALLOC_SITE *) a)->total_bytes, tb = ((const ALLOC_SITE *) b)->total_bytes;
+    return ta > tb ? -1 : ta < tb;
+}
+
+void alloc_profile_write(FILE *out)
+{
+    pthread_mutex_lock(&profile_lock);
+    ALLOC_SITE *sorted = (ALLOC_SITE *) profile_realloc(NULL, sizeof(ALLOC_SITE) * (site_number + 1));
+    if (site_number) memcpy(sorted, sites, sizeof(ALLOC_SITE) * site_number);
+    ALLOC_SITE total = {"TOTAL"};
+    total.peak_bytes = peak_bytes;
+    pthread_mutex_unlock(&profile_lock);
+    qsort(sorted, site_number, sizeof(ALLOC_SITE), &by_total_bytes);
+
+    fprintf(out, "Allocation profile by description:\n"
+                 "%-40s %10s %10s %10s %14s %12s %12s %8s %8s %14s  %s\n",
+            "description", "calls", "reallocs", "frees", "total, B", "live, B", "peak, B",
+            "chains", "longest", "regrown, B", "sizes: <=16/64/256/1K/4K/16K/64K/more");
+    for (size_t i = 0; i <= site_number; ++i)
+    {
+        ALLOC_SITE *site = i < site_number ? &sorted[i] : &total;
+        fprintf(out, "%-40s %10zu %10zu %10zu %14zu %12zu %12zu %8zu %8zu %14zu  ",
+                site->description, site->calls, site->reallocs, site->frees, site->total_bytes, site->live_bytes,
+                site->peak_bytes, site->chains, site->longest_chain, site->regrown_bytes);
+        for (size_t c = 0; c < ALLOC_PROFILE_SIZE_CLASSES; ++c)
+        {
+            fprintf(out, c ? "/%zu" : "%zu", site->sizes[c]);
+            total.sizes[c] += site->sizes[c];
+        }
+        fprintf(out, "\n");
+        if (site == &total) break;
+        total.calls += site->calls;
+        total.reallocs += site->reallocs;
+        total.frees += site->frees;
+        total.total_bytes += site->total_bytes;
+        total.live_bytes += site->live_bytes;
+        total.chains += site->chains;
+        total.regrown_bytes += site->regrown_bytes;
+        if (site->longest_chain > total.longest_chain) total.longest_chain = site->longest_chain;
+    }
+    free(sorted);
+}
+
+ALLOC_FAILURE *alloc_failure_catch(ALLOC_FAILURE *failure)
+{
+    ALLOC_FAILURE *old = failure_target;
+    failure_target = failure;
+    return old;
+}
+
+_Noreturn void alloc_fail(const char *description)
+{
+    if (failure_target)
+    {
+        failure_target->description = description;
+        longjmp(failure_target->jump, 1);
+    }
+    fprintf(stderr, "FATAL ERROR!\n"
+                    "Memory for %s cannot be allocated!\n", description);
+    exit(-1);
+}
+
+void *my_malloc(size_t size, char *description)
+{
+    ++alloc_counters.calls;
+    alloc_counters.bytes += size;
+    void *res = profiling ? profiled_realloc(NULL, size, description) : malloc(size);
+    if (!res) alloc_fail(description);
+    return res;
+}
+
+void *my_realloc(void *memory, size_t size, char *description)
+{
+    ++alloc_counters.calls;
+    alloc_counters.bytes += size;
+    void *res = profiling ? profiled_realloc(memory, size, description) : realloc(memory, size);
+    if (!res) alloc_fail(description);
+    return res;
+}
+
+void my_free(void *memory)
+{
+    if (profiling && memory)
+    {
+        profiled_free(memory);
+    }
+    else
+    {
+        free(memory);
+    }
+}
+
+/// Alignment of every arena allocation.
+#define ARENA_ALIGN _Alignof(max_align_t)
+
+/// Round `n' up to the arena alignment.
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+/// Offset of the data inside of the block.
+#define ARENA_HEADER ARENA_ROUND(sizeof(ARENA_BLOCK))
+
+void arena_init(ARENA *arena)
+{
+    *arena = (ARENA) {NULL, NULL, 0, 0};
+}
+
+void *arena_alloc(ARENA *arena, size_t size, char *description)
+{
+    size = ARENA_ROUND(size ? size : 1);
+    ARENA_BLOCK *block = arena->head;
+    if (!block || block->size - block->used < size)
+    {
+        // Big requests get a block of their own behind the current one
+        _Bool own = size > ARENA_BLOCK_SIZE / 4;
+        size_t block_size = own ? size : ARENA_BLOCK_SIZE;
+        block = (ARENA_BLOCK *) my_malloc(ARENA_HEADER + block_size, description);
+        block->size = block_size;
+        block->used = 0;
+        arena->reserved += block_size;
+        if (own && arena->head)
+        {
+            block->next = arena->head->next;
+            arena->head->next = block;
+        }
+        else
+        {
+            block->next = arena->head;
+            arena->head = block;
+        }
+    }
+    void *res = (char *) block + ARENA_HEADER + block->used;
+    block->used += size;
+    arena->used += size;
+    arena->last = block == arena->head ? res : NULL;
+    return res;
+}
+
+void *arena_grow(ARENA *arena, void *memory, size_t old_size, size_t size, char *description)
+{
+    if (size <= old_size) return memory;
+    if (memory && memory == arena->last)
+    {
+        ARENA_BLOCK *block = arena->head;
+        size_t start = (char *) memory - ((char *) block + ARENA_HEADER);
+        size_t new_used = start + ARENA_ROUND(size);
+        if (new_used <= block->size)
+        {
+            arena->used += new_used - block->used;
+            block->used = new_used;
+            return memory;
+        }
+    }
+    void *res = arena_alloc(arena, size, description);
+    if (memory) memcpy(res, memory, old_size);
+    return res;
+}
+
+void arena_reset(ARENA *arena)
+{
+    ARENA_BLOCK *kept = NULL;
+    ARENA_BLOCK *block = arena->head;
+    while (block)
+    {
+        ARENA_BLOCK *next = block->next;
+        if (!kept && block->size == ARENA_BLOCK_SIZE)
+        {
+            kept = block;
+        }
+        else
+        {
+            my_free(block);
+        }
+        block = next;
+    }
+    arena->head = kept;
+    arena->last = NULL;
+    arena->used = 0;
+    arena->reserved = 0;
+    if (kept)
+    {
+        kept->next = NULL;
+        kept->used = 0;
+        arena->reserved = kept->size;
+    }
+}
+
+void arena_free(ARENA *arena)
+{
+    arena_reset(arena);
+    my_free(arena->head);
+    arena_init(arena);
+}
\ No newline at end of file
@@ -1,6 +1,7 @@
 /**
  * Wrapping for memory allocation functions
- * to exit on a failure with corresponding message.
+ * to exit on a failure with corresponding message (or jump, see `alloc_failure_catch').
+ * Also arena (bump) allocator for data with a common lifetime.
  *
  * @authors: Denis Chernikov, Vladislav Kuleykin
  */
@@ -8,16 +9,52 @@
 #ifndef C_PARSER_MALLOC_WRAP_H_INCLUDED
 #define C_PARSER_MALLOC_WRAP_H_INCLUDED
 
+#include <setjmp.h>
 #include <stddef.h>
+#include <stdio.h>
 
-/// Wrapping for `malloc' function. Exits application if `NULL'.
+/// Numbers of `my_malloc' and `my_realloc' calls and bytes requested by them.
+typedef struct
+{
+    size_t calls;
+    size_t bytes;
+}
+ALLOC_COUNTERS;
+
+/// Counters of the current thread, always kept: they cost two additions per call.
+extern _Thread_local ALLOC_COUNTERS alloc_counters;
+
+/// Place to continue at when memory cannot be allocated.
+typedef struct
+{
+    jmp_buf jump;
+    /// Receives the description of the memory not allocated
+    const char *description;
+}
+ALLOC_FAILURE;
+
+/// Make allocation failures of the current thread jump to the given place through `longjmp'
+/// instead of exiting the application. Memory allocated before is not lost: everything keeps
+/// pointing to it as if the failed call was never made.
+///
+/// \param failure Place to jump to, NULL - exit again
+/// \return Place set before, to be restored when done
+ALLOC_FAILURE *alloc_failure_catch(ALLOC_FAILURE *failure);
+
+/// Handle a failure to allocate memory: jump to the place set by `alloc_failure_catch',
+/// or write the message into `stderr' and exit the application.
+///
+/// \param description Type of content not allocated
+_Noreturn void alloc_fail(const char *description);
+
+/// Wrapping for `malloc' function. Calls `alloc_fail' if `NULL'.
 ///
 /// \param size Size to allocate
 /// \param description String to output inside warning, type of content
 /// \return New allocated memory
 void *my_malloc(size_t size, char *description);
 
-/// Wrapping for `realloc' function. Exits application if `NULL'.
+/// Wrapping for `realloc' function. Calls `alloc_fail' if `NULL'.
 ///
 /// \param memory Pointer to a memory to reallocate
 /// \param size Size to reallocate
@@ -25,4 +62,81 @@ void *my_malloc(size_t size, char *description);
 /// \return New allocated memory
 void *my_realloc(void *memory, size_t size, char *description);
 
+/// Release memory got from `my_malloc' or `my_realloc' (other heap memory is released as well).
+///
+/// \param memory Memory to release, may be NULL
+void my_free(void *memory);
+
+/// Number of size classes of the allocation profile: up to 16 bytes, up to 64, ... (by 4 times),
+/// the last one is for bigger sizes.
+#define ALLOC_PROFILE_SIZE_CLASSES 8
+
+/// Start profiling `my_malloc', `my_realloc' and `my_free' calls by their descriptions:
+/// calls, total, live and peak live bytes, sizes and chains of `my_realloc' growing the same memory.
+/// The profile is written into `stderr' at exit. Must be called before allocating on other threads.
+/// Without profiling, the wrappers do nothing besides `alloc_counters'.
+void alloc_profile_start();
+
+/// Write the profile collected since `alloc_profile_start' as a table sorted by total bytes.
+///
+/// \param out File to write to
+void alloc_profile_write(FILE *out);
+
+/// Default size of one arena block.
+#define ARENA_BLOCK_SIZE 65536
+
+/// Block of memory owned by an arena.
+typedef struct ARENA_BLOCK
+{
+    struct ARENA_BLOCK *next;
+    size_t size;
+    size_t used;
+}
+ARENA_BLOCK;
+
+/// Arena (bump) allocator. Everything allocated in it
+/// is released at once by `arena_reset' or `arena_free'.
+typedef struct
+{
+    ARENA_BLOCK *head;
+    void *last;
+    size_t used;
+    size_t reserved;
+}
+ARENA;
+
+/// Initialize an empty arena. Nothing is allocated until the first request.
+///
+/// \param arena Arena to initialize
+void arena_init(ARENA *arena);
+
+/// Allocate memory inside the arena. Exits application on a failure.
+///
+/// \param arena Arena to allocate in
+/// \param size Size to allocate
+/// \param description String to output inside warning, type of content
+/// \return New allocated memory, aligned for any type
+void *arena_alloc(ARENA *arena, size_t size, char *description);
+
+/// Grow memory allocated inside the arena. If it is the last allocation
+/// and the block has enough room, it is extended in place, otherwise copied.
+///
+/// \param arena Arena the memory belongs to
+/// \param memory Memory to grow, may be NULL
+/// \param old_size Size currently allocated for `memory'
+/// \param size New size
+/// \param description String to output inside warning, type of content
+/// \return Grown memory
+void *arena_grow(ARENA *arena, void *memory, size_t old_size, size_t size, char *description);
+
+/// Release everything allocated in the arena, keeping one block for reuse.
+///
+/// \param arena Arena to reset
+void arena_reset(ARENA *arena);
+
+/// Release all the memory owned by the arena.
+///
+/// \param arena Arena to free
+void arena_free(ARENA *arena);
+
 #endif //C_PARSER_MALLOC_WRAP_H_INCLUDED
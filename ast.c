@@ -5,24 +5,67 @@
  * @authors: Denis Chernikov, Vladislav Kuleykin
  */
 
+#include <setjmp.h>
 #include <stdarg.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "alloc_wrap.h"
 #include "ast.h"
+#include "ast_binary.h"
 #include "string_tools.h"
+#include "thread_pool.h"
+#include "writer.h"
 
-AST_NODE *ast_create_node(AST_NODE_TYPE type, AST_CONTENT content, int n_children, ...)
+/// Node of a constant followed by its value, see `ast_create_value_node'.
+typedef struct
 {
-    AST_NODE *res = (AST_NODE *) my_malloc(sizeof(AST_NODE), "AST node");
-    *res = (AST_NODE) {type, content, n_children, NULL};
+    AST_NODE node;
+    CONSTANT_VALUE value;
+}
+AST_VALUE_NODE;
+
+/// Capacity of the children array holding `n' children.
+/// Arrays grow by doubling, so it is the closest power of two.
+///
+/// \param n Number of children
+/// \return Number of slots allocated for them
+static int children_capacity(int n)
+{
+    int cap = 1;
+    while (cap < n) cap <<= 1;
+    return cap;
+}
+
+void *ast_alloc(ARENA *arena, size_t size, char *description)
+{
+    return arena ? arena_alloc(arena, size, description) : my_malloc(size, description);
+}
+
+char *ast_alloc_str(ARENA *arena, const char *str)
+{
+    size_t size = strlen(str) + 1;
+    char *res = (char *) ast_alloc(arena, size, "constant character allocation buffer");
+    memcpy(res, str, size);
+    return res;
+}
+
+void ast_free_str(ARENA *arena, char *str)
+{
+    if (!arena) my_free(str);
+}
+
+AST_NODE *ast_create_node(ARENA *arena, AST_NODE_TYPE type, AST_CONTENT content, int n_children, ...)
+{
+    AST_NODE *res = (AST_NODE *) ast_alloc(arena, sizeof(AST_NODE), "AST node");
+    *res = (AST_NODE) {type, false, content, n_children, 0, NULL};
     va_list ap;
     int i = 0;
     if (n_children > 0)
     {
-        res->children = (AST_NODE **)
-            my_malloc(sizeof(AST_NODE *) * n_children, "AST node's children");
+        res->children = (AST_NODE **) ast_alloc(arena, sizeof(AST_NODE *) * children_capacity(n_children),
+                "AST node's children");
         va_start(ap, n_children);
         while (i < n_children)
         {
@@ -33,16 +76,34 @@ AST_NODE *ast_create_node(AST_NODE_TYPE type, AST_CONTENT content, int n_childre
     return res;
 }
 
-AST_NODE *ast_expand_node(AST_NODE *node, AST_NODE *to_append)
+AST_NODE *ast_create_value_node(ARENA *arena, AST_NODE_TYPE type, AST_CONTENT content, const CONSTANT_VALUE *value)
+{
+    AST_VALUE_NODE *res = (AST_VALUE_NODE *) ast_alloc(arena, sizeof(AST_VALUE_NODE), "AST node");
+    res->node = (AST_NODE) {type, true, content, 0, 0, NULL};
+    res->value = *value;
+    return &res->node;
+}
+
+const CONSTANT_VALUE *ast_constant_value(const AST_NODE *node)
+{
+    return node->has_value ? &((const AST_VALUE_NODE *) node)->value : NULL;
+}
+
+AST_NODE *ast_expand_node(ARENA *arena, AST_NODE *node, AST_NODE *to_append)
 {
     if (!node || !to_append)
     {
         return node;
     }
-    ++node->children_number;
-    node->children = my_realloc(node->children,
-            sizeof(AST_NODE *) * node->children_number, "AST node's children");
-    node->children[node->children_number - 1] = to_append;
+    int n = node->children_number;
+    if (n == 0 || n == children_capacity(n))
+    {
+        size_t new_size = sizeof(AST_NODE *) * (n ? n * 2 : 1);
+        node->children = arena
+                ? arena_grow(arena, node->children, sizeof(AST_NODE *) * n, new_size, "AST node's children")
+                : my_realloc(node->children, new_size, "AST node's children");
+    }
+    node->children[node->children_number++] = to_append;
     return node;
 }
 
@@ -119,147 +180,915 @@ char *ast_type_to_str(AST_NODE_TYPE type)
     }
 }
 
+/// Does node of this type own a string in its content?
+/// Identifiers are not owned, they are interned (see `intern_str').
+///
+/// \param type Type of AST node
+/// \return `true' - content is an owned string, `false' - it is a token, an interned string or nothing
+static _Bool has_string_content(AST_NODE_TYPE type)
+{
+    return type == IntegerConstant || type == FloatingConstant
+        || type == CharacterConstant || type == StringLiteral;
+}
+
 void ast_free(AST_NODE *root)
 {
     if (root == NULL) return;
-    if (root->type == Identifier || root->type == IntegerConstant || root->type == FloatingConstant
-        || root->type == CharacterConstant || root->type == StringLiteral) {
-        free(root->content.value);
+    if (has_string_content(root->type) && !root->length) {
+        my_free(root->content.value);
     }
     for (int i = 0; i < root->children_number; ++i)
     {
         ast_free(root->children[i]);
     }
-    free(root);
+    my_free(root->children);
+    my_free(root);
 }
 
-char *ast_to_json(AST_NODE *root, int shift, char *tab, char *(*cont_to_str)(AST_NODE *))
+void ast_count_nodes(const AST_NODE *root, size_t counts[AST_NODE_TYPES_NUMBER])
+{
+    if (!root) return;
+    ++counts[root->type];
+    for (int i = 0; i < root->children_number; ++i) ast_count_nodes(root->children[i], counts);
+}
+
+/// Size of the buffer on the stack for decoding literals in `write_literal'.
+#define LITERAL_BUFFER_SIZE 256
+
+/// Is the node a literal keeping its spelling instead of the value?
+///
+/// \param node Node to check
+/// \return `true' - it is a character constant or a string literal, `false' - otherwise
+static _Bool is_literal(const AST_NODE *node)
 {
-    char *json;
-    char *act_tab = repeat(shift, tab);
-    int res;
+    return node->type == StringLiteral || node->type == CharacterConstant;
+}
 
-    // If given NULL root
+char *ast_literal_value(ARENA *arena, const AST_NODE *node, size_t *length)
+{
+    const char *raw = (const char *) node->content.value;
+    size_t len = node->length ? node->length : strlen(raw);
+    char *res = (char *) ast_alloc(arena, len + 1, "literal value");
+    size_t value_len = literal_decode(raw, len, res, NULL);
+    if (value_len == LITERAL_INVALID)
+    {
+        ast_free_str(arena, res);
+        return NULL;
+    }
+    res[value_len] = '\0';
+    if (length) *length = value_len;
+    return res;
+}
+
+/// Write the value of a literal as a JSON string. Spellings without escapes
+/// are their own values, they are written as they are.
+///
+/// \param out Writer to write to
+/// \param raw Spelling of the literal
+/// \param len Length of the spelling
+static void write_literal(WRITER *out, const char *raw, size_t len)
+{
+    if (!literal_has_escapes(raw, len))
+    {
+        writer_put_quoted_len(out, raw, len);
+        return;
+    }
+    char small[LITERAL_BUFFER_SIZE];
+    char *value = len <= sizeof(small) ? small : (char *) my_malloc(len, "literal value");
+    size_t value_len = literal_decode(raw, len, value, NULL);
+    // Only a broken binary AST may have an invalid one, it is shown as it is
+    if (value_len == LITERAL_INVALID) writer_put_quoted_len(out, raw, len);
+    else writer_put_quoted_len(out, value, value_len);
+    if (value != small) my_free(value);
+}
+
+/// Write the content of the node as a JSON string, or `null'.
+/// Slices of the source are written as they are, without `cont_to_str',
+/// literals are decoded from their spellings.
+///
+/// \param out Writer to write to
+/// \param node Node to write the content of
+/// \param cont_to_str Function to convert other contents into strings
+static void write_content(WRITER *out, AST_NODE *node, char *(*cont_to_str)(AST_NODE *))
+{
+    const char *spelling = (const char *) node->content.value;
+    if (spelling && is_literal(node))
+    {
+        write_literal(out, spelling, node->length ? node->length : strlen(spelling));
+        return;
+    }
+    if (node->length)
+    {
+        writer_put_quoted_len(out, spelling, node->length);
+        return;
+    }
+    char *content_str = node->content.value ? (*cont_to_str)(node) : NULL;
+    if (content_str)
+    {
+        writer_put_quoted(out, content_str);
+    }
+    else
+    {
+        writer_put(out, "null", 4);
+    }
+}
+
+/// Get the value of an integer or floating constant node, converting its spelling
+/// if the value is not stored (nodes of flat and binary ASTs).
+///
+/// \param node Constant node
+/// \param value Receives the value
+/// \return `true' - OK, `false' - the constant has no value
+static _Bool node_value(const AST_NODE *node, CONSTANT_VALUE *value)
+{
+    const CONSTANT_VALUE *stored = ast_constant_value(node);
+    if (stored)
+    {
+        *value = *stored;
+        return true;
+    }
+    const char *spelling = (const char *) node->content.value;
+    return spelling && constant_convert(spelling, node->length ? node->length : strlen(spelling),
+                                        node->type == FloatingConstant, value);
+}
+
+/// Write the value of a constant as a JSON number, or `null'.
+///
+/// \param out Writer to write to
+/// \param value Value to write, NULL if there is none
+static void write_number(WRITER *out, const CONSTANT_VALUE *value)
+{
+    if (!value)
+    {
+        writer_put(out, "null", 4);
+        return;
+    }
+    char num[CONSTANT_JSON_MAX];
+    writer_put(out, num, constant_to_json(value, num));
+}
+
+/// Write the name of the type of a constant as a JSON string, or `null'.
+///
+/// \param out Writer to write to
+/// \param value Value of the constant, NULL if there is none
+static void write_value_type(WRITER *out, const CONSTANT_VALUE *value)
+{
+    if (!value)
+    {
+        writer_put(out, "null", 4);
+        return;
+    }
+    writer_putc(out, '"');
+    writer_puts(out, constant_type_to_str(value->type));
+    writer_putc(out, '"');
+}
+
+/// Are the value and the type of the node written after its content?
+///
+/// \param out Writer of the output
+/// \param node Node to be written
+/// \return `true' - typed constants are written and it is an integer or floating constant
+static _Bool writes_value(const WRITER *out, const AST_NODE *node)
+{
+    return out->typed_constants && (node->type == IntegerConstant || node->type == FloatingConstant);
+}
+
+/// Write `shift' tabulations.
+///
+/// \param out Writer to write to
+/// \param shift Number of tabulations
+/// \param tab String representation of the tabulation
+/// \param tab_len Length of `tab'
+static void write_indent(WRITER *out, int shift, const char *tab, size_t tab_len)
+{
+    for (int i = 0; i < shift; ++i)
+    {
+        writer_put(out, tab, tab_len);
+    }
+}
+
+/// Write JSON fields of the node up to the value of `children'.
+static void write_json_fields(WRITER *out, AST_NODE *root, int shift, const char *tab, size_t tab_len,
+                              char *(*cont_to_str)(AST_NODE *))
+{
+    writer_put(out, "{\n", 2);
+    write_indent(out, shift + 1, tab, tab_len);
+    writer_put(out, "\"type\": \"", 9);
+    writer_puts(out, ast_type_to_str(root->type));
+    writer_put(out, "\",\n", 3);
+
+    write_indent(out, shift + 1, tab, tab_len);
+    writer_put(out, "\"content\": ", 11);
+    write_content(out, root, cont_to_str);
+    writer_put(out, ",\n", 2);
+
+    CONSTANT_VALUE value;
+    if (writes_value(out, root))
+    {
+        _Bool known = node_value(root, &value);
+        write_indent(out, shift + 1, tab, tab_len);
+        writer_put(out, "\"value\": ", 9);
+        write_number(out, known ? &value : NULL);
+        writer_put(out, ",\n", 2);
+        write_indent(out, shift + 1, tab, tab_len);
+        writer_put(out, "\"value_type\": ", 14);
+        write_value_type(out, known ? &value : NULL);
+        writer_put(out, ",\n", 2);
+    }
+
+    char num[12];
+    write_indent(out, shift + 1, tab, tab_len);
+    writer_put(out, "\"children_number\": ", 19);
+    writer_put(out, num, (size_t) sprintf(num, "%d", root->children_number));
+    writer_put(out, ",\n", 2);
+
+    write_indent(out, shift + 1, tab, tab_len);
+    writer_put(out, "\"children\": ", 12);
+}
+
+/// Recursive part of `ast_write_json'.
+static void write_json_node(WRITER *out, AST_NODE *root, int shift, const char *tab, size_t tab_len,
+                            char *(*cont_to_str)(AST_NODE *))
+{
+    write_indent(out, shift, tab, tab_len);
     if (!root)
     {
-        json = (char *) my_malloc(sizeof(char) * (shift * strlen(tab) + 5),
-                "JSON representation");
-        res = sprintf(json, "%snull", act_tab);
-        free(act_tab);
-        if (res < 0)
+        writer_put(out, "null", 4);
+        return;
+    }
+
+    write_json_fields(out, root, shift, tab, tab_len, cont_to_str);
+    if (root->children)
+    {
+        writer_put(out, "[\n", 2);
+        for (int i = 0; i < root->children_number; ++i)
         {
-            fprintf(stderr,
-                "FATAL ERROR! String formatting cannot be applied!\n");
-            exit(-1);
+            if (i > 0) writer_put(out, ",\n", 2);
+            write_json_node(out, root->children[i], shift + 2, tab, tab_len, cont_to_str);
         }
-        return json;
+        writer_putc(out, '\n');
+        write_indent(out, shift + 1, tab, tab_len);
+        writer_putc(out, ']');
+    }
+    else
+    {
+        writer_put(out, "null", 4);
     }
+    writer_putc(out, '\n');
+
+    write_indent(out, shift, tab, tab_len);
+    writer_putc(out, '}');
+}
+
+void ast_write_json(WRITER *out, AST_NODE *root, int shift, char *tab, char *(*cont_to_str)(AST_NODE *))
+{
+    write_json_node(out, root, shift, tab, strlen(tab), cont_to_str);
+}
+
+/// Top-level declarations are dealt out to jobs of `ast_write_json_parallel' by this number of nodes.
+#define JSON_JOB_NODES 8192
+
+/// Jobs run at once by each worker of `ast_write_json_parallel', their output is kept in memory until written.
+#define JSON_JOBS_PER_WORKER 4
 
-    // Get string representation of `type' field
-    char *type_str = ast_type_to_str(root->type);
+/// Jobs of `ast_write_json_parallel' run at once.
+typedef struct
+{
+    /// Top-level declarations
+    AST_NODE **children;
+    /// First declaration of every job, followed by the end of the last one
+    size_t *bounds;
+    /// Output of every job
+    WRITER *outputs;
+    int shift;
+    const char *tab;
+    size_t tab_len;
+    char *(*cont_to_str)(AST_NODE *);
+    /// Are values of constants written (see `WRITER.typed_constants')?
+    _Bool typed_constants;
+}
+JSON_JOBS;
+
+/// Number of nodes in the subtree.
+///
+/// \param root Root of the subtree, may be NULL
+/// \return Number of nodes
+static size_t subtree_size(const AST_NODE *root)
+{
+    if (!root) return 0;
+    size_t res = 1;
+    for (int i = 0; i < root->children_number; ++i) res += subtree_size(root->children[i]);
+    return res;
+}
 
-    // Get string representation of `node' content
-    char *content_str;
-    if (root->content.value)
+/// Write JSON of the declarations of one job into its own buffer, separated as `write_json_node' does.
+static void json_job(size_t job, int worker, void *arg)
+{
+    (void) worker;
+    JSON_JOBS *jobs = (JSON_JOBS *) arg;
+    WRITER *out = &jobs->outputs[job];
+    writer_init_buffer(out);
+    out->typed_constants = jobs->typed_constants;
+    for (size_t i = jobs->bounds[job]; i < jobs->bounds[job + 1]; ++i)
+    {
+        if (i > jobs->bounds[job]) writer_put(out, ",\n", 2);
+        write_json_node(out, jobs->children[i], jobs->shift, jobs->tab, jobs->tab_len, jobs->cont_to_str);
+    }
+}
+
+void ast_write_json_parallel(WRITER *out, AST_NODE *root, int shift, char *tab, char *(*cont_to_str)(AST_NODE *),
+                             int workers)
+{
+    if (workers < 2 || !root || !root->children || root->children_number < 2)
+    {
+        ast_write_json(out, root, shift, tab, cont_to_str);
+        return;
+    }
+    // Contiguous runs of declarations of about `JSON_JOB_NODES' nodes make the jobs
+    size_t number = (size_t) root->children_number;
+    size_t *bounds = (size_t *) my_malloc((number + 1) * sizeof(size_t), "JSON job bounds");
+    size_t jobs_number = 0, total = 0, job_nodes = 0;
+    bounds[0] = 0;
+    for (size_t i = 0; i < number; ++i)
     {
-        char *tmp = (*cont_to_str)(root);
-        if (!tmp)
+        size_t nodes = subtree_size(root->children[i]);
+        total += nodes;
+        job_nodes += nodes;
+        if (job_nodes >= JSON_JOB_NODES || i + 1 == number)
         {
-            goto null_content;
+            bounds[++jobs_number] = i + 1;
+            job_nodes = 0;
         }
-        content_str = wrap_by_quotes(tmp);
     }
-    else
+    if (total < AST_JSON_PARALLEL_MIN_NODES || jobs_number < 2)
+    {
+        my_free(bounds);
+        ast_write_json(out, root, shift, tab, cont_to_str);
+        return;
+    }
+
+    size_t round = (size_t) workers * JSON_JOBS_PER_WORKER;
+    JSON_JOBS jobs = {root->children, NULL, NULL, shift + 2, tab, strlen(tab), cont_to_str, out->typed_constants};
+    jobs.outputs = (WRITER *) my_malloc(round * sizeof(WRITER), "JSON job outputs");
+    write_indent(out, shift, tab, jobs.tab_len);
+    write_json_fields(out, root, shift, tab, jobs.tab_len, cont_to_str);
+    writer_put(out, "[\n", 2);
+    for (size_t first = 0; first < jobs_number; first += round)
     {
-        null_content:
-        content_str = (char *) my_malloc(sizeof(char) * 5, "JSON null");
-        res = sprintf(content_str, "null");
-        if (res < 0)
+        size_t n = jobs_number - first < round ? jobs_number - first : round;
+        jobs.bounds = bounds + first;
+        thread_pool_run(n, workers, &json_job, &jobs);
+        for (size_t i = 0; i < n; ++i)
         {
-            fprintf(stderr,
-                    "FATAL ERROR! String formatting cannot be applied!\n");
-            exit(-1);
+            if (first + i > 0) writer_put(out, ",\n", 2);
+            writer_put(out, jobs.outputs[i].buf, jobs.outputs[i].len);
+            my_free(writer_release(&jobs.outputs[i]));
         }
     }
+    my_free(jobs.outputs);
+    my_free(bounds);
+    writer_putc(out, '\n');
+    write_indent(out, shift + 1, tab, jobs.tab_len);
+    writer_put(out, "]\n", 2);
+    write_indent(out, shift, tab, jobs.tab_len);
+    writer_putc(out, '}');
+}
+
+char *ast_to_json(AST_NODE *root, int shift, char *tab, char *(*cont_to_str)(AST_NODE *))
+{
+    WRITER out;
+    writer_init_buffer(&out);
+    ast_write_json(&out, root, shift, tab, cont_to_str);
+    return writer_release(&out);
+}
 
-    // Get string representation of `children_number' field
-    char *children_num_str = (char *) my_malloc(7, "number representation");
-    res = sprintf(children_num_str, "%d", root->children_number);
-    if (res < 0)
+void ast_write_json_line(WRITER *out, AST_NODE *root, char *(*cont_to_str)(AST_NODE *))
+{
+    if (!root)
     {
-        fprintf(stderr,
-                "FATAL ERROR! String formatting cannot be applied!\n");
-        exit(-1);
+        writer_put(out, "null", 4);
+        return;
     }
-
-    // Get string representation of `children' array field
-    int i;
-    char **children = (char **) my_malloc(sizeof(char *) * root->children_number,
-            "children representation");
-    for (i = 0; i < root->children_number; ++i)
+    writer_put(out, "{\"type\":\"", 9);
+    writer_puts(out, ast_type_to_str(root->type));
+    writer_put(out, "\",\"content\":", 12);
+    write_content(out, root, cont_to_str);
+    CONSTANT_VALUE value;
+    if (writes_value(out, root))
     {
-        children[i] = ast_to_json(root->children[i], shift + 2, tab, cont_to_str);
+        _Bool known = node_value(root, &value);
+        writer_put(out, ",\"value\":", 9);
+        write_number(out, known ? &value : NULL);
+        writer_put(out, ",\"value_type\":", 14);
+        write_value_type(out, known ? &value : NULL);
     }
-    char *children_str;
+    char num[12];
+    writer_put(out, ",\"children_number\":", 19);
+    writer_put(out, num, (size_t) sprintf(num, "%d", root->children_number));
+    writer_put(out, ",\"children\":", 12);
     if (root->children)
     {
-        char *arr = concat_array(children, root->children_number, ",\n");
-        for (i = 0; i < root->children_number; ++i) free(children[i]);
-        size_t size = strlen(arr) + strlen(tab) * (shift + 1) + sizeof(char) * (4 + 1);
-        children_str = (char *) my_malloc(size, "children array string");
-        res = sprintf(children_str, "[\n%s\n%s%s]", arr, act_tab, tab);
-        free(arr);
-        if (res < 0)
+        writer_putc(out, '[');
+        for (int i = 0; i < root->children_number; ++i)
+        {
+            if (i > 0) writer_putc(out, ',');
+            ast_write_json_line(out, root->children[i], cont_to_str);
+        }
+        writer_putc(out, ']');
+    }
+    else
+    {
+        writer_put(out, "null", 4);
+    }
+    writer_putc(out, '}');
+}
+
+/// Reset the arena of a collected declaration, moving the node of the lookahead token into it.
+///
+/// \param scratch Arena to reset
+/// \param lookahead Node of the lookahead token, updated, or NULL
+static void reset_scratch(ARENA *scratch, AST_NODE **lookahead)
+{
+    if (!lookahead || !*lookahead)
+    {
+        arena_reset(scratch);
+        return;
+    }
+    AST_NODE node = **lookahead;
+    CONSTANT_VALUE value;
+    if (node.has_value) value = *ast_constant_value(*lookahead);
+    // Spellings copied by the lexer are in the arena too, names of identifiers are interned
+    char *spelling = NULL;
+    size_t len = 0;
+    if (has_string_content(node.type) && node.content.value && !node.length)
+    {
+        len = strlen(node.content.value);
+        spelling = (char *) my_malloc(len + 1, "lookahead spelling");
+        memcpy(spelling, node.content.value, len + 1);
+    }
+    arena_reset(scratch);
+
+    ALLOC_FAILURE failure;
+    ALLOC_FAILURE *outer = alloc_failure_catch(&failure);
+    if (setjmp(failure.jump))
+    {
+        alloc_failure_catch(outer);
+        my_free(spelling);
+        alloc_fail(failure.description);
+    }
+    if (spelling)
+    {
+        node.content.value = ast_alloc(scratch, len + 1, "constant character allocation buffer");
+        memcpy(node.content.value, spelling, len + 1);
+    }
+    *lookahead = node.has_value ? ast_create_value_node(scratch, node.type, node.content, &value)
+                                : ast_create_node(scratch, node.type, node.content, 0);
+    (*lookahead)->length = node.length;
+    alloc_failure_catch(outer);
+    my_free(spelling);
+}
+
+void ast_stream_collect(AST_STREAM *stream, ARENA *scratch, AST_NODE *declaration, AST_NODE **lookahead)
+{
+    ast_write_json_line(stream->out, declaration, stream->cont_to_str);
+    writer_putc(stream->out, '\n');
+    ++stream->declarations;
+    if (stream->node_counts) ast_count_nodes(declaration, stream->node_counts);
+    reset_scratch(scratch, lookahead);
+}
+
+
+void ast_flat_init(AST_FLAT *flat)
+{
+    *flat = (AST_FLAT) {0};
+    arena_init(&flat->strings);
+    flat->nodes_capacity = 1024;
+    flat->types = (unsigned char *) my_malloc(flat->nodes_capacity, "flat AST types");
+    flat->contents = (AST_CONTENT *) my_malloc(sizeof(AST_CONTENT) * flat->nodes_capacity, "flat AST contents");
+    flat->first_child = (uint32_t *) my_malloc(sizeof(uint32_t) * flat->nodes_capacity, "flat AST children");
+    flat->children_number = (uint32_t *) my_malloc(sizeof(uint32_t) * flat->nodes_capacity, "flat AST children");
+    flat->children_capacity = 1024;
+    flat->children = (AST_ID *) my_malloc(sizeof(AST_ID) * flat->children_capacity, "flat AST children");
+
+    // Root is filled in by `ast_flat_finish'
+    flat->nodes_number = 1;
+    flat->types[0] = TranslationUnit;
+    flat->contents[0] = (AST_CONTENT) {.value = NULL};
+    flat->first_child[0] = 0;
+    flat->children_number[0] = 0;
+}
+
+void ast_flat_collect(AST_FLAT *flat, ARENA *scratch, AST_NODE *declaration, AST_NODE **lookahead)
+{
+    ast_flat_append(flat, declaration);
+    reset_scratch(scratch, lookahead);
+}
+
+/// Reserve space for `n' more nodes in the flat AST.
+///
+/// \param flat Flat AST to grow
+/// \param n Number of nodes to be added
+static void flat_reserve_nodes(AST_FLAT *flat, uint32_t n)
+{
+    if (flat->nodes_number + n <= flat->nodes_capacity) return;
+    while (flat->nodes_number + n > flat->nodes_capacity) flat->nodes_capacity *= 2;
+    size_t cap = flat->nodes_capacity;
+    flat->types = (unsigned char *) my_realloc(flat->types, cap, "flat AST types");
+    flat->contents = (AST_CONTENT *) my_realloc(flat->contents, sizeof(AST_CONTENT) * cap, "flat AST contents");
+    flat->first_child = (uint32_t *) my_realloc(flat->first_child, sizeof(uint32_t) * cap, "flat AST children");
+    flat->children_number = (uint32_t *) my_realloc(flat->children_number, sizeof(uint32_t) * cap,
+            "flat AST children");
+}
+
+/// Reserve `n' contiguous slots in the children array of the flat AST.
+///
+/// \param flat Flat AST to grow
+/// \param n Number of slots
+/// \return Index of the first reserved slot
+static uint32_t flat_reserve_children(AST_FLAT *flat, uint32_t n)
+{
+    if (flat->children_len + n > flat->children_capacity)
+    {
+        while (flat->children_len + n > flat->children_capacity) flat->children_capacity *= 2;
+        flat->children = (AST_ID *) my_realloc(flat->children, sizeof(AST_ID) * flat->children_capacity,
+                "flat AST children");
+    }
+    uint32_t res = flat->children_len;
+    flat->children_len += n;
+    return res;
+}
+
+/// Copy a pointer-linked subtree into the flat AST in pre-order.
+///
+/// \param flat Flat AST to copy into
+/// \param node Root of the subtree
+/// \return Index of the copied root
+static AST_ID flat_copy(AST_FLAT *flat, AST_NODE *node)
+{
+    if (!node) return AST_NULL_ID;
+    flat_reserve_nodes(flat, 1);
+    AST_ID id = flat->nodes_number++;
+    flat->types[id] = (unsigned char) node->type;
+    flat->contents[id] = node->content;
+    if (has_string_content(node->type) && node->content.value)
+    {
+        // Slices of the source are copied as well: flat contents are always null-terminated
+        size_t len = node->length ? node->length : strlen(node->content.value);
+        char *copy = (char *) arena_alloc(&flat->strings, len + 1, "flat AST strings");
+        memcpy(copy, node->content.value, len);
+        copy[len] = '\0';
+        flat->contents[id].value = copy;
+    }
+    uint32_t n = (uint32_t) node->children_number;
+    uint32_t first = flat_reserve_children(flat, n);
+    flat->first_child[id] = first;
+    flat->children_number[id] = n;
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        AST_ID child = flat_copy(flat, node->children[i]);
+        flat->children[first + i] = child;
+    }
+    return id;
+}
+
+AST_ID ast_flat_append(AST_FLAT *flat, AST_NODE *declaration)
+{
+    AST_ID id = flat_copy(flat, declaration);
+    if (flat->top_number == flat->top_capacity)
+    {
+        flat->top_capacity = flat->top_capacity ? flat->top_capacity * 2 : 64;
+        flat->top = (AST_ID *) my_realloc(flat->top, sizeof(AST_ID) * flat->top_capacity,
+                "flat AST top-level declarations");
+    }
+    flat->top[flat->top_number++] = id;
+    return id;
+}
+
+AST_ID ast_flat_finish(AST_FLAT *flat)
+{
+    uint32_t first = flat_reserve_children(flat, flat->top_number);
+    memcpy(flat->children + first, flat->top, sizeof(AST_ID) * flat->top_number);
+    flat->first_child[0] = first;
+    flat->children_number[0] = flat->top_number;
+    return 0;
+}
+
+/// Content printer of nodes whose content is already a string.
+///
+/// \param node Node to print the content of
+/// \return The content itself
+static char *stored_content(AST_NODE *node)
+{
+    return (char *) node->content.value;
+}
+
+/// Recursive part of `ast_flat_write_json'.
+static void write_json_flat(WRITER *out, AST_FLAT *flat, AST_ID id, int shift, const char *tab, size_t tab_len,
+                            char *(*cont_to_str)(AST_NODE *))
+{
+    write_indent(out, shift, tab, tab_len);
+    if (id == AST_NULL_ID)
+    {
+        writer_put(out, "null", 4);
+        return;
+    }
+
+    // Content printer expects a node, give it a view of this one
+    AST_NODE view = {flat->types[id], false, flat->contents[id], (int) flat->children_number[id], 0, NULL};
+    write_json_fields(out, &view, shift, tab, tab_len, cont_to_str);
+    if (view.children_number > 0)
+    {
+        AST_ID *children = flat->children + flat->first_child[id];
+        writer_put(out, "[\n", 2);
+        for (int i = 0; i < view.children_number; ++i)
         {
-            fprintf(stderr,
-                    "FATAL ERROR! String formatting cannot be applied!\n");
-            exit(-1);
+            if (i > 0) writer_put(out, ",\n", 2);
+            write_json_flat(out, flat, children[i], shift + 2, tab, tab_len, cont_to_str);
         }
-        free(children);
+        writer_putc(out, '\n');
+        write_indent(out, shift + 1, tab, tab_len);
+        writer_putc(out, ']');
     }
     else
     {
-        children_str = (char *) my_malloc(sizeof(char) * 5, "JSON null");
-        res = sprintf(children_str, "null");
-        if (res < 0)
+        writer_put(out, "null", 4);
+    }
+    writer_putc(out, '\n');
+
+    write_indent(out, shift, tab, tab_len);
+    writer_putc(out, '}');
+}
+
+void ast_flat_write_json(WRITER *out, AST_FLAT *flat, AST_ID root, int shift, char *tab,
+                         char *(*cont_to_str)(AST_NODE *))
+{
+    write_json_flat(out, flat, root, shift, tab, strlen(tab), cont_to_str);
+}
+
+/// Binary AST being built. Its sections grow separately and are written one after another at the end.
+typedef struct
+{
+    AST_BIN_NODE *nodes;
+    uint32_t nodes_number;
+    uint32_t nodes_capacity;
+    uint32_t *children;
+    uint32_t children_number;
+    uint32_t children_capacity;
+    WRITER strings;
+    /// Open-addressing table of offsets of the strings plus 1, 0 - empty slot
+    uint32_t *string_slots;
+    uint32_t slots_capacity;
+    uint32_t strings_number;
+    char *(*cont_to_str)(AST_NODE *);
+}
+BIN_BUILDER;
+
+/// Initialize an empty binary AST.
+///
+/// \param b Builder to initialize
+/// \param cont_to_str Function for printing the content of the node
+static void bin_init(BIN_BUILDER *b, char *(*cont_to_str)(AST_NODE *))
+{
+    *b = (BIN_BUILDER) {0};
+    b->nodes_capacity = b->children_capacity = 1024;
+    b->nodes = (AST_BIN_NODE *) my_malloc(sizeof(AST_BIN_NODE) * b->nodes_capacity, "binary AST nodes");
+    b->children = (uint32_t *) my_malloc(sizeof(uint32_t) * b->children_capacity, "binary AST children");
+    writer_init_buffer(&b->strings);
+    b->slots_capacity = 1024;
+    b->string_slots = (uint32_t *) calloc(b->slots_capacity, sizeof(uint32_t));
+    if (!b->string_slots) alloc_fail("binary AST strings");
+    b->cont_to_str = cont_to_str;
+}
+
+/// Find the slot of the string in the table of the builder.
+///
+/// \param b Builder to search in
+/// \param str String to search for, not necessarily null-terminated
+/// \param len Length of `str'
+/// \param hash Hash of `str'
+/// \return Slot holding the string or the empty one to put it into
+static uint32_t *bin_string_slot(BIN_BUILDER *b, const char *str, size_t len, uint32_t hash)
+{
+    uint32_t mask = b->slots_capacity - 1;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        uint32_t *slot = &b->string_slots[i];
+        if (*slot == 0) return slot;
+        const char *stored = b->strings.buf + *slot - 1;
+        if (strncmp(stored, str, len) == 0 && stored[len] == '\0') return slot;
+    }
+}
+
+/// Get the offset of the string among the strings of the binary AST, adding it if needed.
+///
+/// \param b Builder to add to
+/// \param str String to add, not necessarily null-terminated
+/// \param len Length of `str'
+/// \return Offset of the string
+static uint32_t bin_string(BIN_BUILDER *b, const char *str, size_t len)
+{
+    uint32_t *slot = bin_string_slot(b, str, len, str_hash_len(str, len));
+    if (*slot) return *slot - 1;
+
+    uint32_t offset = (uint32_t) b->strings.len;
+    writer_put(&b->strings, str, len);
+    writer_putc(&b->strings, '\0');
+    *slot = offset + 1;
+    if (++b->strings_number * 2 > b->slots_capacity)
+    {
+        // Keep the table at most half full
+        uint32_t *old = b->string_slots;
+        uint32_t old_capacity = b->slots_capacity;
+        b->slots_capacity *= 2;
+        b->string_slots = (uint32_t *) calloc(b->slots_capacity, sizeof(uint32_t));
+        if (!b->string_slots)
+        {
+            b->string_slots = old;
+            b->slots_capacity = old_capacity;
+            alloc_fail("binary AST strings");
+        }
+        for (uint32_t i = 0; i < old_capacity; ++i)
+        {
+            if (!old[i]) continue;
+            const char *moved = b->strings.buf + old[i] - 1;
+            size_t moved_len;
+            uint32_t hash = str_hash(moved, &moved_len);
+            *bin_string_slot(b, moved, moved_len, hash) = old[i];
+        }
+        free(old);
+    }
+    return offset;
+}
+
+/// Add a node to the binary AST, with space for its children.
+///
+/// \param b Builder to add to
+/// \param view Node to take type and content of
+/// \param n Number of children
+/// \return Index of the new node
+static uint32_t bin_add_node(BIN_BUILDER *b, AST_NODE *view, uint32_t n)
+{
+    if (b->nodes_number == b->nodes_capacity)
+    {
+        b->nodes_capacity *= 2;
+        b->nodes = (AST_BIN_NODE *) my_realloc(b->nodes, sizeof(AST_BIN_NODE) * b->nodes_capacity,
+                "binary AST nodes");
+    }
+    while (b->children_number + n > b->children_capacity)
+    {
+        b->children_capacity *= 2;
+        b->children = (uint32_t *) my_realloc(b->children, sizeof(uint32_t) * b->children_capacity,
+                "binary AST children");
+    }
+    // Slices of the source are stored as they are, without `cont_to_str'
+    const char *content = (const char *) view->content.value;
+    size_t len = view->length;
+    if (!len && content)
+    {
+        content = (*b->cont_to_str)(view);
+        len = content ? strlen(content) : 0;
+    }
+    uint32_t id = b->nodes_number++;
+    b->nodes[id] = (AST_BIN_NODE) {(uint32_t) view->type, content ? bin_string(b, content, len) : AST_BIN_NULL,
+                                   b->children_number, n};
+    b->children_number += n;
+    return id;
+}
+
+/// Copy a pointer-linked subtree into the binary AST in pre-order.
+///
+/// \param b Builder to copy into
+/// \param node Root of the subtree
+/// \return Index of the copied root
+static uint32_t bin_copy(BIN_BUILDER *b, AST_NODE *node)
+{
+    if (!node) return AST_BIN_NULL;
+    uint32_t id = bin_add_node(b, node, (uint32_t) node->children_number);
+    for (int i = 0; i < node->children_number; ++i)
+    {
+        uint32_t child = bin_copy(b, node->children[i]);
+        b->children[b->nodes[id].first_child + i] = child;
+    }
+    return id;
+}
+
+/// Copy a subtree of a flat AST into the binary AST in pre-order.
+///
+/// \param b Builder to copy into
+/// \param flat Flat AST to copy from
+/// \param id Index of the subtree root
+/// \return Index of the copied root
+static uint32_t bin_copy_flat(BIN_BUILDER *b, AST_FLAT *flat, AST_ID id)
+{
+    if (id == AST_NULL_ID) return AST_BIN_NULL;
+    AST_NODE view = {flat->types[id], false, flat->contents[id], (int) flat->children_number[id], 0, NULL};
+    uint32_t res = bin_add_node(b, &view, flat->children_number[id]);
+    for (uint32_t i = 0; i < flat->children_number[id]; ++i)
+    {
+        uint32_t child = bin_copy_flat(b, flat, flat->children[flat->first_child[id] + i]);
+        b->children[b->nodes[res].first_child + i] = child;
+    }
+    return res;
+}
+
+/// Write the built binary AST and free the builder.
+///
+/// \param b Builder to write
+/// \param out Writer to write to
+/// \param root Index of the root
+static void bin_write(BIN_BUILDER *b, WRITER *out, uint32_t root)
+{
+    AST_BIN_HEADER header = {0};
+    memcpy(header.magic, AST_BIN_MAGIC, sizeof(header.magic));
+    header.version = AST_BIN_VERSION;
+    header.root = root;
+    header.nodes_number = b->nodes_number;
+    header.nodes_offset = sizeof(AST_BIN_HEADER);
+    header.children_number = b->children_number;
+    header.children_offset = header.nodes_offset + sizeof(AST_BIN_NODE) * b->nodes_number;
+    header.strings_size = (uint32_t) b->strings.len;
+    header.strings_offset = header.children_offset + sizeof(uint32_t) * b->children_number;
+    writer_put(out, (const char *) &header, sizeof(header));
+    writer_put(out, (const char *) b->nodes, sizeof(AST_BIN_NODE) * b->nodes_number);
+    writer_put(out, (const char *) b->children, sizeof(uint32_t) * b->children_number);
+    writer_put(out, b->strings.buf, b->strings.len);
+
+    my_free(b->nodes);
+    my_free(b->children);
+    my_free(writer_release(&b->strings));
+    free(b->string_slots);
+}
+
+void ast_write_binary(WRITER *out, AST_NODE *root, char *(*cont_to_str)(AST_NODE *))
+{
+    BIN_BUILDER b;
+    bin_init(&b, cont_to_str);
+    uint32_t id = bin_copy(&b, root);
+    bin_write(&b, out, id);
+}
+
+void ast_flat_write_binary(WRITER *out, AST_FLAT *flat, AST_ID root, char *(*cont_to_str)(AST_NODE *))
+{
+    BIN_BUILDER b;
+    bin_init(&b, cont_to_str);
+    uint32_t id = bin_copy_flat(&b, flat, root);
+    bin_write(&b, out, id);
+}
+
+/// Recursive part of `ast_bin_write_json'.
+static void write_json_bin(WRITER *out, const AST_BIN *bin, uint32_t id, int shift, const char *tab, size_t tab_len)
+{
+    write_indent(out, shift, tab, tab_len);
+    if (id == AST_BIN_NULL)
+    {
+        writer_put(out, "null", 4);
+        return;
+    }
+
+    // Content printer gets the stored string back
+    AST_NODE view = {(AST_NODE_TYPE) ast_bin_type(bin, id), false, {.value = (void *) ast_bin_content(bin, id)},
+                     (int) ast_bin_children_number(bin, id), 0, NULL};
+    write_json_fields(out, &view, shift, tab, tab_len, stored_content);
+    if (view.children_number > 0)
+    {
+        writer_put(out, "[\n", 2);
+        for (uint32_t i = 0; i < (uint32_t) view.children_number; ++i)
         {
-            fprintf(stderr,
-                    "FATAL ERROR! String formatting cannot be applied!\n");
-            exit(-1);
+            if (i > 0) writer_put(out, ",\n", 2);
+            write_json_bin(out, bin, ast_bin_child(bin, id, i), shift + 2, tab, tab_len);
         }
+        writer_putc(out, '\n');
+        write_indent(out, shift + 1, tab, tab_len);
+        writer_putc(out, ']');
+    }
+    else
+    {
+        writer_put(out, "null", 4);
     }
+    writer_putc(out, '\n');
 
-    // Concatenate the resulting JSON object
-    size_t json_size
-            = strlen(type_str)
-            + strlen(content_str)
-            + strlen(children_num_str)
-            + strlen(children_str)
-            + strlen(tab) * (shift * 6 + 4)
-            + sizeof(char) * (62 + 1);
-    json = (char *) my_malloc(json_size, "JSON representation");
-    res = sprintf(json,
-            "%s{\n"
-            "%s%s\"type\": \"%s\",\n"
-            "%s%s\"content\": %s,\n"
-            "%s%s\"children_number\": %s,\n"
-            "%s%s\"children\": %s\n"
-            "%s}",
-            act_tab,
-            act_tab, tab, type_str,
-            act_tab, tab, content_str,
-            act_tab, tab, children_num_str,
-            act_tab, tab, children_str,
-            act_tab);
-    free(act_tab);
-    free(content_str);
-    free(children_num_str);
-    free(children_str);
-    if (res < 0)
-    {
-        fprintf(stderr,
-            "FATAL ERROR! String formatting cannot be applied!\n");
-        exit(-1);
-    }
-    return json;
+    write_indent(out, shift, tab, tab_len);
+    writer_putc(out, '}');
 }
+
+void ast_bin_write_json(WRITER *out, const AST_BIN *bin, uint32_t root, int shift, char *tab)
+{
+    write_json_bin(out, bin, root, shift, tab, strlen(tab));
+}
+
+void ast_flat_count_nodes(const AST_FLAT *flat, size_t counts[AST_NODE_TYPES_NUMBER])
+{
+    for (uint32_t i = 0; i < flat->nodes_number; ++i) ++counts[flat->types[i]];
+}
+
+void ast_flat_free(AST_FLAT *flat)
+{
+    my_free(flat->types);
+    my_free(flat->contents);
+    my_free(flat->first_child);
+    my_free(flat->children_number);
+    my_free(flat->children);
+    my_free(flat->top);
+    arena_free(&flat->strings);
+    *flat = (AST_FLAT) {0};
+}
\ No newline at end of file
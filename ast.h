@@ -8,6 +8,13 @@
 #ifndef C_PARSER_AST_BUILDER_H_INCLUDED
 #define C_PARSER_AST_BUILDER_H_INCLUDED
 
+#include <stddef.h>
+#include <stdint.h>
+#include "alloc_wrap.h"
+#include "ast_binary.h"
+#include "constant.h"
+#include "writer.h"
+
 /// Types of AST node content.
 typedef enum
 {
@@ -79,6 +86,9 @@ typedef enum
 }
 AST_NODE_TYPE;
 
+/// Number of the node types.
+#define AST_NODE_TYPES_NUMBER (CharacterConstant + 1)
+
 typedef union
 {
     int token;
@@ -86,32 +96,124 @@ typedef union
 }
 AST_CONTENT;
 
-/// Structure for storing AST node data.
+/// Structure for storing AST node data. Character constants and string literals
+/// keep their spelling between the quotes, see `ast_literal_value' for their values.
+/// Integer and floating constants keep their spelling, and their value if it is known
+/// (see `ast_constant_value').
 typedef struct AST_NODE
 {
     AST_NODE_TYPE type;
+    /// Is the value of the constant stored after the node (see `ast_create_value_node')?
+    _Bool has_value;
     AST_CONTENT content;
     int children_number;
+    /// Length of the spelling `content.value' points to inside of the source text,
+    /// not null-terminated (see `PARSE_CONTEXT.source_kept'); 0 - `content.value' is null-terminated
+    uint32_t length;
     struct AST_NODE **children;
 }
 AST_NODE;
 
+/// Index of a node inside of a flat AST.
+typedef uint32_t AST_ID;
+
+/// Index standing for an absent (`null') node.
+#define AST_NULL_ID ((AST_ID) -1)
+
+/// Flat AST storage. Node `i' is described by the i-th element of
+/// parallel arrays, its children are `children_number[i]' indices in
+/// `children' starting from `first_child[i]'. Nodes are stored in
+/// pre-order, so whole-tree walks are linear scans. The parser fills it by copying
+/// its pointer-linked declarations one by one (see `ast_flat_collect').
+typedef struct
+{
+    uint32_t nodes_number;
+    uint32_t nodes_capacity;
+    unsigned char *types;
+    AST_CONTENT *contents;
+    uint32_t *first_child;
+    uint32_t *children_number;
+    AST_ID *children;
+    uint32_t children_len;
+    uint32_t children_capacity;
+    AST_ID *top;
+    uint32_t top_number;
+    uint32_t top_capacity;
+    ARENA strings;
+}
+AST_FLAT;
+
+/// Output of streaming mode: every completed top-level declaration
+/// is written as one line of compact JSON, then released.
+typedef struct
+{
+    WRITER *out;
+    char *(*cont_to_str)(AST_NODE *);
+    /// Number of declarations written
+    size_t declarations;
+    /// Numbers of nodes written by type (see `ast_count_nodes'), NULL if they are not counted
+    size_t *node_counts;
+}
+AST_STREAM;
+
+/// Allocate memory with the lifetime of AST nodes.
+///
+/// \param arena Arena owning the tree, NULL - allocate on the heap
+/// \param size Size to allocate
+/// \param description String to output inside warning, type of content
+/// \return New allocated memory
+void *ast_alloc(ARENA *arena, size_t size, char *description);
+
+/// Copy the given string into memory with the lifetime of AST nodes.
+///
+/// \param arena Arena owning the tree, NULL - allocate on the heap
+/// \param str String to copy
+/// \return Copy of the given string
+char *ast_alloc_str(ARENA *arena, const char *str);
+
+/// Release a string got from `ast_alloc_str' before the tree is freed.
+/// Does nothing for arena-allocated strings.
+///
+/// \param arena Arena the string was allocated in, or NULL
+/// \param str String to release
+void ast_free_str(ARENA *arena, char *str);
+
 /// Create node with a given set of children.
-/// Needs to be freed.
+/// Needs to be freed if allocated on the heap.
 ///
+/// \param arena Arena owning the tree, NULL - allocate on the heap
 /// \param type Type of AST node
 /// \param content Content to store in the node
 /// \param n_children Number of children
 /// \param ... List of children
 /// \return New AST node
-AST_NODE *ast_create_node(AST_NODE_TYPE type, AST_CONTENT content, int n_children, ...);
+AST_NODE *ast_create_node(ARENA *arena, AST_NODE_TYPE type, AST_CONTENT content, int n_children, ...);
+
+/// Create node of an integer or floating constant together with its value.
+/// Needs to be freed if allocated on the heap.
+///
+/// \param arena Arena owning the tree, NULL - allocate on the heap
+/// \param type Type of AST node
+/// \param content Spelling of the constant
+/// \param value Value of the constant
+/// \return New AST node
+AST_NODE *ast_create_value_node(ARENA *arena, AST_NODE_TYPE type, AST_CONTENT content, const CONSTANT_VALUE *value);
+
+/// Value of an integer or floating constant node as the lexer converted it.
+///
+/// \param node Node to get the value of
+/// \return Value of the constant, NULL if it is not stored (other nodes, constants of
+///         no type, constants scanned without `PARSE_CONTEXT.typed_constants', nodes of
+///         flat and binary ASTs - see `constant_convert' for those)
+const CONSTANT_VALUE *ast_constant_value(const AST_NODE *node);
 
 /// Append given child to the given AST node.
 ///
+/// \param arena Arena the node was created in, or NULL
 /// \param node Node to append child to
 /// \param to_append Child to append to the node
 /// \return New node after expansion
-AST_NODE *ast_expand_node(AST_NODE *node, AST_NODE *to_append);
+AST_NODE *ast_expand_node(ARENA *arena, AST_NODE *node, AST_NODE *to_append);
 
 /// Convert enum AST_NODE_TYPE to string.
 ///
@@ -120,10 +222,54 @@ AST_NODE *ast_expand_node(AST_NODE *node, AST_NODE *to_append);
 char *ast_type_to_str(AST_NODE_TYPE type);
 
 /// Free memory associated with node and it's children.
+/// Only for trees allocated on the heap, an arena is released by `arena_free'.
 ///
 /// \param root Root of the tree to be freed recursively
 void ast_free(AST_NODE *root);
 
+/// Count nodes of the tree by type.
+///
+/// \param root Root of the tree, may be NULL
+/// \param counts Numbers of nodes indexed by `AST_NODE_TYPE', incremented
+void ast_count_nodes(const AST_NODE *root, size_t counts[AST_NODE_TYPES_NUMBER]);
+
+/// Value of a character constant or string literal node. The nodes keep the spelling
+/// of the literal between its quotes, the value is decoded from it on every call (see `literal_decode').
+///
+/// \param arena Arena to allocate the value in, NULL - allocate on the heap (needs to be freed)
+/// \param node Literal node
+/// \param length If not NULL, receives the length of the value, which may contain null characters
+/// \return Null-terminated value, NULL if the spelling has an invalid escape sequence
+char *ast_literal_value(ARENA *arena, const AST_NODE *node, size_t *length);
+
+/// Write JSON representation of an AST into the given writer.
+/// The tree is walked once, nothing is accumulated apart from the writer's buffer.
+/// If `out->typed_constants' is set, integer and floating constants get `value' (a JSON number)
+/// and `value_type' (like "unsigned long") fields after `content', `null' if they have no value.
+///
+/// \param out Writer to write JSON to
+/// \param root Root of the tree to be converted to JSON
+/// \param shift Shift size at the beginning of line
+/// \param tab String representation of the tabulation
+/// \param cont_to_str Function for printing the content of the node
+void ast_write_json(WRITER *out, AST_NODE *root, int shift, char *tab, char *(*cont_to_str)(AST_NODE *));
+
+/// Trees with fewer nodes are written by `ast_write_json_parallel' on the calling thread only.
+#define AST_JSON_PARALLEL_MIN_NODES 65536
+
+/// Write the same JSON as `ast_write_json', serializing runs of the root's children
+/// into separate buffers on `workers' threads and joining them in order.
+/// Small trees and trees with one child are written sequentially.
+///
+/// \param out Writer to write JSON to
+/// \param root Root of the tree to be converted to JSON
+/// \param shift Shift size at the beginning of line
+/// \param tab String representation of the tabulation
+/// \param cont_to_str Function for printing the content of the node, called concurrently
+/// \param workers Number of threads to use
+void ast_write_json_parallel(WRITER *out, AST_NODE *root, int shift, char *tab, char *(*cont_to_str)(AST_NODE *),
+                             int workers);
+
 /// Get JSON string representation of an AST. Needs to be freed.
 ///
 /// \param root Root of the tree to be converted to JSON
@@ -133,4 +279,98 @@ void ast_free(AST_NODE *root);
 /// \return JSON representation of a tree
 char *ast_to_json(AST_NODE *root, int shift, char *tab, char *(*cont_to_str)(AST_NODE *));
 
+/// Write JSON representation of an AST in one line, without any whitespace.
+///
+/// \param out Writer to write JSON to
+/// \param root Root of the tree to be converted to JSON
+/// \param cont_to_str Function for printing the content of the node
+void ast_write_json_line(WRITER *out, AST_NODE *root, char *(*cont_to_str)(AST_NODE *));
+
+/// Write a completed top-level declaration as a line of the stream and release it.
+/// The pointer-linked nodes are scratch: their arena is reset right away, only the node
+/// of the lookahead token is moved into it, so it never holds more than one declaration.
+///
+/// \param stream Stream to write to
+/// \param scratch Arena holding the declaration
+/// \param declaration Root of the declaration subtree
+/// \param lookahead Node of the token already read after the declaration, updated;
+///                  NULL if no token was read or it has no node
+void ast_stream_collect(AST_STREAM *stream, ARENA *scratch, AST_NODE *declaration, AST_NODE **lookahead);
+
+/// Initialize an empty flat AST. Node 0 is reserved for the TranslationUnit root.
+///
+/// \param flat Flat AST to initialize
+void ast_flat_init(AST_FLAT *flat);
+
+/// Copy a completed top-level declaration into the flat AST.
+/// The pointer-linked nodes are scratch: their arena is reset right away, only the node
+/// of the lookahead token is moved into it, so it never holds more than one declaration.
+///
+/// \param flat Flat AST to append to
+/// \param scratch Arena holding the declaration
+/// \param declaration Root of the declaration subtree
+/// \param lookahead Node of the token already read after the declaration, updated;
+///                  NULL if no token was read or it has no node
+void ast_flat_collect(AST_FLAT *flat, ARENA *scratch, AST_NODE *declaration, AST_NODE **lookahead);
+
+/// Copy a pointer-linked subtree into the flat AST as the last top-level declaration.
+///
+/// \param flat Flat AST to append to
+/// \param declaration Root of the subtree to copy
+/// \return Index of the copied root
+AST_ID ast_flat_append(AST_FLAT *flat, AST_NODE *declaration);
+
+/// Complete the TranslationUnit root (node 0) with the appended declarations.
+///
+/// \param flat Flat AST to complete
+/// \return Index of the root
+AST_ID ast_flat_finish(AST_FLAT *flat);
+
+/// Write JSON representation of a flat AST, identical to `ast_write_json'.
+///
+/// \param out Writer to write JSON to
+/// \param flat Flat AST to be converted
+/// \param root Index of the subtree root
+/// \param shift Shift size at the beginning of line
+/// \param tab String representation of the tabulation
+/// \param cont_to_str Function for printing the content of the node
+void ast_flat_write_json(WRITER *out, AST_FLAT *flat, AST_ID root, int shift, char *tab,
+                         char *(*cont_to_str)(AST_NODE *));
+
+/// Write the AST in the binary format of `ast_binary.h'. Contents are stored as strings
+/// given by `cont_to_str', so the file does not depend on token codes.
+///
+/// \param out Writer to write to
+/// \param root Root of the tree to be written
+/// \param cont_to_str Function for printing the content of the node
+void ast_write_binary(WRITER *out, AST_NODE *root, char *(*cont_to_str)(AST_NODE *));
+
+/// Write a flat AST in the binary format of `ast_binary.h', same as `ast_write_binary'.
+///
+/// \param out Writer to write to
+/// \param flat Flat AST to be written
+/// \param root Index of the subtree root
+/// \param cont_to_str Function for printing the content of the node
+void ast_flat_write_binary(WRITER *out, AST_FLAT *flat, AST_ID root, char *(*cont_to_str)(AST_NODE *));
+
+/// Write JSON representation of a binary AST, identical to `ast_write_json' of the original tree.
+///
+/// \param out Writer to write JSON to
+/// \param bin Opened binary AST
+/// \param root Index of the subtree root
+/// \param shift Shift size at the beginning of line
+/// \param tab String representation of the tabulation
+void ast_bin_write_json(WRITER *out, const AST_BIN *bin, uint32_t root, int shift, char *tab);
+
+/// Count nodes of the flat AST by type.
+///
+/// \param flat Flat AST
+/// \param counts Numbers of nodes indexed by `AST_NODE_TYPE', incremented
+void ast_flat_count_nodes(const AST_FLAT *flat, size_t counts[AST_NODE_TYPES_NUMBER]);
+
+/// Free memory associated with the flat AST.
+///
+/// \param flat Flat AST to free
+void ast_flat_free(AST_FLAT *flat);
+
 #endif //C_PARSER_AST_BUILDER_H_INCLUDED
@@ -0,0 +1,118 @@
+/**
+ * Binary AST file format and its reader. The file is used in place:
+ * it is mapped into memory and walked through indices, nothing is decoded.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc_wrap.h"
+#include "ast.h"
+#include "ast_binary.h"
+#include "source_map.h"
+
+/// Does the section of `number' elements of `size' bytes at `offset' fit into the file?
+///
+/// \param offset Offset of the section
+/// \param number Number of elements
+/// \param size Size of one element
+/// \param file_size Size of the file
+/// \return `true' - it fits and is aligned, `false' - otherwise
+static _Bool section_fits(uint32_t offset, uint32_t number, size_t size, size_t file_size)
+{
+    return offset % 4 == 0 && (uint64_t) offset + (uint64_t) number * size <= file_size;
+}
+
+_Bool ast_bin_load(AST_BIN *bin, const void *data, size_t size)
+{
+    const AST_BIN_HEADER *header = (const AST_BIN_HEADER *) data;
+    if (size < sizeof(AST_BIN_HEADER) || memcmp(header->magic, AST_BIN_MAGIC, 4) != 0
+        || header->version != AST_BIN_VERSION
+        || !section_fits(header->nodes_offset, header->nodes_number, sizeof(AST_BIN_NODE), size)
+        || !section_fits(header->children_offset, header->children_number, sizeof(uint32_t), size)
+        || (uint64_t) header->strings_offset + header->strings_size > size
+        || (header->root != AST_BIN_NULL && header->root >= header->nodes_number))
+    {
+        return false;
+    }
+    const char *base = (const char *) data;
+    bin->header = header;
+    bin->nodes = (const AST_BIN_NODE *) (base + header->nodes_offset);
+    bin->children = (const uint32_t *) (base + header->children_offset);
+    bin->strings = base + header->strings_offset;
+    if (header->strings_size > 0 && bin->strings[header->strings_size - 1] != '\0') return false;
+
+    // Types are known and children always follow their parents, so walks over the tree terminate
+    for (uint32_t i = 0; i < header->nodes_number; ++i)
+    {
+        const AST_BIN_NODE *node = &bin->nodes[i];
+        if (node->type >= AST_NODE_TYPES_NUMBER
+            || (node->content != AST_BIN_NULL && node->content >= header->strings_size)
+            || (uint64_t) node->first_child + node->children_number > header->children_number)
+        {
+            return false;
+        }
+        for (uint32_t j = 0; j < node->children_number; ++j)
+        {
+            uint32_t child = bin->children[node->first_child + j];
+            if (child != AST_BIN_NULL && (child <= i || child >= header->nodes_number)) return false;
+        }
+    }
+    return true;
+}
+
+_Bool ast_bin_open(AST_BIN *bin, const char *name)
+{
+    bin->copy = NULL;
+    FILE *file = fopen(name, "rb");
+    if (!file)
+    {
+        fprintf(stderr, "Cannot open for reading: %s\n", name);
+        return false;
+    }
+    const void *data;
+    size_t size;
+    if (source_map(&bin->map, file))
+    {
+        data = bin->map.data;
+        size = bin->map.size;
+    }
+    else
+    {
+        // Not a regular file, or no `mmap': read it whole
+        size_t capacity = 65536;
+        size = 0;
+        bin->copy = (char *) my_malloc(capacity, "binary AST");
+        size_t read;
+        while ((read = fread(bin->copy + size, 1, capacity - size, file)) > 0)
+        {
+            size += read;
+            if (size == capacity)
+            {
+                capacity *= 2;
+                bin->copy = (char *) my_realloc(bin->copy, capacity, "binary AST");
+            }
+        }
+        data = bin->copy;
+    }
+    _Bool failed = ferror(file);
+    fclose(file);
+    if (failed || !ast_bin_load(bin, data, size))
+    {
+        fprintf(stderr, failed ? "Cannot read opened source file: %s\n" : "Not a binary AST file: %s\n", name);
+        ast_bin_close(bin);
+        return false;
+    }
+    return true;
+}
+
+void ast_bin_close(AST_BIN *bin)
+{
+    source_unmap(&bin->map);
+    my_free(bin->copy);
+    bin->copy = NULL;
+    bin->header = NULL;
+}
@@ -0,0 +1,148 @@
+/**
+ * Binary AST file format and its reader. The file is used in place:
+ * it is mapped into memory and walked through indices, nothing is decoded.
+ *
+ * Layout (all numbers are 32-bit, in the byte order of the writer;
+ * a reader of the other byte order rejects the file by `version'):
+ *   header   - `AST_BIN_HEADER';
+ *   nodes    - `nodes_number' of `AST_BIN_NODE', in pre-order;
+ *   children - `children_number' node indices, `AST_BIN_NULL' for absent children;
+ *   strings  - null-terminated contents of the nodes, each distinct one stored once;
+ *              character constants and string literals are stored as spelled (see `literal_decode').
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#ifndef C_PARSER_AST_BINARY_H_INCLUDED
+#define C_PARSER_AST_BINARY_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include "source_map.h"
+
+/// First bytes of a binary AST file.
+#define AST_BIN_MAGIC "CAST"
+
+/// Version of the format, changes with `AST_NODE_TYPE' and the meaning of contents.
+#define AST_BIN_VERSION 2
+
+/// Index standing for an absent node or content.
+#define AST_BIN_NULL ((uint32_t) -1)
+
+/// Header at the beginning of the file. Offsets are counted from the file start.
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t root;
+    uint32_t nodes_number;
+    uint32_t nodes_offset;
+    uint32_t children_number;
+    uint32_t children_offset;
+    uint32_t strings_size;
+    uint32_t strings_offset;
+    uint32_t reserved;
+}
+AST_BIN_HEADER;
+
+/// Node of the binary AST.
+typedef struct
+{
+    /// Value of `AST_NODE_TYPE'
+    uint32_t type;
+    /// Offset of the content in the strings, `AST_BIN_NULL' for no content
+    uint32_t content;
+    /// Index of the first child in the children
+    uint32_t first_child;
+    uint32_t children_number;
+}
+AST_BIN_NODE;
+
+/// Binary AST opened for reading.
+typedef struct
+{
+    const AST_BIN_HEADER *header;
+    const AST_BIN_NODE *nodes;
+    const uint32_t *children;
+    const char *strings;
+    /// Mapping of the file, if it is mapped
+    SOURCE_MAP map;
+    /// Copy of the file, if it cannot be mapped
+    char *copy;
+}
+AST_BIN;
+
+/// Use the binary AST in memory. The memory is not copied and must outlive `bin'.
+/// Everything is checked to be in bounds, so accessors below need no checks.
+///
+/// \param bin Binary AST to initialize
+/// \param data Content of a binary AST file, aligned to 4 bytes
+/// \param size Size of `data'
+/// \return `true' - OK, `false' - it is not a correct binary AST
+_Bool ast_bin_load(AST_BIN *bin, const void *data, size_t size);
+
+/// Map the binary AST file into memory (or read it, if mapping is not possible).
+/// Errors are printed to `stderr'.
+///
+/// \param bin Binary AST to initialize
+/// \param name Name of the file
+/// \return `true' - OK, `false' - it cannot be read or it is not a correct binary AST
+_Bool ast_bin_open(AST_BIN *bin, const char *name);
+
+/// Release the file opened by `ast_bin_open'.
+///
+/// \param bin Binary AST to close
+void ast_bin_close(AST_BIN *bin);
+
+/// Index of the root node.
+///
+/// \param bin Binary AST
+/// \return Index of the root, `AST_BIN_NULL' for an empty tree
+static inline uint32_t ast_bin_root(const AST_BIN *bin)
+{
+    return bin->header->root;
+}
+
+/// Type of the node.
+///
+/// \param bin Binary AST
+/// \param node Index of the node
+/// \return Value of `AST_NODE_TYPE'
+static inline uint32_t ast_bin_type(const AST_BIN *bin, uint32_t node)
+{
+    return bin->nodes[node].type;
+}
+
+/// Content of the node.
+///
+/// \param bin Binary AST
+/// \param node Index of the node
+/// \return String content, NULL if there is none
+static inline const char *ast_bin_content(const AST_BIN *bin, uint32_t node)
+{
+    uint32_t content = bin->nodes[node].content;
+    return content == AST_BIN_NULL ? NULL : bin->strings + content;
+}
+
+/// Number of children of the node.
+///
+/// \param bin Binary AST
+/// \param node Index of the node
+/// \return Number of children, absent ones included
+static inline uint32_t ast_bin_children_number(const AST_BIN *bin, uint32_t node)
+{
+    return bin->nodes[node].children_number;
+}
+
+/// Child of the node.
+///
+/// \param bin Binary AST
+/// \param node Index of the node
+/// \param i Index of the child, less than `ast_bin_children_number'
+/// \return Index of the child, `AST_BIN_NULL' if it is absent
+static inline uint32_t ast_bin_child(const AST_BIN *bin, uint32_t node, uint32_t i)
+{
+    return bin->children[bin->nodes[node].first_child + i];
+}
+
+#endif //C_PARSER_AST_BINARY_H_INCLUDED
@@ -0,0 +1,200 @@
+/**
+ * Batch mode: conversion of many source files on a pool of worker threads.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "alloc_wrap.h"
+#include "batch.h"
+#include "convert.h"
+#include "header_cache.h"
+#include "result_cache.h"
+#include "string_tools.h"
+#include "thread_pool.h"
+
+/// Maximum length of a line of a file list.
+#define BATCH_LINE_SIZE 4096
+
+void batch_list_init(BATCH_LIST *list)
+{
+    *list = (BATCH_LIST) {NULL, 0, 0};
+}
+
+/// Append one file to the list.
+///
+/// \param list List to append to
+/// \param name Name of the file
+static void add_file(BATCH_LIST *list, const char *name)
+{
+    if (list->number == list->capacity)
+    {
+        list->capacity = list->capacity ? list->capacity * 2 : 64;
+        list->files = (BATCH_FILE *) my_realloc(list->files, sizeof(BATCH_FILE) * list->capacity, "batch file list");
+    }
+    struct stat info;
+    long long size = stat(name, &info) == 0 ? (long long) info.st_size : 0;
+    list->files[list->number++] = (BATCH_FILE) {alloc_const_str(name), size, CONVERT_OK};
+}
+
+/// Append the files listed in the given stream, one name per line.
+///
+/// \param list List to append to
+/// \param in Stream to read names from
+static void add_listed(BATCH_LIST *list, FILE *in)
+{
+    char line[BATCH_LINE_SIZE];
+    while (fgets(line, sizeof(line), in))
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] != '\0') add_file(list, line);
+    }
+}
+
+int batch_list_add(BATCH_LIST *list, const char *arg)
+{
+    if (strcmp(arg, "-") == 0)
+    {
+        add_listed(list, stdin);
+    }
+    else if (arg[0] == '@')
+    {
+        FILE *in = fopen(arg + 1, "r");
+        if (!in)
+        {
+            fprintf(stderr, "Cannot open for reading: %s\n", arg + 1);
+            return 3;
+        }
+        add_listed(list, in);
+        fclose(in);
+    }
+    else
+    {
+        add_file(list, arg);
+    }
+    return 0;
+}
+
+void batch_list_free(BATCH_LIST *list)
+{
+    for (size_t i = 0; i < list->number; ++i) my_free(list->files[i].name);
+    my_free(list->files);
+    batch_list_init(list);
+}
+
+char *batch_output_name(const char *out_dir, const char *in_name, const char *extension)
+{
+    size_t dir_len = strlen(out_dir);
+    char *res = (char *) my_malloc(dir_len + 1 + strlen(in_name) * 3 + strlen(extension) + 1, "output file name");
+    memcpy(res, out_dir, dir_len);
+    char *p = res + dir_len;
+    if (dir_len > 0 && out_dir[dir_len - 1] != '/' && out_dir[dir_len - 1] != '\\') *p++ = '/';
+    for (const char *c = in_name; *c; ++c)
+    {
+        switch (*c)
+        {
+            case '%':  memcpy(p, "%25", 3); p += 3; break;
+            case '/':  memcpy(p, "%2F", 3); p += 3; break;
+            case '\\': memcpy(p, "%5C", 3); p += 3; break;
+            case ':':  memcpy(p, "%3A", 3); p += 3; break;
+            default: *p++ = *c;
+        }
+    }
+    strcpy(p, extension);
+    return res;
+}
+
+/// Order of files: the largest first, then by name, so scheduling is deterministic.
+///
+/// \param a First BATCH_FILE
+/// \param b Second BATCH_FILE
+/// \return Negative - `a' goes first, positive - `b' goes first
+static int by_size_desc(const void *a, const void *b)
+{
+    const BATCH_FILE *fa = (const BATCH_FILE *) a;
+    const BATCH_FILE *fb = (const BATCH_FILE *) b;
+    if (fa->size != fb->size) return fa->size > fb->size ? -1 : 1;
+    return strcmp(fa->name, fb->name);
+}
+
+/// Argument of `convert_job'.
+typedef struct
+{
+    BATCH_LIST *list;
+    const BATCH_OPTIONS *options;
+}
+BATCH_RUN;
+
+/// Convert one file of the batch.
+///
+/// \param job Index of the file
+/// \param worker Index of the worker thread, not used
+/// \param arg The batch (BATCH_RUN)
+static void convert_job(size_t job, int worker, void *arg)
+{
+    (void) worker;
+    BATCH_RUN *run = (BATCH_RUN *) arg;
+    BATCH_FILE *file = &run->list->files[job];
+    char *out_name = batch_output_name(run->options->out_dir, file->name,
+                                       run->options->convert.binary ? ".ast"
+                                       : run->options->convert.ndjson ? ".ndjson" : ".json");
+    file->result = convert_file(file->name, out_name, &run->options->convert);
+    my_free(out_name);
+}
+
+/// Current wall-clock time.
+///
+/// \return Seconds since some fixed moment
+static double wall_seconds()
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double) ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int batch_run(BATCH_LIST *list, const BATCH_OPTIONS *options)
+{
+    qsort(list->files, list->number, sizeof(BATCH_FILE), by_size_desc);
+    BATCH_RUN run = {list, options};
+    double start = wall_seconds();
+    thread_pool_run(list->number, options->jobs, convert_job, &run);
+    double seconds = wall_seconds() - start;
+
+    int res = 0;
+    size_t failed = 0;
+    long long bytes = 0;
+    for (size_t i = 0; i < list->number; ++i)
+    {
+        BATCH_FILE *file = &list->files[i];
+        bytes += file->size;
+        if (file->result == CONVERT_OK) continue;
+        ++failed;
+        fprintf(stderr, "FAILED: %s (%s)\n", file->name,
+                file->result == CONVERT_IO_ERROR ? "I/O error" : "parsing error");
+        if (file->result > res) res = file->result;
+    }
+    double mb = bytes / (1024.0 * 1024.0);
+    if (seconds <= 0) seconds = 1e-9;
+    fprintf(stderr, "Converted %zu of %zu files (%zu failed), %.2f MB in %.3f s with %d threads: "
+                    "%.1f files/s, %.2f MB/s\n",
+            list->number - failed, list->number, failed, mb, seconds, options->jobs,
+            list->number / seconds, mb / seconds);
+    size_t hits, misses, headers;
+    header_cache_stats(&hits, &misses, &headers);
+    if (hits + misses > 0)
+    {
+        fprintf(stderr, "Header cache: %zu includes replayed, %zu scanned, %zu headers cached\n",
+                hits, misses, headers);
+    }
+    size_t evictions;
+    result_cache_stats(&hits, &misses, &evictions);
+    if (hits + misses > 0)
+    {
+        fprintf(stderr, "Result cache: %zu hits, %zu misses, %zu entries evicted\n", hits, misses, evictions);
+    }
+    return res;
+}
@@ -0,0 +1,79 @@
+/**
+ * Batch mode: conversion of many source files on a pool of worker threads.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#ifndef C_PARSER_BATCH_H_INCLUDED
+#define C_PARSER_BATCH_H_INCLUDED
+
+#include <stddef.h>
+#include "convert.h"
+
+/// One input of the batch.
+typedef struct
+{
+    char *name;
+    long long size;
+    int result;
+}
+BATCH_FILE;
+
+/// List of inputs of the batch.
+typedef struct
+{
+    BATCH_FILE *files;
+    size_t number;
+    size_t capacity;
+}
+BATCH_LIST;
+
+/// How the batch is run.
+typedef struct
+{
+    /// Number of worker threads
+    int jobs;
+    /// Directory to put outputs into
+    const char *out_dir;
+    /// How every file is converted
+    CONVERT_OPTIONS convert;
+}
+BATCH_OPTIONS;
+
+/// Initialize an empty list of inputs.
+///
+/// \param list List to initialize
+void batch_list_init(BATCH_LIST *list);
+
+/// Add inputs given by one command-line argument: a file name,
+/// `@file' - names listed in the file, one per line, or `-' - names listed in `stdin'.
+///
+/// \param list List to add to
+/// \param arg Command-line argument
+/// \return 0 - OK, 3 - the listing file cannot be read
+int batch_list_add(BATCH_LIST *list, const char *arg);
+
+/// Free memory associated with the list.
+///
+/// \param list List to free
+void batch_list_free(BATCH_LIST *list);
+
+/// Get the name of the output for the given input: `<out_dir>/<escaped input><extension>',
+/// where `%', `/', `\' and `:' in the input name are escaped as `%25', `%2F', `%5C' and `%3A'.
+/// Different inputs always get different outputs. Needs to be freed.
+///
+/// \param out_dir Directory to put outputs into
+/// \param in_name Name of the input
+/// \param extension Suffix of the output name, like ".json"
+/// \return Name of the output
+char *batch_output_name(const char *out_dir, const char *in_name, const char *extension);
+
+/// Convert all the files of the list, the largest first,
+/// and print the summary of failures and throughput to `stderr'.
+///
+/// \param list Inputs, `result' of each is set
+/// \param options How to run the batch
+/// \return 0 - all converted, 1 - some source is not correct, 3 - some I/O failed
+int batch_run(BATCH_LIST *list, const BATCH_OPTIONS *options);
+
+#endif //C_PARSER_BATCH_H_INCLUDED
@@ -0,0 +1,289 @@
+/**
+ * Conversion of integer and floating constants of the
+ * C Programming Language (ISO/IEC 9899:2018) into binary values.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <float.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <locale.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc_wrap.h"
+#include "constant.h"
+
+/// Size of the buffer on the stack for null-terminated copies of floating constants.
+#define CONSTANT_BUFFER_SIZE 128
+
+#ifdef _WIN32
+
+/// There is no `newlocale' on Windows: numbers are converted in the locale of the program,
+/// with its decimal point put in place of `.' (see `swap_point').
+typedef int SAVED_LOCALE;
+
+/// Nothing to switch on Windows, see `SAVED_LOCALE'.
+static SAVED_LOCALE use_c_locale(void)
+{
+    return 0;
+}
+
+/// Nothing to switch back on Windows, see `SAVED_LOCALE'.
+static void restore_locale(SAVED_LOCALE old)
+{
+    (void) old;
+}
+
+/// Decimal point `strtod' and `%g' use.
+///
+/// \return Decimal point of the locale, `.' if it is longer than a byte
+static char local_point(void)
+{
+    const char *point = localeconv()->decimal_point;
+    return point && point[0] && !point[1] ? point[0] : '.';
+}
+
+#else
+
+#include <pthread.h>
+
+/// Locale of the thread before `use_c_locale'.
+typedef locale_t SAVED_LOCALE;
+
+/// Locale "C" constants are read and written in, whatever the locale of the program is.
+static locale_t c_locale;
+static pthread_once_t c_locale_once = PTHREAD_ONCE_INIT;
+
+/// Create `c_locale', once.
+static void c_locale_init(void)
+{
+    c_locale = newlocale(LC_ALL_MASK, "C", (locale_t) 0);
+}
+
+/// Switch the calling thread to locale "C", so `strtod' and `%g' use `.' as the decimal point.
+///
+/// \return Locale of the thread to switch back to with `restore_locale'
+static SAVED_LOCALE use_c_locale(void)
+{
+    pthread_once(&c_locale_once, &c_locale_init);
+    return c_locale ? uselocale(c_locale) : uselocale((locale_t) 0);
+}
+
+/// Switch the calling thread back to its locale.
+///
+/// \param old Locale given by `use_c_locale'
+static void restore_locale(SAVED_LOCALE old)
+{
+    uselocale(old);
+}
+
+/// Decimal point `strtod' and `%g' use in locale "C".
+static char local_point(void)
+{
+    return '.';
+}
+
+#endif
+
+/// Replace the decimal point of a number.
+///
+/// \param number Null-terminated number
+/// \param from Decimal point to replace
+/// \param to Decimal point to put instead
+static void swap_point(char *number, char from, char to)
+{
+    if (from == to) return;
+    char *point = strchr(number, from);
+    if (point) *point = to;
+}
+
+/// Value of a digit.
+///
+/// \param c Character to convert
+/// \return Value of the digit, -1 - it is not a hexadecimal digit
+static int digit_value(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/// Largest value of an integer type.
+///
+/// \param type Integer type
+/// \return Its largest value
+static uint64_t integer_max(CONSTANT_TYPE type)
+{
+    switch (type)
+    {
+        case CONSTANT_INT: return INT_MAX;
+        case CONSTANT_UNSIGNED_INT: return UINT_MAX;
+        case CONSTANT_LONG: return LONG_MAX;
+        case CONSTANT_UNSIGNED_LONG: return ULONG_MAX;
+        case CONSTANT_LONG_LONG: return LLONG_MAX;
+        default: return ULLONG_MAX;
+    }
+}
+
+/// Convert the spelling of an integer constant, see `constant_convert'.
+static _Bool convert_integer(const char *spelling, size_t len, CONSTANT_VALUE *value)
+{
+    size_t i = 0;
+    int base = 10;
+    if (len > 1 && spelling[0] == '0')
+    {
+        base = spelling[1] == 'x' || spelling[1] == 'X' ? 16 : 8;
+        i = base == 16 ? 2 : 1;
+    }
+    size_t first_digit = i;
+    uint64_t res = 0;
+    for (int d; i < len && (d = digit_value(spelling[i])) >= 0 && d < base; ++i)
+    {
+        if (res > (UINT64_MAX - (uint64_t) d) / (uint64_t) base) return false;
+        res = res * (uint64_t) base + (uint64_t) d;
+    }
+    if (base == 16 && i == first_digit) return false;
+
+    _Bool is_unsigned = false;
+    int longs = 0;
+    for (; i < len; ++i)
+    {
+        if ((spelling[i] == 'u' || spelling[i] == 'U') && !is_unsigned)
+        {
+            is_unsigned = true;
+        }
+        else if ((spelling[i] == 'l' || spelling[i] == 'L') && !longs)
+        {
+            longs = i + 1 < len && spelling[i + 1] == spelling[i] ? 2 : 1;
+            i += longs - 1;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    // The first type of the list holding the value, ISO/IEC 9899:2017, page 46:
+    // `int', `long' and `long long' go with their unsigned types for octal and hexadecimal
+    // constants, `u' leaves only unsigned types
+    for (int type = longs * 2; type <= CONSTANT_UNSIGNED_LONG_LONG; ++type)
+    {
+        _Bool unsigned_type = type % 2 == 1;
+        if (is_unsigned ? !unsigned_type : (unsigned_type && base == 10)) continue;
+        if (res <= integer_max((CONSTANT_TYPE) type))
+        {
+            value->type = (CONSTANT_TYPE) type;
+            value->integer = res;
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Convert the spelling of a floating constant, see `constant_convert'.
+static _Bool convert_floating(const char *spelling, size_t len, CONSTANT_VALUE *value)
+{
+    value->type = CONSTANT_DOUBLE;
+    if (len > 0 && (spelling[len - 1] == 'f' || spelling[len - 1] == 'F')) value->type = CONSTANT_FLOAT;
+    if (len > 0 && (spelling[len - 1] == 'l' || spelling[len - 1] == 'L')) value->type = CONSTANT_LONG_DOUBLE;
+    if (value->type != CONSTANT_DOUBLE) --len;
+    if (len == 0) return false;
+    // `strtod' would take hexadecimal ones without the binary exponent too
+    if (len > 1 && (spelling[1] == 'x' || spelling[1] == 'X')
+        && !memchr(spelling, 'p', len) && !memchr(spelling, 'P', len))
+    {
+        return false;
+    }
+
+    // `strtod' and similar need a null-terminated string
+    char small[CONSTANT_BUFFER_SIZE];
+    char *copy = len < sizeof(small) ? small : (char *) my_malloc(len + 1, "floating constant");
+    memcpy(copy, spelling, len);
+    copy[len] = '\0';
+    char *end;
+    _Bool finite;
+    SAVED_LOCALE old_locale = use_c_locale();
+    swap_point(copy, '.', local_point());
+    switch (value->type)
+    {
+        case CONSTANT_FLOAT:
+            value->real = strtof(copy, &end);
+            finite = isfinite(value->real);
+            break;
+        case CONSTANT_LONG_DOUBLE:
+            value->long_real = strtold(copy, &end);
+            finite = isfinite(value->long_real);
+            break;
+        default:
+            value->real = strtod(copy, &end);
+            finite = isfinite(value->real);
+    }
+    restore_locale(old_locale);
+    _Bool res = end == copy + len && finite;
+    if (copy != small) my_free(copy);
+    return res;
+}
+
+_Bool constant_convert(const char *spelling, size_t len, _Bool floating, CONSTANT_VALUE *value)
+{
+    return floating ? convert_floating(spelling, len, value) : convert_integer(spelling, len, value);
+}
+
+const char *constant_type_to_str(CONSTANT_TYPE type)
+{
+    switch (type)
+    {
+        case CONSTANT_INT: return "int";
+        case CONSTANT_UNSIGNED_INT: return "unsigned int";
+        case CONSTANT_LONG: return "long";
+        case CONSTANT_UNSIGNED_LONG: return "unsigned long";
+        case CONSTANT_LONG_LONG: return "long long";
+        case CONSTANT_UNSIGNED_LONG_LONG: return "unsigned long long";
+        case CONSTANT_FLOAT: return "float";
+        case CONSTANT_DOUBLE: return "double";
+        case CONSTANT_LONG_DOUBLE: return "long double";
+        default: return NULL;
+    }
+}
+
+size_t constant_to_json(const CONSTANT_VALUE *value, char *buf)
+{
+    int len = 0;
+    SAVED_LOCALE old_locale = use_c_locale();
+    switch (value->type)
+    {
+        case CONSTANT_FLOAT:
+            for (int digits = FLT_DIG; digits <= FLT_DECIMAL_DIG; ++digits)
+            {
+                len = snprintf(buf, CONSTANT_JSON_MAX, "%.*g", digits, value->real);
+                if (strtof(buf, NULL) == (float) value->real) break;
+            }
+            break;
+        case CONSTANT_DOUBLE:
+            for (int digits = DBL_DIG; digits <= DBL_DECIMAL_DIG; ++digits)
+            {
+                len = snprintf(buf, CONSTANT_JSON_MAX, "%.*g", digits, value->real);
+                if (strtod(buf, NULL) == value->real) break;
+            }
+            break;
+        case CONSTANT_LONG_DOUBLE:
+            for (int digits = LDBL_DIG; digits <= LDBL_DECIMAL_DIG; ++digits)
+            {
+                len = snprintf(buf, CONSTANT_JSON_MAX, "%.*Lg", digits, value->long_real);
+                if (strtold(buf, NULL) == value->long_real) break;
+            }
+            break;
+        default:
+            len = snprintf(buf, CONSTANT_JSON_MAX, "%" PRIu64, value->integer);
+    }
+    swap_point(buf, local_point(), '.');
+    restore_locale(old_locale);
+    return (size_t) len;
+}
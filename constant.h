@@ -0,0 +1,72 @@
+/**
+ * Conversion of integer and floating constants of the
+ * C Programming Language (ISO/IEC 9899:2018) into binary values.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#ifndef C_PARSER_CONSTANT_H_INCLUDED
+#define C_PARSER_CONSTANT_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Types of constants, chosen by their suffixes and values (ISO/IEC 9899:2017, page 45-48).
+/// Sizes of the integer types are the ones of the platform the parser runs on.
+typedef enum
+{
+    CONSTANT_INT,
+    CONSTANT_UNSIGNED_INT,
+    CONSTANT_LONG,
+    CONSTANT_UNSIGNED_LONG,
+    CONSTANT_LONG_LONG,
+    CONSTANT_UNSIGNED_LONG_LONG,
+    CONSTANT_FLOAT,
+    CONSTANT_DOUBLE,
+    CONSTANT_LONG_DOUBLE,
+}
+CONSTANT_TYPE;
+
+/// Value of a constant.
+typedef struct
+{
+    CONSTANT_TYPE type;
+    union
+    {
+        /// Value of an integer type
+        uint64_t integer;
+        /// Value of `float' (exactly) or `double'
+        double real;
+        /// Value of `long double', in the bit pattern of the platform
+        long double long_real;
+    };
+}
+CONSTANT_VALUE;
+
+/// Upper bound of the length of a number written by `constant_to_json'.
+#define CONSTANT_JSON_MAX 48
+
+/// Convert the spelling of an integer or floating constant into its value.
+///
+/// \param spelling Spelling of the constant, with its suffix
+/// \param len Length of the spelling
+/// \param floating `true' - it is a floating constant, `false' - an integer one
+/// \param value Receives the value
+/// \return `true' - OK, `false' - the spelling is malformed or its value fits no type
+_Bool constant_convert(const char *spelling, size_t len, _Bool floating, CONSTANT_VALUE *value);
+
+/// Name of the C type of a constant, like `unsigned long'.
+///
+/// \param type Type of the constant
+/// \return Name of the type
+const char *constant_type_to_str(CONSTANT_TYPE type);
+
+/// Write a value as a JSON number. Floating values are written
+/// with the fewest digits converting back into the same value.
+///
+/// \param value Value to write
+/// \param buf Buffer of at least `CONSTANT_JSON_MAX' bytes, a null terminator is added
+/// \return Length of the number
+size_t constant_to_json(const CONSTANT_VALUE *value, char *buf);
+
+#endif //C_PARSER_CONSTANT_H_INCLUDED
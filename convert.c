@@ -0,0 +1,486 @@
+/**
+ * Conversion of one C Programming Language (ISO/IEC 9899:2018)
+ * source file into a JSON file with its AST.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc_wrap.h"
+#include "ast.h"
+#include "ast_binary.h"
+#include "convert.h"
+#include "intern.h"
+#include "parse_context.h"
+#include "stats.h"
+#include "writer.h"
+#include "y.tab.h"
+
+char *content_to_str(AST_NODE *node)
+{
+    if (node->type == Identifier || node->type == StringLiteral || node->type == IntegerConstant
+        || node->type == FloatingConstant || node->type == CharacterConstant)
+    {
+        return (char *) node->content.value;
+    }
+    switch (node->content.token)
+    {
+        case AUTO: return "AUTO";
+        case BREAK: return "BREAK";
+        case CASE: return "CASE";
+        case CHAR: return "CHAR";
+        case CONST: return "CONST";
+        case CONTINUE: return "CONTINUE";
+        case DEFAULT: return "DEFAULT";
+        case DO: return "DO";
+        case DOUBLE: return "DOUBLE";
+        case ELSE: return "ELSE";
+        case ENUM: return "ENUM";
+        case EXTERN: return "EXTERN";
+        case FLOAT: return "FLOAT";
+        case FOR: return "FOR";
+        case GOTO: return "GOTO";
+        case IF: return "IF";
+        case INLINE: return "INLINE";
+        case INT: return "INT";
+        case LONG: return "LONG";
+        case REGISTER: return "REGISTER";
+        case RESTRICT: return "RESTRICT";
+        case RETURN: return "RETURN";
+        case SHORT: return "SHORT";
+        case SIGNED: return "SIGNED";
+        case SIZEOF: return "SIZEOF";
+        case STATIC: return "STATIC";
+        case STRUCT: return "STRUCT";
+        case SWITCH: return "SWITCH";
+        case TYPEDEF: return "TYPEDEF";
+        case UNION: return "UNION";
+        case UNSIGNED: return "UNSIGNED";
+        case VOID: return "VOID";
+        case VOLATILE: return "VOLATILE";
+        case WHILE: return "WHILE";
+        case ALIGNAS: return "ALIGNAS";
+        case ALIGNOF: return "ALIGNOF";
+        case ATOMIC: return "ATOMIC";
+        case BOOL: return "BOOL";
+        case COMPLEX: return "COMPLEX";
+        case GENERIC: return "GENERIC";
+        case IMAGINARY: return "IMAGINARY";
+        case NORETURN: return "NORETURN";
+        case STATIC_ASSERT: return "STATIC_ASSERT";
+        case THREAD_LOCAL: return "THREAD_LOCAL";
+        default: return NULL;
+    }
+}
+
+/// Suffix of the temporary file the output is written into before it replaces the target.
+#define TEMP_TARGET_SUFFIX ".part"
+
+/// Write the buffered output and close the target file.
+///
+/// \param writer Writer of the target file
+/// \param out Target file
+/// \param out_name Name of the target file
+/// \return CONVERT_OK or CONVERT_IO_ERROR
+static int finish_output(WRITER *writer, FILE *out, const char *out_name)
+{
+    writer_release(writer);
+    if (writer->failed)
+    {
+        fprintf(stderr, "Cannot write into opened target file: %s\n", out_name);
+        fclose(out);
+        return CONVERT_IO_ERROR;
+    }
+    if (fclose(out) == EOF)
+    {
+        fprintf(stderr, "Cannot close opened target file: %s\n", out_name);
+        return CONVERT_IO_ERROR;
+    }
+    return CONVERT_OK;
+}
+
+/// Take the measurements left in the context after parsing.
+///
+/// \param stats Measurements or NULL
+/// \param ctx Context of the finished parse
+static void collect_parse_stats(PARSE_STATS *stats, PARSE_CONTEXT *ctx)
+{
+    if (!stats) return;
+    // Scanning is timed inside of parsing
+    stats->phases[STATS_PARSE].wall -= stats->phases[STATS_LEX].wall;
+    stats->typedef_names = ctx->typedefs.size;
+    stats->typedef_lookups = ctx->typedefs.lookups;
+    if (ctx->root) ast_count_nodes(ctx->root, stats->nodes);
+}
+
+/// Move the time the writer spent writing into its file from the phase to STATS_WRITE.
+///
+/// \param stats Measurements or NULL
+/// \param phase Phase the writing happened in
+/// \param writer Timed writer
+static void take_write_time(PARSE_STATS *stats, STATS_PHASE phase, WRITER *writer)
+{
+    if (!stats) return;
+    stats->phases[phase].wall -= writer->write_wall;
+    stats->phases[phase].cpu -= writer->write_cpu;
+    stats->phases[STATS_WRITE].wall += writer->write_wall;
+    stats->phases[STATS_WRITE].cpu += writer->write_cpu;
+    writer->write_wall = writer->write_cpu = 0;
+}
+
+/// Print the report of `--stats' into `stderr' as one line of JSON.
+///
+/// \param stats Measurements or NULL
+/// \param in_name Name of the source file, NULL - `stdin'
+static void print_stats(PARSE_STATS *stats, const char *in_name)
+{
+    if (!stats) return;
+    WRITER report;
+    writer_init_buffer(&report);
+    stats_write_json(&report, stats, in_name);
+    writer_putc(&report, '\n');
+    char *text = writer_release(&report);
+    fputs(text, stderr);  // At once, reports of parallel conversions do not mix
+    my_free(text);
+}
+
+/// Parse the source writing every top-level declaration as a line of JSON as soon as it is complete.
+/// The written file is removed if parsing fails.
+///
+/// \param in Opened source file, closed here unless it is `stdin'
+/// \param in_name Name of the source file, NULL - `stdin'
+/// \param out_name Name of the target file, for messages
+/// \param write_name Name of the file to write the output into
+/// \param options How to convert
+/// \param stats Measurements to fill in, or NULL
+/// \param deps Receives files included, or NULL
+/// \return CONVERT_OK, CONVERT_PARSE_ERROR or CONVERT_IO_ERROR
+static int convert_stream(FILE *in, const char *in_name, const char *out_name, const char *write_name,
+                          const CONVERT_OPTIONS *options, PARSE_STATS *stats, RESULT_DEPS *deps)
+{
+    FILE *out = fopen(write_name, "w");
+    if (!out)
+    {
+        fprintf(stderr, "Cannot open for writing: %s\n", out_name);
+        if (in_name) fclose(in);
+        return CONVERT_IO_ERROR;
+    }
+    WRITER writer;
+    writer_init_file(&writer, out);
+    writer.timed = stats != NULL;
+    writer.typed_constants = options->typed_constants;
+    AST_STREAM stream = {&writer, &content_to_str, 0, stats ? stats->nodes : NULL};
+
+    // The arena only holds the declaration being parsed, the output is generated while parsing
+    PARSE_CONTEXT ctx;
+    parse_context_init(&ctx);
+    ctx.file_name = in_name;
+    ctx.stream = &stream;
+    ctx.stats = stats;
+    ctx.prefilter = options->prefilter;
+    ctx.typed_constants = options->typed_constants;
+    ctx.deps = deps;
+    STATS_TIME start;
+    stats_phase_start(stats, &start);
+    int parse_res = parse_file(&ctx, in);
+    stats_phase_end(stats, STATS_PARSE, &start);
+    collect_parse_stats(stats, &ctx);
+    take_write_time(stats, STATS_PARSE, &writer);
+    int res = in_name ? fclose(in) : 0;
+    if (options->intern_stats) intern_print_stats(&ctx.strings, stderr);
+    _Bool failed = parse_res || ctx.error_found;
+    _Bool io_failed = ctx.io_failed;
+    stats_phase_start(stats, &start);
+    parse_context_free(&ctx);
+    stats_phase_end(stats, STATS_FREE, &start);
+
+    if (failed || res == EOF)
+    {
+        if (failed)
+        {
+            fprintf(stderr, "Parsing failed! No output will be provided.\n");
+        }
+        else
+        {
+            fprintf(stderr, "Cannot close opened source file: %s\n", in_name);
+        }
+        writer_release(&writer);
+        fclose(out);
+        remove(write_name);
+        print_stats(stats, in_name);
+        return failed && !io_failed ? CONVERT_PARSE_ERROR : CONVERT_IO_ERROR;
+    }
+    stats_phase_start(stats, &start);
+    res = finish_output(&writer, out, out_name);
+    stats_phase_end(stats, STATS_WRITE, &start);
+    print_stats(stats, in_name);
+    return res;
+}
+
+/// Convert the source without looking into the result cache, see `convert_file'.
+///
+/// \param in_name Name of the source file, NULL - `stdin'
+/// \param out_name Name of the target file, for messages
+/// \param write_name Name of the file to write the output into
+/// \param options How to convert
+/// \param deps Receives files included, or NULL
+/// \return CONVERT_OK, CONVERT_PARSE_ERROR or CONVERT_IO_ERROR
+static int convert_source(const char *in_name, const char *out_name, const char *write_name,
+                          const CONVERT_OPTIONS *options, RESULT_DEPS *deps)
+{
+    int res;  // For results of I/O functions
+
+    FILE *in = in_name ? fopen(in_name, "r") : stdin;
+    if (!in)
+    {
+        fprintf(stderr, "Cannot open for reading: %s\n", in_name);
+        return CONVERT_IO_ERROR;
+    }
+    PARSE_STATS stats_storage;
+    PARSE_STATS *stats = NULL;
+    if (options->stats)
+    {
+        stats = &stats_storage;
+        stats_init(stats);
+    }
+    if (options->ndjson) return convert_stream(in, in_name, out_name, write_name, options, stats, deps);
+
+    // All the nodes of the translation unit live in the context's arena.
+    // In flat mode it only holds the declaration being parsed.
+    PARSE_CONTEXT ctx;
+    parse_context_init(&ctx);
+    ctx.file_name = in_name;
+    ctx.stats = stats;
+    ctx.prefilter = options->prefilter;
+    ctx.deps = deps;
+    AST_FLAT flat;
+    if (options->flat)
+    {
+        ast_flat_init(&flat);
+        ctx.flat = &flat;
+    }
+    else
+    {
+        // Nodes of the flat AST do not keep values, its writer converts the constants itself
+        ctx.typed_constants = options->typed_constants;
+    }
+
+    STATS_TIME start;
+    stats_phase_start(stats, &start);
+    int parse_res = parse_file(&ctx, in);
+    stats_phase_end(stats, STATS_PARSE, &start);
+    collect_parse_stats(stats, &ctx);
+    res = in_name ? fclose(in) : 0;
+    if (options->intern_stats) intern_print_stats(&ctx.strings, stderr);
+
+    if (parse_res || ctx.error_found || (!ctx.root && !options->flat))
+    {
+        fprintf(stderr, "Parsing failed! No output will be provided.\n");
+        _Bool io_failed = ctx.io_failed;
+        parse_context_free(&ctx);
+        if (options->flat) ast_flat_free(&flat);
+        print_stats(stats, in_name);
+        return io_failed ? CONVERT_IO_ERROR : CONVERT_PARSE_ERROR;
+    }
+
+    if (res == EOF)
+    {
+        fprintf(stderr, "Cannot close opened source file: %s\n", in_name);
+        parse_context_free(&ctx);
+        if (options->flat) ast_flat_free(&flat);
+        return CONVERT_IO_ERROR;
+    }
+
+    FILE *out = fopen(write_name, options->binary ? "wb" : "w");
+    if (!out)
+    {
+        fprintf(stderr, "Cannot open for writing: %s\n", out_name);
+        parse_context_free(&ctx);
+        if (options->flat) ast_flat_free(&flat);
+        return CONVERT_IO_ERROR;
+    }
+
+    WRITER writer;
+    writer_init_file(&writer, out);
+    writer.timed = stats != NULL;
+    writer.typed_constants = options->typed_constants;
+    stats_phase_start(stats, &start);
+    if (options->flat)
+    {
+        AST_ID root = ast_flat_finish(&flat);
+        if (options->binary)
+        {
+            ast_flat_write_binary(&writer, &flat, root, &content_to_str);
+        }
+        else
+        {
+            ast_flat_write_json(&writer, &flat, root, 0, "    ", &content_to_str);
+        }
+        stats_phase_end(stats, STATS_OUTPUT, &start);
+        if (stats) ast_flat_count_nodes(&flat, stats->nodes);
+        stats_phase_start(stats, &start);
+        ast_flat_free(&flat);
+    }
+    else
+    {
+        if (options->binary)
+        {
+            ast_write_binary(&writer, ctx.root, &content_to_str);
+        }
+        else
+        {
+            ast_write_json_parallel(&writer, ctx.root, 0, "    ", &content_to_str, options->jobs);
+        }
+        stats_phase_end(stats, STATS_OUTPUT, &start);
+        stats_phase_start(stats, &start);
+    }
+    parse_context_free(&ctx);
+    stats_phase_end(stats, STATS_FREE, &start);
+    take_write_time(stats, STATS_OUTPUT, &writer);
+
+    stats_phase_start(stats, &start);
+    res = finish_output(&writer, out, out_name);
+    stats_phase_end(stats, STATS_WRITE, &start);
+    print_stats(stats, in_name);
+    return res;
+}
+
+/// Convert the source into a temporary file, which replaces the target once it is complete.
+/// The target may be a hard link to a cache entry (see `RESULT_CACHE.link'), so it is never written through.
+///
+/// \param in_name Name of the source file, NULL - `stdin'
+/// \param out_name Name of the target file
+/// \param options How to convert
+/// \param deps Receives files included, or NULL
+/// \return CONVERT_OK, CONVERT_PARSE_ERROR or CONVERT_IO_ERROR
+static int convert_to_target(const char *in_name, const char *out_name, const CONVERT_OPTIONS *options,
+                             RESULT_DEPS *deps)
+{
+    size_t len = strlen(out_name);
+    char *temp_name = (char *) my_malloc(len + sizeof(TEMP_TARGET_SUFFIX), "temporary target name");
+    memcpy(temp_name, out_name, len);
+    memcpy(temp_name + len, TEMP_TARGET_SUFFIX, sizeof(TEMP_TARGET_SUFFIX));
+    int res = convert_source(in_name, out_name, temp_name, options, deps);
+    if (res == CONVERT_OK)
+    {
+#ifdef _WIN32
+        remove(out_name);  // `rename' does not replace files there
+#endif
+        if (rename(temp_name, out_name) != 0)
+        {
+            fprintf(stderr, "Cannot replace target file: %s\n", out_name);
+            res = CONVERT_IO_ERROR;
+        }
+    }
+    if (res != CONVERT_OK) remove(temp_name);
+    my_free(temp_name);
+    return res;
+}
+
+int convert_file(const char *in_name, const char *out_name, const CONVERT_OPTIONS *options)
+{
+    // Flat storage gives the same JSON, only the format of the output tells results apart
+    unsigned format = (options->binary ? 1 : options->ndjson ? 2 : 0) | (options->typed_constants ? 4 : 0);
+    uint64_t key;
+    if (!options->cache || !in_name || !result_cache_key(in_name, format, &key))
+    {
+        return convert_to_target(in_name, out_name, options, NULL);
+    }
+    if (result_cache_fetch(options->cache, key, out_name)) return CONVERT_OK;
+
+    RESULT_DEPS deps;
+    result_deps_init(&deps);
+    int res = convert_to_target(in_name, out_name, options, &deps);
+    if (res == CONVERT_OK) result_cache_store(options->cache, key, out_name, &deps);
+    result_deps_free(&deps);
+    return res;
+}
+
+/// Free the flat AST of `convert_buffer', if there is one, and reset the context.
+///
+/// \param ctx Context of the conversion
+static void end_buffer(PARSE_CONTEXT *ctx)
+{
+    if (ctx->flat)
+    {
+        ast_flat_free(ctx->flat);
+        my_free(ctx->flat);
+    }
+    parse_context_reset(ctx);
+}
+
+int convert_buffer(PARSE_CONTEXT *ctx, char *data, size_t size, WRITER *out, const CONVERT_OPTIONS *options)
+{
+    AST_STREAM stream = {out, &content_to_str, 0, NULL};
+    ctx->prefilter = options->prefilter;
+    out->typed_constants = options->typed_constants;
+    size_t start = out->len;
+
+    // Everything allocated is reachable from the context and the writer, so running out of memory
+    // only fails this source. The flat AST is kept by the context for that reason
+    ALLOC_FAILURE failure;
+    ALLOC_FAILURE *outer = alloc_failure_catch(&failure);
+    if (setjmp(failure.jump))
+    {
+        alloc_failure_catch(outer);
+        parse_abort(ctx);
+        out->len = start;
+        end_buffer(ctx);
+        return CONVERT_NO_MEMORY;
+    }
+    if (options->ndjson)
+    {
+        ctx->stream = &stream;
+    }
+    else if (options->flat)
+    {
+        ctx->flat = (AST_FLAT *) my_malloc(sizeof(AST_FLAT), "flat AST");
+        *ctx->flat = (AST_FLAT) {0};
+        ast_flat_init(ctx->flat);
+    }
+    ctx->typed_constants = options->typed_constants && !ctx->flat;
+    int res = CONVERT_OK;
+    if (parse_buffer(ctx, data, size) || ctx->error_found || (!ctx->root && !ctx->flat && !ctx->stream))
+    {
+        res = ctx->io_failed ? CONVERT_IO_ERROR : CONVERT_PARSE_ERROR;
+        out->len = start;  // Declarations streamed before the error
+    }
+    else if (ctx->flat)
+    {
+        AST_ID root = ast_flat_finish(ctx->flat);
+        if (options->binary) ast_flat_write_binary(out, ctx->flat, root, &content_to_str);
+        else ast_flat_write_json(out, ctx->flat, root, 0, "    ", &content_to_str);
+    }
+    else if (!ctx->stream)
+    {
+        if (options->binary) ast_write_binary(out, ctx->root, &content_to_str);
+        else ast_write_json(out, ctx->root, 0, "    ", &content_to_str);
+    }
+    alloc_failure_catch(outer);
+    end_buffer(ctx);
+    return res;
+}
+
+int convert_binary_to_json(const char *in_name, const char *out_name, _Bool typed_constants)
+{
+    AST_BIN bin;
+    if (!ast_bin_open(&bin, in_name)) return CONVERT_PARSE_ERROR;
+
+    FILE *out = fopen(out_name, "w");
+    if (!out)
+    {
+        fprintf(stderr, "Cannot open for writing: %s\n", out_name);
+        ast_bin_close(&bin);
+        return CONVERT_IO_ERROR;
+    }
+    WRITER writer;
+    writer_init_file(&writer, out);
+    writer.typed_constants = typed_constants;
+    ast_bin_write_json(&writer, &bin, ast_bin_root(&bin), 0, "    ");
+    ast_bin_close(&bin);
+    return finish_output(&writer, out, out_name);
+}
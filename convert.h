@@ -0,0 +1,93 @@
+/**
+ * Conversion of one C Programming Language (ISO/IEC 9899:2018)
+ * source file into a JSON file with its AST.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#ifndef C_PARSER_CONVERT_H_INCLUDED
+#define C_PARSER_CONVERT_H_INCLUDED
+
+#include "ast.h"
+#include "parse_context.h"
+#include "result_cache.h"
+#include "writer.h"
+
+/// Result of `convert_file': OK.
+#define CONVERT_OK 0
+
+/// Result of `convert_file': source is not correct.
+#define CONVERT_PARSE_ERROR 1
+
+/// Result of `convert_file': input or output failed.
+#define CONVERT_IO_ERROR 3
+
+/// Result of `convert_buffer': memory ran out (see `alloc_failure_catch').
+#define CONVERT_NO_MEMORY 4
+
+/// How the conversion is done.
+typedef struct
+{
+    /// Build the AST into flat, index-based storage
+    _Bool flat;
+    /// Print numbers of distinct and all identifiers
+    _Bool intern_stats;
+    /// Write the binary AST of `ast_binary.h' instead of JSON
+    _Bool binary;
+    /// Write every top-level declaration as a line of JSON while parsing (NDJSON)
+    _Bool ndjson;
+    /// Print measurements of the conversion into `stderr' as one line of JSON
+    _Bool stats;
+    /// Replace trigraphs and remove line splices of mapped sources before scanning
+    _Bool prefilter;
+    /// Write values and types of integer and floating constants into JSON (see `ast_write_json')
+    _Bool typed_constants;
+    /// Threads writing the JSON of a big tree (see `ast_write_json_parallel'), 1 - only the calling one
+    int jobs;
+    /// Cache of results to look the source up in and store the output into, NULL if not used
+    const RESULT_CACHE *cache;
+}
+CONVERT_OPTIONS;
+
+/// Conversion function for AST node content.
+///
+/// \param node AST node to get the content of
+/// \return String representation of the given node's content
+char *content_to_str(AST_NODE *node);
+
+/// Parse the source file and write its AST as JSON (or binary AST) into the target file.
+/// The output goes into a temporary file next to the target (its name followed by `.part'),
+/// which replaces the target once it is complete: the target is left as it was if the conversion
+/// fails, and is never written through. With a result cache, an unchanged
+/// named source is not parsed: the stored output is given instead.
+/// Independent of other calls, may be run on several threads at once.
+///
+/// \param in_name Name of the source file, NULL - `stdin'
+/// \param out_name Name of the target file
+/// \param options How to convert
+/// \return CONVERT_OK, CONVERT_PARSE_ERROR or CONVERT_IO_ERROR
+int convert_file(const char *in_name, const char *out_name, const CONVERT_OPTIONS *options);
+
+/// Parse the source held in memory and write the same output `convert_file' would
+/// into the memory writer, nothing is left in it if parsing fails. The context is reset afterwards
+/// (see `parse_context_reset'), so it may serve the next source with its memory kept.
+/// Running out of memory fails the conversion instead of exiting the application.
+///
+/// \param ctx Initialized context
+/// \param data Text of the source followed by `SOURCE_MAP_SENTINELS' zero bytes, changed by the scanner
+/// \param size Size of the text
+/// \param out Writer to write to
+/// \param options How to convert (`stats', `intern_stats', `jobs' and `cache' are not used)
+/// \return CONVERT_OK, CONVERT_PARSE_ERROR, CONVERT_IO_ERROR (an included file cannot be read)
+///         or CONVERT_NO_MEMORY
+int convert_buffer(PARSE_CONTEXT *ctx, char *data, size_t size, WRITER *out, const CONVERT_OPTIONS *options);
+
+/// Convert the binary AST file into the same JSON `convert_file' would write.
+///
+/// \param in_name Name of the binary AST file
+/// \param out_name Name of the target file
+/// \param typed_constants Write values and types of integer and floating constants
+/// \return CONVERT_OK, CONVERT_PARSE_ERROR (not a binary AST) or CONVERT_IO_ERROR
+int convert_binary_to_json(const char *in_name, const char *out_name, _Bool typed_constants);
+
+#endif //C_PARSER_CONVERT_H_INCLUDED
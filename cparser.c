@@ -0,0 +1,164 @@
+/**
+ * Library interface of the parser for C Programming Language (ISO/IEC 9899:2018).
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc_wrap.h"
+#include "convert.h"
+#include "cparser.h"
+#include "header_cache.h"
+#include "source_map.h"
+
+/// Finish the messages of the result, making them null-terminated.
+/// Runs out of memory too, so it only uses the room the buffer has.
+///
+/// \param result Result to finish
+/// \param no_memory Description of the memory not allocated, NULL if parsing was not stopped
+static void finish_diagnostics(CPARSER_RESULT *result, const char *no_memory)
+{
+    WRITER *messages = &result->messages;
+    if (!messages->buf)
+    {
+        result->diagnostics = "";
+        result->diagnostics_length = 0;
+        return;
+    }
+    if (messages->len == messages->cap) --messages->len;
+    if (no_memory)
+    {
+        int len = snprintf(messages->buf + messages->len, messages->cap - messages->len,
+                           "Memory for %s cannot be allocated!\n", no_memory);
+        size_t room = messages->cap - messages->len - 1;
+        messages->len += len < 0 ? 0 : (size_t) len < room ? (size_t) len : room;
+    }
+    messages->buf[messages->len] = '\0';
+    result->diagnostics = messages->buf;
+    result->diagnostics_length = messages->len;
+}
+
+/// Copy the source and parse it into the result.
+///
+/// \param result Result with an initialized context
+/// \param data Text of the source
+/// \param size Size of the text
+static void parse_into(CPARSER_RESULT *result, const char *data, size_t size)
+{
+    writer_init_buffer(&result->messages);
+    result->ctx.messages = &result->messages;
+    result->source = (char *) my_malloc(size + SOURCE_MAP_SENTINELS, "source");
+    memcpy(result->source, data, size);
+    memset(result->source + size, 0, SOURCE_MAP_SENTINELS);
+    PARSE_CONTEXT *ctx = &result->ctx;
+    if (parse_buffer(ctx, result->source, size) || ctx->error_found || !ctx->root)
+    {
+        result->status = ctx->io_failed ? CPARSER_IO_ERROR : CPARSER_PARSE_ERROR;
+    }
+    else
+    {
+        result->status = CPARSER_OK;
+        result->root = ctx->root;
+    }
+}
+
+CPARSER_RESULT *cparser_parse_buffer(const char *data, size_t size, const CPARSER_OPTIONS *options)
+{
+    CPARSER_RESULT *result = (CPARSER_RESULT *) malloc(sizeof(CPARSER_RESULT));
+    if (!result) return NULL;
+    result->root = NULL;
+    result->source = NULL;
+    result->messages.buf = NULL;
+    parse_context_init(&result->ctx);
+    if (options)
+    {
+        result->ctx.file_name = options->file_name;
+        result->ctx.prefilter = options->prefilter;
+    }
+
+    ALLOC_FAILURE failure;
+    ALLOC_FAILURE *outer = alloc_failure_catch(&failure);
+    if (setjmp(failure.jump))
+    {
+        // Everything allocated is still owned by the result, `cparser_free' releases it
+        alloc_failure_catch(outer);
+        parse_abort(&result->ctx);
+        result->status = CPARSER_NO_MEMORY;
+        result->root = NULL;
+        finish_diagnostics(result, failure.description);
+        return result;
+    }
+    parse_into(result, data, size);
+    alloc_failure_catch(outer);
+    finish_diagnostics(result, NULL);
+    return result;
+}
+
+/// Write the AST of the result, catching allocation failures.
+/// Memory of the output being generated is lost when they happen.
+///
+/// \param result Successful result of `cparser_parse_buffer'
+/// \param out Writer to initialize with the function, its `buf' is NULL
+/// \param sink Function receiving the output
+/// \param arg Argument to pass to `sink'
+/// \param binary Write the binary AST instead of JSON
+/// \return CPARSER_OK, CPARSER_IO_ERROR or CPARSER_NO_MEMORY
+static int write_ast(const CPARSER_RESULT *result, WRITER *out, WRITER_SINK sink, void *arg, _Bool binary)
+{
+    ALLOC_FAILURE failure;
+    ALLOC_FAILURE *outer = alloc_failure_catch(&failure);
+    if (setjmp(failure.jump))
+    {
+        alloc_failure_catch(outer);
+        return CPARSER_NO_MEMORY;
+    }
+    writer_init_sink(out, sink, arg);
+    if (binary) ast_write_binary(out, result->root, &content_to_str);
+    else ast_write_json(out, result->root, 0, "    ", &content_to_str);
+    alloc_failure_catch(outer);
+    return writer_flush(out) ? CPARSER_IO_ERROR : CPARSER_OK;
+}
+
+/// Write the AST of the result, passing it to the function in chunks.
+///
+/// \param result Result of `cparser_parse_buffer'
+/// \param sink Function receiving the output
+/// \param arg Argument to pass to `sink'
+/// \param binary Write the binary AST instead of JSON
+/// \return CPARSER_OK, CPARSER_PARSE_ERROR, CPARSER_IO_ERROR or CPARSER_NO_MEMORY
+static int write_to_sink(const CPARSER_RESULT *result, WRITER_SINK sink, void *arg, _Bool binary)
+{
+    if (!result->root) return CPARSER_PARSE_ERROR;
+    WRITER out;
+    out.buf = NULL;
+    int res = write_ast(result, &out, sink, arg, binary);
+    my_free(out.buf);
+    return res;
+}
+
+int cparser_write_json(const CPARSER_RESULT *result, WRITER_SINK sink, void *arg)
+{
+    return write_to_sink(result, sink, arg, false);
+}
+
+int cparser_write_binary(const CPARSER_RESULT *result, WRITER_SINK sink, void *arg)
+{
+    return write_to_sink(result, sink, arg, true);
+}
+
+void cparser_free(CPARSER_RESULT *result)
+{
+    if (!result) return;
+    parse_context_free(&result->ctx);
+    my_free(result->source);
+    my_free(result->messages.buf);
+    free(result);
+}
+
+void cparser_release_caches()
+{
+    header_cache_clear();
+}
@@ -0,0 +1,96 @@
+/**
+ * Library interface of the parser for C Programming Language (ISO/IEC 9899:2018),
+ * for use inside other programs: built as `libcparser'.
+ * Nothing is printed and the process is never exited: failures,
+ * including running out of memory, are returned with the messages.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#ifndef C_PARSER_CPARSER_H_INCLUDED
+#define C_PARSER_CPARSER_H_INCLUDED
+
+#include <stddef.h>
+#include "ast.h"
+#include "parse_context.h"
+#include "writer.h"
+
+/// Status of a call: OK.
+#define CPARSER_OK 0
+
+/// Status of a call: the source has errors.
+#define CPARSER_PARSE_ERROR 1
+
+/// Status of a call: an included file cannot be read, or the sink failed.
+#define CPARSER_IO_ERROR 3
+
+/// Status of a call: memory cannot be allocated.
+#define CPARSER_NO_MEMORY 4
+
+/// How to parse.
+typedef struct
+{
+    /// Name of the source to prefix messages with, or NULL
+    const char *file_name;
+    /// Replace trigraphs and remove line splices before scanning
+    _Bool prefilter;
+}
+CPARSER_OPTIONS;
+
+/// Outcome of `cparser_parse_buffer', owning the AST.
+typedef struct
+{
+    /// CPARSER_OK, CPARSER_PARSE_ERROR, CPARSER_IO_ERROR or CPARSER_NO_MEMORY
+    int status;
+    /// Root of the translation unit, NULL unless `status' is CPARSER_OK.
+    /// Values of its literals are given by `ast_literal_value'
+    AST_NODE *root;
+    /// Error and warning messages one per line, null-terminated, never NULL
+    const char *diagnostics;
+    /// Length of `diagnostics'
+    size_t diagnostics_length;
+    /// Parse the AST belongs to (private)
+    PARSE_CONTEXT ctx;
+    /// Copy of the source the scanner worked on (private)
+    char *source;
+    /// Collected messages (private)
+    WRITER messages;
+}
+CPARSER_RESULT;
+
+/// Parse the source held in memory. Files included through `#include "..."' are read
+/// relative to the working directory and cached for the whole process (see `header_cache').
+/// Several sources may be parsed at once on different threads.
+///
+/// \param data Text of the source, not changed
+/// \param size Size of the text
+/// \param options How to parse, NULL - defaults
+/// \return Result to be freed by `cparser_free', NULL if even it cannot be allocated
+CPARSER_RESULT *cparser_parse_buffer(const char *data, size_t size, const CPARSER_OPTIONS *options);
+
+/// Write the AST as the same JSON the `c_parser' program writes, passing it to the function in chunks.
+///
+/// \param result Successful result of `cparser_parse_buffer'
+/// \param sink Function receiving the output
+/// \param arg Argument to pass to `sink'
+/// \return CPARSER_OK, CPARSER_PARSE_ERROR (no AST), CPARSER_IO_ERROR (`sink' failed) or CPARSER_NO_MEMORY
+int cparser_write_json(const CPARSER_RESULT *result, WRITER_SINK sink, void *arg);
+
+/// Write the AST in the binary format of `ast_binary.h', passing it to the function in chunks.
+///
+/// \param result Successful result of `cparser_parse_buffer'
+/// \param sink Function receiving the output
+/// \param arg Argument to pass to `sink'
+/// \return CPARSER_OK, CPARSER_PARSE_ERROR (no AST), CPARSER_IO_ERROR (`sink' failed) or CPARSER_NO_MEMORY
+int cparser_write_binary(const CPARSER_RESULT *result, WRITER_SINK sink, void *arg);
+
+/// Free the result with its AST.
+///
+/// \param result Result to free, may be NULL
+void cparser_free(CPARSER_RESULT *result);
+
+/// Release the included files cached by all the parses of the process.
+/// Must not be called while sources are being parsed.
+void cparser_release_caches();
+
+#endif //C_PARSER_CPARSER_H_INCLUDED
@@ -0,0 +1,402 @@
+/**
+ * Generator of synthetic C sources for the throughput benchmark (`parse_bench.c').
+ * Sources are valid C11 without preprocessing besides `#include "..."' of the generated headers,
+ * and they are reproducible: the same options and seed give the same corpus.
+ *
+ * Usage: gen_corpus [options] <out_dir>
+ * The directory receives `src<N>.c', `inc<N>.h' and `list.txt' listing the sources.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+/// Parameters of the corpus.
+typedef struct
+{
+    /// Number of sources
+    int files;
+    /// Approximate size of each source, KB (headers are not counted)
+    int size;
+    /// Nesting depth of statements and of expressions
+    int depth;
+    /// Percent of file-scope declarations which are typedefs
+    int typedefs;
+    /// Number of elements of a long initializer list
+    int init_length;
+    /// Number of characters of a long string literal
+    int string_length;
+    /// Number of headers every source includes
+    int includes;
+    /// Seed of the pseudo-random choices
+    unsigned seed;
+}
+CORPUS_OPTIONS;
+
+/// Typedefs and functions every header declares.
+#define HEADER_DECLARATIONS 40
+
+/// State of the pseudo-random generator (xorshift).
+static unsigned rng_state;
+
+/// Output being generated and the number of bytes written into it.
+static FILE *out;
+static long long written;
+
+/// Next pseudo-random number.
+///
+/// \param bound Upper bound, exclusive
+/// \return Number in [0, bound)
+static int rnd(int bound)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return (int) (rng_state % (unsigned) bound);
+}
+
+/// `fprintf' into `out', counting bytes.
+///
+/// \param format Format string
+static void emit(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int res = vfprintf(out, format, args);
+    va_end(args);
+    if (res > 0) written += res;
+}
+
+/// Indentation of the given nesting level.
+///
+/// \param level Nesting level
+static void indent(int level)
+{
+    emit("%*s", level * 4, "");
+}
+
+/// Write an expression nested to the given depth. Operands are `x', `n' and the locals;
+/// calls refer only to functions defined earlier.
+///
+/// \param depth Remaining nesting depth
+/// \param locals Number of locals `v<N>' in scope
+/// \param functions Number of functions defined before
+static void gen_expression(int depth, int locals, int functions)
+{
+    static const char *ops[] = {"+", "-", "*", "<<", "&", "|", "^", "<", "==", "&&"};
+    if (depth <= 0)
+    {
+        switch (rnd(4))
+        {
+            case 0: emit("x"); break;
+            case 1: emit("n"); break;
+            case 2: emit("%d", rnd(1000)); break;
+            default:
+                if (locals > 0) emit("(long) v%d", rnd(locals));
+                else emit("0x%xUL", rnd(65536));
+        }
+        return;
+    }
+    switch (rnd(4))
+    {
+        case 0:
+            if (functions > 0)
+            {
+                emit("f%d(", rnd(functions));
+                gen_expression(depth - 1, locals, functions);
+                emit(", n)");
+                break;
+            }
+            // Fall through
+        case 1:
+            emit("(x ? ");
+            gen_expression(depth - 1, locals, functions);
+            emit(" : n)");
+            break;
+        default:
+            emit("(");
+            gen_expression(depth - 1, locals, functions);
+            emit(" %s ", ops[rnd(sizeof(ops) / sizeof(*ops))]);
+            gen_expression(depth / 2, locals, functions);
+            emit(")");
+    }
+}
+
+/// Write a statement nested to the given depth.
+///
+/// \param depth Remaining nesting depth
+/// \param level Indentation level
+/// \param locals Number of locals `v<N>' in scope
+/// \param functions Number of functions defined before
+static void gen_statement(int depth, int level, int locals, int functions)
+{
+    indent(level);
+    if (depth <= 0)
+    {
+        emit("x = ");
+        gen_expression(2, locals, functions);
+        emit(";\n");
+        return;
+    }
+    switch (rnd(5))
+    {
+        case 0:
+            emit("if (");
+            gen_expression(2, locals, functions);
+            emit(")\n");
+            gen_statement(depth - 1, level + 1, locals, functions);
+            indent(level);
+            emit("else\n");
+            gen_statement(depth - 1, level + 1, locals, functions);
+            break;
+        case 1:
+            emit("for (long i%d = 0; i%d < n; ++i%d)\n", level, level, level);
+            gen_statement(depth - 1, level + 1, locals, functions);
+            break;
+        case 2:
+            emit("while (x > n)\n");
+            gen_statement(depth - 1, level + 1, locals, functions);
+            break;
+        case 3:
+            emit("do\n");
+            gen_statement(depth - 1, level + 1, locals, functions);
+            indent(level);
+            emit("while (--n > 0);\n");
+            break;
+        default:
+            emit("{\n");
+            for (int i = 0, number = 1 + rnd(3); i < number; ++i)
+            {
+                gen_statement(depth - 1, level + 1, locals, functions);
+            }
+            indent(level);
+            emit("}\n");
+    }
+}
+
+/// Write a header of typedefs and prototypes.
+///
+/// \param index Number of the header
+static void gen_header(int index)
+{
+    emit("/* Generated by gen_corpus */\n\n");
+    for (int i = 0; i < HEADER_DECLARATIONS; ++i)
+    {
+        emit("typedef struct inc%d_s%d\n{\n    int id;\n    unsigned long flags;\n"
+             "    struct inc%d_s%d *next;\n} inc%d_t%d;\n", index, i, index, i, index, i);
+        emit("typedef unsigned long inc%d_u%d;\n", index, i);
+        emit("inc%d_t%d *inc%d_make%d(inc%d_u%d size, const char *name);\n\n", index, i, index, i, index, i);
+    }
+}
+
+/// Write a long initializer list.
+///
+/// \param index Number of the table
+/// \param options Parameters of the corpus
+static void gen_table(int index, const CORPUS_OPTIONS *options)
+{
+    emit("static const long table%d[%d] =\n    {", index, options->init_length);
+    for (int i = 0; i < options->init_length; ++i)
+    {
+        if (i % 12 == 0) emit("\n        ");
+        emit(rnd(4) ? "%d, " : "0x%X, ", rnd(100000));
+    }
+    emit("\n    };\n\n");
+}
+
+/// Write a long string literal.
+///
+/// \param index Number of the string
+/// \param options Parameters of the corpus
+static void gen_string(int index, const CORPUS_OPTIONS *options)
+{
+    static const char *escapes[] = {"\\n", "\\t", "\\\"", "\\\\", "\\x41", "\\101"};
+    emit("static const char *text%d =\n    \"", index);
+    for (int i = 0; i < options->string_length; ++i)
+    {
+        if (rnd(40) == 0) emit("%s", escapes[rnd(sizeof(escapes) / sizeof(*escapes))]);
+        else emit("%c", "abcdefghijklmnopqrstuvwxyz .,;:ABCDEFGHIJ0123456789"[rnd(51)]);
+    }
+    emit("\";\n\n");
+}
+
+/// Write a function with locals of typedef types and a body of nested statements.
+///
+/// \param index Number of the function
+/// \param typedefs Number of typedefs `t<N>' declared before
+/// \param options Parameters of the corpus
+static void gen_function(int index, int typedefs, const CORPUS_OPTIONS *options)
+{
+    emit("static long f%d(long x, long n)\n{\n", index);
+    int locals = 2 + rnd(4);
+    for (int i = 0; i < locals; ++i)
+    {
+        int type = typedefs > 0 ? rnd(typedefs) : -1;
+        if (type >= 0) emit("    t%d v%d = (t%d) x;\n", type, i, type);
+        else emit("    unsigned long v%d = x;\n", i);
+    }
+    if (options->includes > 0)
+    {
+        int header = rnd(options->includes), decl = rnd(HEADER_DECLARATIONS);
+        emit("    inc%d_t%d *item = inc%d_make%d((inc%d_u%d) v0, \"f%d\");\n",
+             header, decl, header, decl, header, decl, index);
+    }
+    for (int i = 0, number = 1 + rnd(3); i < number; ++i) gen_statement(options->depth, 1, locals, index);
+    emit("    return x;\n}\n\n");
+}
+
+/// Write a source of the corpus.
+///
+/// \param options Parameters of the corpus
+/// \param dir Directory of the corpus, as it is given
+static void gen_source(const CORPUS_OPTIONS *options, const char *dir)
+{
+    emit("/* Generated by gen_corpus */\n\n");
+    for (int i = 0; i < options->includes; ++i) emit("#include \"%s/inc%d.h\"\n", dir, i);
+    emit("\n");
+    int typedefs = 0, functions = 0, tables = 0, strings = 0;
+    while (written < options->size * 1024LL)
+    {
+        if (rnd(100) < options->typedefs)
+        {
+            // Plain, alias of an earlier typedef-name and pointer typedefs
+            switch (typedefs > 0 ? rnd(3) : 0)
+            {
+                case 0: emit("typedef unsigned long t%d;\n", typedefs); break;
+                case 1: emit("typedef t%d t%d;\n", rnd(typedefs), typedefs); break;
+                default: emit("typedef const t%d *t%d;\n", rnd(typedefs), typedefs);
+            }
+            ++typedefs;
+            continue;
+        }
+        switch (rnd(10))
+        {
+            case 0: gen_table(tables++, options); break;
+            case 1: gen_string(strings++, options); break;
+            default: gen_function(functions++, typedefs, options);
+        }
+    }
+    emit("int main(void)\n{\n    return (int) f0(%d, %d);\n}\n", rnd(10), rnd(10));
+}
+
+/// Parse an option of the form `--name=N'.
+///
+/// \param arg Command-line argument
+/// \param name Name with `--' and `='
+/// \param value Receives the value if the name matches
+/// \return `true' - the name matches, `false' - otherwise
+static _Bool int_option(const char *arg, const char *name, int *value)
+{
+    size_t len = strlen(name);
+    if (strncmp(arg, name, len) != 0) return false;
+    *value = atoi(arg + len);
+    return true;
+}
+
+/// Open the file in the corpus directory for writing.
+///
+/// \param dir Directory of the corpus
+/// \param name Name of the file in the directory
+/// \return Opened file, NULL on error (printed)
+static FILE *open_in_dir(const char *dir, const char *name)
+{
+    char *path = (char *) malloc(strlen(dir) + strlen(name) + 2);
+    if (!path)
+    {
+        fprintf(stderr, "Memory for file name cannot be allocated!\n");
+        return NULL;
+    }
+    sprintf(path, "%s/%s", dir, name);
+    FILE *res = fopen(path, "w");
+    if (!res) fprintf(stderr, "Cannot open for writing: %s\n", path);
+    free(path);
+    return res;
+}
+
+/// Write all the corpus.
+///
+/// \param argc Size of `argv'
+/// \param argv Arguments passed to the program
+/// \return 0 - OK, 2 - args error, 3 - I/O error
+int main(int argc, char *argv[])
+{
+    CORPUS_OPTIONS options = {4, 1024, 8, 20, 1000, 4096, 16, 1};
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] == '-'; ++arg)
+    {
+        int seed;
+        if (!int_option(argv[arg], "--files=", &options.files)
+            && !int_option(argv[arg], "--size=", &options.size)
+            && !int_option(argv[arg], "--depth=", &options.depth)
+            && !int_option(argv[arg], "--typedefs=", &options.typedefs)
+            && !int_option(argv[arg], "--init-length=", &options.init_length)
+            && !int_option(argv[arg], "--string-length=", &options.string_length)
+            && !int_option(argv[arg], "--includes=", &options.includes))
+        {
+            if (!int_option(argv[arg], "--seed=", &seed))
+            {
+                fprintf(stderr, "Unknown option: %s\n", argv[arg]);
+                return 2;
+            }
+            options.seed = (unsigned) seed;
+        }
+    }
+    if (arg != argc - 1 || options.files < 1 || options.size < 1 || options.depth < 0 || options.typedefs < 0
+        || options.init_length < 1 || options.string_length < 0 || options.includes < 0)
+    {
+        printf("Usage: %s [options] <out_dir>\n"
+               "Options (defaults in brackets):\n"
+               "  --files=N          number of sources [4]\n"
+               "  --size=KB          size of each source, headers not counted [1024]\n"
+               "  --depth=N          nesting depth of statements and expressions [8]\n"
+               "  --typedefs=P       percent of file-scope declarations which are typedefs [20]\n"
+               "  --init-length=N    elements of long initializer lists [1000]\n"
+               "  --string-length=N  characters of long string literals [4096]\n"
+               "  --includes=N       headers included by every source [16]\n"
+               "  --seed=N           seed of pseudo-random choices [1]\n",
+               argv[0]);
+        return 2;
+    }
+    const char *dir = argv[arg];
+#ifdef _WIN32
+    _mkdir(dir);
+#else
+    mkdir(dir, 0777);
+#endif
+    rng_state = options.seed ? options.seed : 1;
+
+    char name[32];
+    for (int i = 0; i < options.includes; ++i)
+    {
+        sprintf(name, "inc%d.h", i);
+        if (!(out = open_in_dir(dir, name))) return 3;
+        gen_header(i);
+        if (fclose(out) == EOF) return 3;
+    }
+    FILE *list = open_in_dir(dir, "list.txt");
+    if (!list) return 3;
+    for (int i = 0; i < options.files; ++i)
+    {
+        sprintf(name, "src%d.c", i);
+        if (!(out = open_in_dir(dir, name))) return 3;
+        written = 0;
+        gen_source(&options, dir);
+        _Bool failed = ferror(out);
+        if (fclose(out) == EOF || failed)
+        {
+            fprintf(stderr, "Cannot write into opened target file: %s/%s\n", dir, name);
+            return 3;
+        }
+        fprintf(list, "%s/%s\n", dir, name);
+    }
+    if (fclose(list) == EOF) return 3;
+    return 0;
+}
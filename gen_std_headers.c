@@ -0,0 +1,286 @@
+/**
+ * Build-time generator of `std_headers.h': typedef-names of the standard headers
+ * (ISO/IEC 9899:2018, Section 7) with a perfect hash of the header names
+ * and the precomputed transitive closure of header dependencies.
+ *
+ * Usage: gen_std_headers <out_file>
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Standard header: its name, headers whose typedef-names it provides too
+/// and typedef-names it declares itself (both space-separated).
+typedef struct
+{
+    char *name;
+    char *depends;
+    char *typedefs;
+}
+STD_HEADER;
+
+/// All the supported headers.
+static STD_HEADER headers[] =
+    {
+        {"assert.h", "", ""},
+        {"complex.h", "", "complex _Complex_I imaginary _Imaginary_I I"},
+        {"ctype.h", "", ""},
+        {"errno.h", "", "errno_t"},
+        {"fenv.h", "", "fenv_t fexcept_t"},
+        {"float.h", "", ""},
+        {"inttypes.h", "stddef.h stdint.h", "imaxdiv_t"},
+        {"iso646.h", "", ""},
+        {"limits.h", "", ""},
+        {"locale.h", "", ""},
+        {"math.h", "", "float_t double_t"},
+        {"setjmp.h", "", "jmp_buf"},
+        {"signal.h", "", "sig_atomic_t"},
+        {"stdalign.h", "", "alignas alignof"},
+        {"stdarg.h", "", "va_list"},
+        {"stdatomic.h", "",
+            "memory_order atomic_flag atomic_bool atomic_char atomic_schar atomic_uchar "
+            "atomic_short atomic_ushort atomic_int atomic_uint atomic_long atomic_ulong "
+            "atomic_llong atomic_ullong atomic_char16_t atomic_char32_t atomic_wchar_t "
+            "atomic_int_least8_t atomic_uint_least8_t atomic_int_least16_t "
+            "atomic_uint_least16_t atomic_int_least32_t atomic_uint_least32_t "
+            "atomic_int_least64_t atomic_uint_least64_t atomic_int_fast8_t "
+            "atomic_uint_fast8_t atomic_int_fast16_t atomic_uint_fast16_t atomic_int_fast32_t "
+            "atomic_uint_fast32_t atomic_int_fast64_t atomic_uint_fast64_t atomic_intptr_t "
+            "atomic_uintptr_t atomic_size_t atomic_ptrdiff_t atomic_intmax_t atomic_uintmax_t"},
+        {"stdbool.h", "", "bool"},
+        {"stddef.h", "", "ptrdiff_t size_t max_align_t wchar_t rsize_t"},
+        {"stdint.h", "",
+            "int8_t int16_t int32_t int64_t uint8_t uint16_t uint32_t uint64_t int_least8_t "
+            "int_least16_t int_least32_t int_least64_t uint_least8_t uint_least16_t "
+            "uint_least32_t uint_least64_t int_fast8_t int_fast16_t int_fast32_t int_fast64_t "
+            "uint_fast8_t uint_fast16_t uint_fast32_t uint_fast64_t intptr_t uintptr_t "
+            "intmax_t uintmax_t"},
+        {"stdio.h", "errno.h stddef.h", "FILE fpos_t"},
+        {"stdlib.h", "errno.h stddef.h", "div_t ldiv_t lldiv_t constraint_handler_t"},
+        {"stdnoreturn.h", "", "noreturn"},
+        {"string.h", "errno.h stddef.h", ""},
+        {"tgmath.h", "math.h complex.h", ""},
+        {"threads.h", "",
+            "thread_local cnd_t thrd_t tss_t mtx_t tss_dtor_t thrd_start_t once_flag"},
+        {"time.h", "errno.h stddef.h", "clock_t time_t"},
+        {"uchar.h", "wchar.h stddef.h", "char16_t char32_t"},
+        {"wchar.h", "errno.h stddef.h stdio.h", "mbstate_t wint_t"},
+        {"wctype.h", "wchar.h", "wctrans_t wctype_t"},
+    };
+
+/// Number of the supported headers.
+#define HEADERS_NUMBER ((int) (sizeof(headers) / sizeof(*headers)))
+
+/// Largest size of the hash table to try.
+#define MAX_HASH_SIZE 1024
+
+/// Number of seeds to try for each size.
+#define MAX_SEED 1000000
+
+/// Hash of a header name, the same as `std_header_hash' emitted below.
+///
+/// \param name Header name
+/// \param seed Seed of the hash function
+/// \return Hash value
+static uint32_t header_hash(const char *name, uint32_t seed)
+{
+    uint32_t hash = 2166136261u ^ seed;
+    for (const unsigned char *p = (const unsigned char *) name; *p != '\0'; ++p)
+    {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash ^ (hash >> 15);
+}
+
+/// Index of the header with the given name.
+///
+/// \param name Header name
+/// \param length Length of `name'
+/// \return Index in `headers', -1 if there is no such
+static int header_index(const char *name, size_t length)
+{
+    for (int i = 0; i < HEADERS_NUMBER; ++i)
+    {
+        if (strlen(headers[i].name) == length && strncmp(headers[i].name, name, length) == 0) return i;
+    }
+    return -1;
+}
+
+/// Add the header and everything it depends on to the closure.
+///
+/// \param header Index of the header
+/// \param closure Bitmask of headers to complete
+static void close_over(int header, uint32_t *closure)
+{
+    if (*closure & (UINT32_C(1) << header)) return;
+    *closure |= UINT32_C(1) << header;
+    const char *p = headers[header].depends;
+    while (*p != '\0')
+    {
+        size_t length = strcspn(p, " ");
+        int dependency = header_index(p, length);
+        if (dependency < 0)
+        {
+            fprintf(stderr, "Unknown dependency of %s: %.*s\n", headers[header].name, (int) length, p);
+            exit(1);
+        }
+        close_over(dependency, closure);
+        p += length;
+        p += strspn(p, " ");
+    }
+}
+
+/// Find a size and a seed for which `header_hash' has no collisions.
+///
+/// \param slots Where to put the header index of each slot (-1 - empty)
+/// \param size Where to put the size of the table
+/// \return Found seed
+static uint32_t find_perfect_hash(int *slots, uint32_t *size)
+{
+    for (uint32_t n = 1; n <= MAX_HASH_SIZE; n <<= 1)
+    {
+        if (n < (uint32_t) HEADERS_NUMBER) continue;
+        for (uint32_t seed = 0; seed < MAX_SEED; ++seed)
+        {
+            _Bool ok = true;
+            for (uint32_t i = 0; i < n; ++i) slots[i] = -1;
+            for (int i = 0; i < HEADERS_NUMBER && ok; ++i)
+            {
+                int *slot = &slots[header_hash(headers[i].name, seed) & (n - 1)];
+                if (*slot >= 0) ok = false;
+                *slot = i;
+            }
+            if (ok)
+            {
+                *size = n;
+                return seed;
+            }
+        }
+    }
+    fprintf(stderr, "Perfect hash for standard header names is not found!\n");
+    exit(1);
+}
+
+/// Program entry point.
+///
+/// \param argc Size of `argv'
+/// \param argv Arguments passed to the program
+/// \return 0 - OK, 1 - generation error, 2 - args error, 3 - I/O error
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        printf("Usage: %s <out_file>\n", argv[0]);
+        return 2;
+    }
+    if (HEADERS_NUMBER > 32)
+    {
+        fprintf(stderr, "Too many headers for a 32-bit mask: %d\n", HEADERS_NUMBER);
+        return 1;
+    }
+
+    int slots[MAX_HASH_SIZE];
+    uint32_t size;
+    uint32_t seed = find_perfect_hash(slots, &size);
+
+    FILE *out = fopen(argv[1], "w");
+    if (!out)
+    {
+        fprintf(stderr, "Cannot open for writing: %s\n", argv[1]);
+        return 3;
+    }
+
+    fprintf(out, "/**\n"
+                 " * typedef-names of the standard headers (ISO/IEC 9899:2018, Section 7).\n"
+                 " * NOTE: Generated by `gen_std_headers.c', do not edit.\n"
+                 " */\n\n"
+                 "#ifndef C_PARSER_STD_HEADERS_H_INCLUDED\n"
+                 "#define C_PARSER_STD_HEADERS_H_INCLUDED\n\n"
+                 "#include <stdint.h>\n"
+                 "#include <string.h>\n\n");
+    fprintf(out, "/// Number of the supported headers.\n"
+                 "#define STD_HEADERS_NUMBER %d\n\n", HEADERS_NUMBER);
+    fprintf(out, "/// Size of the perfect hash table of header names.\n"
+                 "#define STD_HEADER_HASH_SIZE %u\n\n", size);
+    fprintf(out, "/// Perfect hash of a header name.\n"
+                 "///\n"
+                 "/// \\param name Header name\n"
+                 "/// \\return Hash value\n"
+                 "static inline uint32_t std_header_hash(const char *name)\n"
+                 "{\n"
+                 "    uint32_t hash = 2166136261u ^ %uu;\n"
+                 "    for (const unsigned char *p = (const unsigned char *) name; *p != '\\0'; ++p)\n"
+                 "    {\n"
+                 "        hash = (hash ^ *p) * 16777619u;\n"
+                 "    }\n"
+                 "    return hash ^ (hash >> 15);\n"
+                 "}\n\n", seed);
+
+    fprintf(out, "/// Header index of each hash table slot, -1 - empty.\n"
+                 "static const signed char std_header_slots[STD_HEADER_HASH_SIZE] =\n    {");
+    for (uint32_t i = 0; i < size; ++i) fprintf(out, "%s%d", i ? (i % 16 ? ", " : ",\n     ") : "", slots[i]);
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "/// Header names.\n"
+                 "static const char *const std_header_names[STD_HEADERS_NUMBER] =\n    {\n");
+    for (int i = 0; i < HEADERS_NUMBER; ++i) fprintf(out, "        \"%s\",\n", headers[i].name);
+    fprintf(out, "    };\n\n");
+
+    fprintf(out, "/// For each header, bitmask of the headers it provides typedef-names of (itself included).\n"
+                 "static const uint32_t std_header_closures[STD_HEADERS_NUMBER] =\n    {\n");
+    for (int i = 0; i < HEADERS_NUMBER; ++i)
+    {
+        uint32_t closure = 0;
+        close_over(i, &closure);
+        fprintf(out, "        0x%08xu,  // %s\n", closure, headers[i].name);
+    }
+    fprintf(out, "    };\n\n");
+
+    fprintf(out, "/// typedef-names declared by the headers themselves, header after header.\n"
+                 "static const char *const std_header_typedefs[] =\n    {\n");
+    int begins[HEADERS_NUMBER + 1];
+    int total = 0;
+    for (int i = 0; i < HEADERS_NUMBER; ++i)
+    {
+        begins[i] = total;
+        const char *p = headers[i].typedefs;
+        while (*p != '\0')
+        {
+            size_t length = strcspn(p, " ");
+            fprintf(out, "        \"%.*s\",\n", (int) length, p);
+            ++total;
+            p += length;
+            p += strspn(p, " ");
+        }
+    }
+    begins[HEADERS_NUMBER] = total;
+    fprintf(out, "        NULL\n    };\n\n");
+
+    fprintf(out, "/// Index of the first typedef-name of each header in `std_header_typedefs'.\n"
+                 "static const unsigned short std_header_typedefs_begin[STD_HEADERS_NUMBER + 1] =\n    {");
+    for (int i = 0; i <= HEADERS_NUMBER; ++i) fprintf(out, "%s%d", i ? (i % 16 ? ", " : ",\n     ") : "", begins[i]);
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "/// Index of the header with the given name.\n"
+                 "///\n"
+                 "/// \\param name Header name\n"
+                 "/// \\return Index of the header, -1 if it is not supported\n"
+                 "static inline int std_header_find(const char *name)\n"
+                 "{\n"
+                 "    int header = std_header_slots[std_header_hash(name) & (STD_HEADER_HASH_SIZE - 1)];\n"
+                 "    return header >= 0 && strcmp(std_header_names[header], name) == 0 ? header : -1;\n"
+                 "}\n\n"
+                 "#endif //C_PARSER_STD_HEADERS_H_INCLUDED\n");
+
+    if (fclose(out) == EOF)
+    {
+        fprintf(stderr, "Cannot close opened target file: %s\n", argv[1]);
+        return 3;
+    }
+    return 0;
+}
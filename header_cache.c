@@ -0,0 +1,366 @@
+/**
+ * Process-wide cache of token streams of included source files,
+ * so a header included by many translation units is scanned only once.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "alloc_wrap.h"
+#include "header_cache.h"
+#include "string_tools.h"
+
+/// Initial number of tokens and spelling bytes of a stream.
+#define HEADER_LOG_INIT_SIZE 1024
+
+/// Initial number of include keys of a stream.
+#define HEADER_LOG_INIT_INCLUDES 16
+
+/// Initial number of buckets of the cache.
+#define HEADER_CACHE_INIT_BUCKETS 64
+
+/// Guards everything below.
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/// Chains of entries by the hash of the path.
+static HEADER_CACHE_ENTRY **buckets = NULL;
+
+/// Number of `buckets', a power of 2.
+static size_t bucket_number = 0;
+
+/// Number of cached headers.
+static size_t entry_number = 0;
+
+/// Memory taken by the cached headers.
+static size_t cached_size = 0;
+
+/// Numbers of `header_cache_acquire' calls which found an entry and which did not.
+static size_t hit_number = 0, miss_number = 0;
+
+void header_log_init(HEADER_LOG *log)
+{
+    *log = (HEADER_LOG) {NULL, 0, 0, NULL, 0, 0, NULL, 0, 0};
+}
+
+void header_log_add(HEADER_LOG *log, int token, int type, const char *text)
+{
+    if (log->length == log->capacity)
+    {
+        log->capacity = log->capacity ? log->capacity * 2 : HEADER_LOG_INIT_SIZE;
+        log->tokens = (HEADER_TOKEN *) my_realloc(log->tokens, sizeof(HEADER_TOKEN) * log->capacity,
+                "header token stream");
+    }
+    HEADER_TOKEN *res = &log->tokens[log->length++];
+    res->token = token;
+    res->type = type;
+    res->text = HEADER_NO_TEXT;
+    if (!text) return;
+
+    size_t len = strlen(text) + 1;
+    if (log->text_length + len > log->text_capacity)
+    {
+        if (!log->text_capacity) log->text_capacity = HEADER_LOG_INIT_SIZE;
+        while (log->text_length + len > log->text_capacity) log->text_capacity *= 2;
+        log->text = (char *) my_realloc(log->text, log->text_capacity, "header token spellings");
+    }
+    memcpy(log->text + log->text_length, text, len);
+    res->text = log->text_length;
+    log->text_length += len;
+}
+
+void header_log_add_include(HEADER_LOG *log, const char *name, const HEADER_KEY *key)
+{
+    if (log->includes_length == log->includes_capacity)
+    {
+        log->includes_capacity = log->includes_capacity ? log->includes_capacity * 2 : HEADER_LOG_INIT_INCLUDES;
+        log->includes = (HEADER_KEY *) my_realloc(log->includes, sizeof(HEADER_KEY) * log->includes_capacity,
+                "header includes");
+    }
+    HEADER_KEY *copy = &log->includes[log->includes_length++];
+    *copy = *key;
+    copy->path = key->path ? alloc_const_str(key->path) : NULL;
+    header_log_add(log, HEADER_FILE_INCLUDE, (int) (log->includes_length - 1), name);
+}
+
+void header_log_clear(HEADER_LOG *log)
+{
+    for (size_t i = 0; i < log->includes_length; ++i) header_key_free(&log->includes[i]);
+    log->length = 0;
+    log->text_length = 0;
+    log->includes_length = 0;
+}
+
+void header_log_free(HEADER_LOG *log)
+{
+    header_log_clear(log);
+    my_free(log->tokens);
+    my_free(log->text);
+    my_free(log->includes);
+    header_log_init(log);
+}
+
+/// Modification time of a file as kept in its key.
+///
+/// \param info Status of the file
+/// \return Seconds, or nanoseconds where they are known
+static long long key_mtime(const struct stat *info)
+{
+#ifdef __linux__
+    return (long long) info->st_mtime * 1000000000 + info->st_mtim.tv_nsec;
+#else
+    return (long long) info->st_mtime;
+#endif
+}
+
+_Bool header_key_init(HEADER_KEY *key, const char *name, FILE *file)
+{
+    struct stat info;
+    *key = (HEADER_KEY) {NULL, 0, 0};
+    if ((file ? fstat(fileno(file), &info) : stat(name, &info)) != 0 || !S_ISREG(info.st_mode)) return false;
+#ifdef _WIN32
+    key->path = _fullpath(NULL, name, 0);
+#else
+    key->path = realpath(name, NULL);
+#endif
+    if (!key->path) return false;
+    key->mtime = key_mtime(&info);
+    key->size = (long long) info.st_size;
+    return true;
+}
+
+void header_key_free(HEADER_KEY *key)
+{
+    my_free(key->path);
+    key->path = NULL;
+}
+
+/// Get the chain the path belongs to. NOTE: `cache_lock' must be held.
+///
+/// \param path Resolved path of a header
+/// \return Pointer to the head of the chain
+static HEADER_CACHE_ENTRY **find_bucket(const char *path)
+{
+    return &buckets[str_hash(path, NULL) & (bucket_number - 1)];
+}
+
+/// Free the entry. NOTE: It must be out of the cache and have no references.
+///
+/// \param entry Entry to free
+static void free_entry(HEADER_CACHE_ENTRY *entry)
+{
+    header_key_free(&entry->key);
+    for (size_t i = 0; i < entry->includes_length; ++i) header_key_free(&entry->includes[i]);
+    my_free(entry->includes);
+    my_free(entry->tokens);
+    my_free(entry->text);
+    my_free(entry);
+}
+
+/// Memory taken by the entry, for `HEADER_CACHE_MAX_SIZE'.
+///
+/// \param length Number of tokens
+/// \param text_length Size of spellings
+/// \param includes_length Number of included files
+/// \return Size in bytes
+static size_t entry_size(size_t length, size_t text_length, size_t includes_length)
+{
+    return sizeof(HEADER_CACHE_ENTRY) + sizeof(HEADER_TOKEN) * length + text_length
+        + sizeof(HEADER_KEY) * includes_length;
+}
+
+/// Do the keys name the same versions of the same files?
+///
+/// \param a First key
+/// \param b Second key
+/// \return `true' - the same, `false' - different, or one of them cannot be cached
+static _Bool same_key(const HEADER_KEY *a, const HEADER_KEY *b)
+{
+    return a->path && b->path && strcmp(a->path, b->path) == 0 && a->mtime == b->mtime && a->size == b->size;
+}
+
+/// Have the files included by the entry kept the versions it was scanned with?
+///
+/// \param entry Entry to check
+/// \return `true' - all of them, `false' - some changed or cannot be cached
+static _Bool includes_unchanged(const HEADER_CACHE_ENTRY *entry)
+{
+    for (size_t i = 0; i < entry->includes_length; ++i)
+    {
+        const HEADER_KEY *key = &entry->includes[i];
+        struct stat info;
+        if (!key->path || stat(key->path, &info) != 0 || key_mtime(&info) != key->mtime
+            || (long long) info.st_size != key->size)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Take the entry out of its chain and drop the cache's reference to it.
+/// NOTE: `cache_lock' must be held.
+///
+/// \param link Link pointing to the entry
+static void unlink_entry(HEADER_CACHE_ENTRY **link)
+{
+    HEADER_CACHE_ENTRY *entry = *link;
+    *link = entry->next;
+    --entry_number;
+    cached_size -= entry_size(entry->length, entry->text_length, entry->includes_length);
+    if (--entry->refs == 0) free_entry(entry);
+}
+
+/// Double the number of buckets. Without memory for them, the old ones are kept:
+/// the cache is only an optimization, and no failure may leave it locked. NOTE: `cache_lock' must be held.
+static void grow_buckets()
+{
+    size_t old_number = bucket_number;
+    HEADER_CACHE_ENTRY **old = buckets;
+    size_t number = old_number ? old_number * 2 : HEADER_CACHE_INIT_BUCKETS;
+    HEADER_CACHE_ENTRY **grown = (HEADER_CACHE_ENTRY **) calloc(number, sizeof(HEADER_CACHE_ENTRY *));
+    if (!grown) return;
+    buckets = grown;
+    bucket_number = number;
+    for (size_t i = 0; i < old_number; ++i)
+    {
+        HEADER_CACHE_ENTRY *entry = old[i];
+        while (entry)
+        {
+            HEADER_CACHE_ENTRY *next = entry->next;
+            HEADER_CACHE_ENTRY **bucket = find_bucket(entry->key.path);
+            entry->next = *bucket;
+            *bucket = entry;
+            entry = next;
+        }
+    }
+    free(old);
+}
+
+HEADER_CACHE_ENTRY *header_cache_acquire(const HEADER_KEY *key)
+{
+    HEADER_CACHE_ENTRY *res = NULL;
+    pthread_mutex_lock(&cache_lock);
+    if (bucket_number)
+    {
+        for (res = *find_bucket(key->path); res; res = res->next)
+        {
+            if (strcmp(res->key.path, key->path) == 0) break;
+        }
+    }
+    if (res && res->key.mtime == key->mtime && res->key.size == key->size) ++res->refs;
+    else res = NULL;
+    pthread_mutex_unlock(&cache_lock);
+
+    // Included files are looked at without holding the lock, the entry is kept by the reference
+    if (res && !includes_unchanged(res))
+    {
+        header_cache_release(res);
+        res = NULL;
+    }
+    pthread_mutex_lock(&cache_lock);
+    if (res) ++hit_number;
+    else ++miss_number;
+    pthread_mutex_unlock(&cache_lock);
+    return res;
+}
+
+void header_cache_release(HEADER_CACHE_ENTRY *entry)
+{
+    pthread_mutex_lock(&cache_lock);
+    _Bool unused = --entry->refs == 0;
+    pthread_mutex_unlock(&cache_lock);
+    if (unused) free_entry(entry);
+}
+
+void header_cache_put(const HEADER_KEY *key, const HEADER_LOG *log, size_t from, size_t text_from,
+                      size_t includes_from)
+{
+    size_t length = log->length - from;
+    size_t text_length = log->text_length - text_from;
+    size_t includes_length = log->includes_length - includes_from;
+    HEADER_CACHE_ENTRY *entry = (HEADER_CACHE_ENTRY *) my_malloc(sizeof(HEADER_CACHE_ENTRY), "header cache");
+    entry->key = *key;
+    entry->key.path = alloc_const_str(key->path);
+    entry->tokens = (HEADER_TOKEN *) my_malloc(sizeof(HEADER_TOKEN) * (length ? length : 1), "header cache");
+    entry->length = length;
+    entry->text = (char *) my_malloc(text_length ? text_length : 1, "header cache");
+    entry->text_length = text_length;
+    entry->includes = (HEADER_KEY *) my_malloc(sizeof(HEADER_KEY) * (includes_length ? includes_length : 1),
+            "header cache");
+    entry->includes_length = 0;
+    entry->refs = 1;
+    if (text_length) memcpy(entry->text, log->text + text_from, text_length);
+    for (size_t i = 0; i < length; ++i)
+    {
+        entry->tokens[i] = log->tokens[from + i];
+        if (entry->tokens[i].text != HEADER_NO_TEXT) entry->tokens[i].text -= text_from;
+        if (entry->tokens[i].token == HEADER_FILE_INCLUDE) entry->tokens[i].type -= (int) includes_from;
+    }
+    for (size_t i = 0; i < includes_length; ++i)
+    {
+        const HEADER_KEY *include = &log->includes[includes_from + i];
+        entry->includes[i] = *include;
+        entry->includes[i].path = include->path ? alloc_const_str(include->path) : NULL;
+        ++entry->includes_length;
+    }
+    size_t size = entry_size(length, text_length, includes_length);
+
+    pthread_mutex_lock(&cache_lock);
+    if (entry_number >= bucket_number) grow_buckets();
+    if (!bucket_number)
+    {
+        pthread_mutex_unlock(&cache_lock);
+        free_entry(entry);
+        return;
+    }
+    HEADER_CACHE_ENTRY **link = find_bucket(key->path);
+    while (*link && strcmp((*link)->key.path, key->path) != 0) link = &(*link)->next;
+    // Another thread may have put the same version meanwhile, then that one is kept
+    _Bool fresh = !*link || (*link)->key.mtime != key->mtime || (*link)->key.size != key->size
+        || (*link)->includes_length != includes_length;
+    for (size_t i = 0; !fresh && i < includes_length; ++i)
+    {
+        fresh = !same_key(&(*link)->includes[i], &entry->includes[i]);
+    }
+    if (fresh && *link) unlink_entry(link);
+    if (fresh && cached_size + size <= HEADER_CACHE_MAX_SIZE)
+    {
+        entry->next = *find_bucket(key->path);
+        *find_bucket(key->path) = entry;
+        ++entry_number;
+        cached_size += size;
+        entry = NULL;
+    }
+    pthread_mutex_unlock(&cache_lock);
+    if (entry) free_entry(entry);
+}
+
+void header_cache_stats(size_t *hits, size_t *misses, size_t *entries)
+{
+    pthread_mutex_lock(&cache_lock);
+    if (hits) *hits = hit_number;
+    if (misses) *misses = miss_number;
+    if (entries) *entries = entry_number;
+    pthread_mutex_unlock(&cache_lock);
+}
+
+void header_cache_clear()
+{
+    pthread_mutex_lock(&cache_lock);
+    for (size_t i = 0; i < bucket_number; ++i)
+    {
+        while (buckets[i]) unlink_entry(&buckets[i]);
+    }
+    free(buckets);
+    buckets = NULL;
+    bucket_number = 0;
+    hit_number = miss_number = 0;
+    pthread_mutex_unlock(&cache_lock);
+}
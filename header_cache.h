@@ -0,0 +1,164 @@
+/**
+ * Process-wide cache of token streams of included source files,
+ * so a header included by many translation units is scanned only once.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#ifndef C_PARSER_HEADER_CACHE_H_INCLUDED
+#define C_PARSER_HEADER_CACHE_H_INCLUDED
+
+#include <stddef.h>
+#include <stdio.h>
+
+/// Pseudo-token: `#include <...>' of a standard header, the text is its name.
+#define HEADER_STD_INCLUDE (-1)
+
+/// Pseudo-token: warning printed by the lexer, the text is the message.
+#define HEADER_WARNING (-2)
+
+/// Pseudo-token: `#include "..."' of a file, the text is its name,
+/// the type is the index of its key in the stream's `includes'.
+#define HEADER_FILE_INCLUDE (-4)
+
+/// `text' of a token without a spelling.
+#define HEADER_NO_TEXT ((size_t) -1)
+
+/// Upper bound of memory taken by all the cached headers.
+#define HEADER_CACHE_MAX_SIZE (256 * 1024 * 1024)
+
+/// Token of a header as the lexer gave it to the parser.
+/// Identifiers are kept as IDENTIFIER, they are classified again on replay,
+/// since the same name may or may not be a typedef-name in different places.
+typedef struct
+{
+    /// Token code or one of the pseudo-tokens
+    int token;
+    /// Type of the token's AST node, if it has a spelling
+    int type;
+    /// Offset of the spelling in the text block or `HEADER_NO_TEXT'
+    size_t text;
+}
+HEADER_TOKEN;
+
+/// Identity of a file's content: the resolved path with modification time and size.
+typedef struct
+{
+    char *path;
+    long long mtime;
+    long long size;
+}
+HEADER_KEY;
+
+/// Growable token stream with the text block of its spellings.
+typedef struct
+{
+    HEADER_TOKEN *tokens;
+    size_t length;
+    size_t capacity;
+    char *text;
+    size_t text_length;
+    size_t text_capacity;
+    /// Keys of the files of `HEADER_FILE_INCLUDE' tokens, in their order
+    HEADER_KEY *includes;
+    size_t includes_length;
+    size_t includes_capacity;
+}
+HEADER_LOG;
+
+/// Cached header. Entries are immutable, so they are read without locking
+/// by everyone holding a reference.
+typedef struct HEADER_CACHE_ENTRY
+{
+    struct HEADER_CACHE_ENTRY *next;
+    HEADER_KEY key;
+    HEADER_TOKEN *tokens;
+    size_t length;
+    char *text;
+    size_t text_length;
+    /// Keys of the files the header includes at any depth, the entry is given only while they are unchanged
+    HEADER_KEY *includes;
+    size_t includes_length;
+    size_t refs;
+}
+HEADER_CACHE_ENTRY;
+
+/// Initialize an empty token stream.
+///
+/// \param log Stream to initialize
+void header_log_init(HEADER_LOG *log);
+
+/// Append a token to the stream.
+///
+/// \param log Stream to append to
+/// \param token Token code or pseudo-token
+/// \param type Type of the token's AST node (ignored without `text')
+/// \param text Spelling of the token, copied, or NULL
+void header_log_add(HEADER_LOG *log, int token, int type, const char *text);
+
+/// Append `#include "..."' of a file to the stream (see `HEADER_FILE_INCLUDE').
+///
+/// \param log Stream to append to
+/// \param name Name of the included file, copied
+/// \param key Key of the file as it was read, copied. Its `path' is NULL if the file cannot be cached,
+///            then headers including it are never given from the cache
+void header_log_add_include(HEADER_LOG *log, const char *name, const HEADER_KEY *key);
+
+/// Drop all the tokens of the stream, keeping its memory.
+///
+/// \param log Stream to clear
+void header_log_clear(HEADER_LOG *log);
+
+/// Free memory of the stream.
+///
+/// \param log Stream to free
+void header_log_free(HEADER_LOG *log);
+
+/// Get the key of a file. NOTE: `path' of the key needs to be freed by `header_key_free'.
+///
+/// \param key Key to fill in
+/// \param name Name the file is opened by
+/// \param file The file opened, or NULL to look it up by `name'
+/// \return `true' - OK, `false' - the file cannot be cached (not a regular file, no such file)
+_Bool header_key_init(HEADER_KEY *key, const char *name, FILE *file);
+
+/// Free memory of the key.
+///
+/// \param key Key to free
+void header_key_free(HEADER_KEY *key);
+
+/// Find a cached header with the same path, modification time and size,
+/// whose included files have not changed either.
+/// NOTE: The entry found needs to be released by `header_cache_release'.
+///
+/// \param key Key of the header
+/// \return The entry, NULL if there is no such
+HEADER_CACHE_ENTRY *header_cache_acquire(const HEADER_KEY *key);
+
+/// Drop the reference taken by `header_cache_acquire'.
+///
+/// \param entry Entry to release
+void header_cache_release(HEADER_CACHE_ENTRY *entry);
+
+/// Cache the tail of a token stream as the content of a header.
+/// Another version of the same path, or one with other versions of its included files, is replaced.
+///
+/// \param key Key of the header, copied
+/// \param log Stream holding the header's tokens
+/// \param from Index of the header's first token in `log'
+/// \param text_from Offset of the header's first spelling in `log'
+/// \param includes_from Index of the key of the header's first include in `log'
+void header_cache_put(const HEADER_KEY *key, const HEADER_LOG *log, size_t from, size_t text_from,
+                      size_t includes_from);
+
+/// Get numbers describing the cache.
+///
+/// \param hits If not NULL, receives the number of includes replayed from the cache
+/// \param misses If not NULL, receives the number of includes scanned from files
+/// \param entries If not NULL, receives the number of cached headers
+void header_cache_stats(size_t *hits, size_t *misses, size_t *entries);
+
+/// Drop all the cached headers. Nobody may hold references to them.
+void header_cache_clear();
+
+#endif //C_PARSER_HEADER_CACHE_H_INCLUDED
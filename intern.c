@@ -0,0 +1,111 @@
+/**
+ * Pool of interned strings: one canonical copy per distinct spelling.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc_wrap.h"
+#include "intern.h"
+#include "string_tools.h"
+
+/// Initial capacity of the pool's table, power of two.
+#define INTERN_TABLE_INIT_SIZE 1024
+
+void init_intern_pool(INTERN_POOL *pool)
+{
+    *pool = (INTERN_POOL) {NULL, 0, 0, 0, 0};
+    arena_init(&pool->arena);
+}
+
+/// Find the slot of the given string, or the free slot for it.
+///
+/// \param pool Pool to search in
+/// \param str String to search for
+/// \param hash Hash of `str'
+/// \param len Length of `str'
+/// \return Slot with this string or an empty one
+static INTERN_ENTRY *find_slot(INTERN_POOL *pool, const char *str, uint32_t hash, uint32_t len)
+{
+    uint32_t mask = pool->capacity - 1;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        INTERN_ENTRY *slot = &pool->table[i];
+        if (!slot->str || (slot->hash == hash && slot->len == len && memcmp(slot->str, str, len) == 0))
+        {
+            return slot;
+        }
+    }
+}
+
+/// Double the capacity of the pool's table.
+///
+/// \param pool Pool to grow
+static void grow_table(INTERN_POOL *pool)
+{
+    INTERN_ENTRY *old = pool->table;
+    uint32_t old_capacity = pool->capacity;
+    pool->capacity = old_capacity ? old_capacity * 2 : INTERN_TABLE_INIT_SIZE;
+    pool->table = (INTERN_ENTRY *) calloc(pool->capacity, sizeof(INTERN_ENTRY));
+    if (!pool->table)
+    {
+        pool->table = old;
+        pool->capacity = old_capacity;
+        alloc_fail("string pool");
+    }
+    for (uint32_t i = 0; i < old_capacity; ++i)
+    {
+        if (old[i].str) *find_slot(pool, old[i].str, old[i].hash, old[i].len) = old[i];
+    }
+    free(old);
+}
+
+char *intern_str(INTERN_POOL *pool, const char *str)
+{
+    if ((pool->distinct + 1) * 2 > pool->capacity) grow_table(pool);
+    size_t len;
+    uint32_t hash = str_hash(str, &len);
+    INTERN_ENTRY *slot = find_slot(pool, str, hash, (uint32_t) len);
+    ++pool->occurrences;
+    if (slot->str)
+    {
+        pool->saved += len + 1;
+        return slot->str;
+    }
+    char *copy = (char *) arena_alloc(&pool->arena, len + 1, "interned string");
+    memcpy(copy, str, len + 1);
+    *slot = (INTERN_ENTRY) {copy, hash, (uint32_t) len};
+    ++pool->distinct;
+    return copy;
+}
+
+char *intern_find(INTERN_POOL *pool, const char *str)
+{
+    if (!pool->distinct) return NULL;
+    size_t len;
+    uint32_t hash = str_hash(str, &len);
+    return find_slot(pool, str, hash, (uint32_t) len)->str;
+}
+
+void intern_stats(INTERN_POOL *pool, size_t *distinct, size_t *occurrences, size_t *saved)
+{
+    if (distinct) *distinct = pool->distinct;
+    if (occurrences) *occurrences = pool->occurrences;
+    if (saved) *saved = pool->saved;
+}
+
+void intern_print_stats(INTERN_POOL *pool, FILE *out)
+{
+    fprintf(out, "Interned identifiers: %zu distinct, %zu occurrences, %zu bytes in pool, %zu bytes saved\n",
+            pool->distinct, pool->occurrences, pool->arena.used, pool->saved);
+}
+
+void free_intern_pool(INTERN_POOL *pool)
+{
+    free(pool->table);
+    arena_free(&pool->arena);
+    init_intern_pool(pool);
+}
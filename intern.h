@@ -0,0 +1,76 @@
+/**
+ * Pool of interned strings: one canonical copy per distinct spelling.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#ifndef C_PARSER_INTERN_H_INCLUDED
+#define C_PARSER_INTERN_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "alloc_wrap.h"
+
+/// Entry of the pool's table.
+typedef struct
+{
+    char *str;
+    uint32_t hash;
+    uint32_t len;
+}
+INTERN_ENTRY;
+
+/// Pool of interned strings (open addressing, linear probing).
+typedef struct
+{
+    INTERN_ENTRY *table;
+    uint32_t capacity;
+    size_t distinct;
+    size_t occurrences;
+    size_t saved;
+    ARENA arena;
+}
+INTERN_POOL;
+
+/// Initialize an empty pool.
+///
+/// \param pool Pool to initialize
+void init_intern_pool(INTERN_POOL *pool);
+
+/// Get the canonical copy of the given string, creating it on the first request.
+/// Equal strings always give the same pointer, so they can be compared by address.
+/// The copy lives until `free_intern_pool'.
+///
+/// \param pool Pool to intern in
+/// \param str String to intern
+/// \return Canonical copy of the string
+char *intern_str(INTERN_POOL *pool, const char *str);
+
+/// Get the canonical copy of the given string if it was interned before.
+///
+/// \param pool Pool to search in
+/// \param str String to search for
+/// \return Canonical copy of the string, NULL if there is no such
+char *intern_find(INTERN_POOL *pool, const char *str);
+
+/// Get numbers describing the pool.
+///
+/// \param pool Pool to describe
+/// \param distinct If not NULL, receives the number of distinct strings
+/// \param occurrences If not NULL, receives the number of `intern_str' calls
+/// \param saved If not NULL, receives the number of bytes not copied thanks to interning
+void intern_stats(INTERN_POOL *pool, size_t *distinct, size_t *occurrences, size_t *saved);
+
+/// Print statistics of the pool.
+///
+/// \param pool Pool to describe
+/// \param out File to print to
+void intern_print_stats(INTERN_POOL *pool, FILE *out);
+
+/// Free memory allocated by the pool. All the canonical copies become invalid.
+///
+/// \param pool Pool to free
+void free_intern_pool(INTERN_POOL *pool);
+
+#endif //C_PARSER_INTERN_H_INCLUDED
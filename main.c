@@ -5,75 +5,23 @@
  * @authors: Denis Chernikov, Vladislav Kuleykin
  */
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include "ast.h"
+#include <string.h>
+#include "alloc_wrap.h"
+#include "batch.h"
+#include "convert.h"
+#include "header_cache.h"
+#include "result_cache.h"
+#include "server.h"
 #include "string_tools.h"
-#include "typedef_name.h"
-#include "y.tab.h"
+#include "thread_pool.h"
 
-/// Input file for Flex.
-extern FILE *yyin;
-
-/// Conversion function for AST node content.
-///
-/// \param obj Object of AST content
-/// \return String representation of the given node's content
-char *content_to_str(AST_NODE *node)
+/// Write the allocation profile into `stderr', at exit with `--alloc-profile'.
+static void print_alloc_profile()
 {
-    if (node->type == Identifier || node->type == StringLiteral || node->type == IntegerConstant
-        || node->type == FloatingConstant || node->type == CharacterConstant)
-    {
-        return alloc_const_str((char *) node->content.value);  // TODO constant types support
-    }
-    switch (node->content.token)
-    {
-        case AUTO: return "AUTO";
-        case BREAK: return "BREAK";
-        case CASE: return "CASE";
-        case CHAR: return "CHAR";
-        case CONST: return "CONST";
-        case CONTINUE: return "CONTINUE";
-        case DEFAULT: return "DEFAULT";
-        case DO: return "DO";
-        case DOUBLE: return "DOUBLE";
-        case ELSE: return "ELSE";
-        case ENUM: return "ENUM";
-        case EXTERN: return "EXTERN";
-        case FLOAT: return "FLOAT";
-        case FOR: return "FOR";
-        case GOTO: return "GOTO";
-        case IF: return "IF";
-        case INLINE: return "INLINE";
-        case INT: return "INT";
-        case LONG: return "LONG";
-        case REGISTER: return "REGISTER";
-        case RESTRICT: return "RESTRICT";
-        case RETURN: return "RETURN";
-        case SHORT: return "SHORT";
-        case SIGNED: return "SIGNED";
-        case SIZEOF: return "SIZEOF";
-        case STATIC: return "STATIC";
-        case STRUCT: return "STRUCT";
-        case SWITCH: return "SWITCH";
-        case TYPEDEF: return "TYPEDEF";
-        case UNION: return "UNION";
-        case UNSIGNED: return "UNSIGNED";
-        case VOID: return "VOID";
-        case VOLATILE: return "VOLATILE";
-        case WHILE: return "WHILE";
-        case ALIGNAS: return "ALIGNAS";
-        case ALIGNOF: return "ALIGNOF";
-        case ATOMIC: return "ATOMIC";
-        case BOOL: return "BOOL";
-        case COMPLEX: return "COMPLEX";
-        case GENERIC: return "GENERIC";
-        case IMAGINARY: return "IMAGINARY";
-        case NORETURN: return "NORETURN";
-        case STATIC_ASSERT: return "STATIC_ASSERT";
-        case THREAD_LOCAL: return "THREAD_LOCAL";
-        default: return NULL;
-    }
+    alloc_profile_write(stderr);
 }
 
 /// Program entry point.
@@ -83,74 +31,185 @@ char *content_to_str(AST_NODE *node)
 /// \return 0 - OK, 1 - processing error, 2 - args error, 3 - I/O error
 int main(int argc, char *argv[])
 {
-    if (argc < 2)
+    // Options go before file names
+    CONVERT_OPTIONS options = {false, false, false, false, false, false, false, 1, NULL};
+    RESULT_CACHE cache = {NULL, RESULT_CACHE_DEFAULT_SIZE * 1024LL * 1024, false};
+    _Bool batch_mode = false;
+    _Bool from_binary = false;
+    const char *serve_path = NULL;
+    BATCH_OPTIONS batch_options = {thread_pool_default_size(), ".", options};
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] == '-'; ++arg)
     {
-        printf("Usage: %s <out_file> OR %s <in_file> <out_file>\n",
-                argv[0], argv[0]);
-        return 2;
+        if (str_eq(argv[arg], "--flat"))
+        {
+            options.flat = true;
+        }
+        else if (str_eq(argv[arg], "--intern-stats"))
+        {
+            options.intern_stats = true;
+        }
+        else if (str_eq(argv[arg], "--binary"))
+        {
+            options.binary = true;
+        }
+        else if (str_eq(argv[arg], "--ndjson"))
+        {
+            options.ndjson = true;
+        }
+        else if (str_eq(argv[arg], "--stats"))
+        {
+            options.stats = true;
+        }
+        else if (str_eq(argv[arg], "--prefilter"))
+        {
+            options.prefilter = true;
+        }
+        else if (str_eq(argv[arg], "--typed-constants"))
+        {
+            options.typed_constants = true;
+        }
+        else if (str_eq(argv[arg], "--alloc-profile"))
+        {
+            alloc_profile_start();
+            atexit(&print_alloc_profile);
+        }
+        else if (str_eq(argv[arg], "--from-binary"))
+        {
+            from_binary = true;
+        }
+        else if (strncmp(argv[arg], "--cache-dir=", 12) == 0)
+        {
+            cache.dir = argv[arg] + 12;
+            options.cache = &cache;
+        }
+        else if (strncmp(argv[arg], "--cache-size=", 13) == 0)
+        {
+            cache.max_size = atoll(argv[arg] + 13) * 1024 * 1024;
+            if (cache.max_size <= 0)
+            {
+                fprintf(stderr, "Wrong size of the cache: %s\n", argv[arg] + 13);
+                return 2;
+            }
+        }
+        else if (str_eq(argv[arg], "--cache-link"))
+        {
+            cache.link = true;
+        }
+        else if (str_eq(argv[arg], "--batch"))
+        {
+            batch_mode = true;
+        }
+        else if (strncmp(argv[arg], "--jobs=", 7) == 0)
+        {
+            batch_options.jobs = atoi(argv[arg] + 7);
+            if (batch_options.jobs < 1)
+            {
+                fprintf(stderr, "Wrong number of jobs: %s\n", argv[arg] + 7);
+                return 2;
+            }
+        }
+        else if (strncmp(argv[arg], "--serve=", 8) == 0)
+        {
+            serve_path = argv[arg] + 8;
+        }
+        else if (strncmp(argv[arg], "--out-dir=", 10) == 0)
+        {
+            batch_options.out_dir = argv[arg] + 10;
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option: %s\n", argv[arg]);
+            return 2;
+        }
     }
-
-    int res;  // For results of I/O functions
-
-    char *in_name = argc > 2 ? argv[1] : NULL;
-    char *out_name = argc > 2 ? argv[2] : argv[1];
-
-    yyin = in_name ? fopen(in_name, "r") : stdin;
-    if (!yyin)
+    int files = argc - arg;
+    if (options.ndjson && (options.flat || options.binary))
     {
-        fprintf(stderr, "Cannot open for reading: %s\n", in_name);
-        return 3;
+        fprintf(stderr, "Option `--ndjson' cannot be combined with `--flat' or `--binary'!\n");
+        return 2;
     }
-
-    AST_NODE *root = NULL;
-    if (!in_name) printf("Input your code here (Ctrl+Z for EOF):\n");
-    int yyres = yyparse((void **) &root);
-    free_typedef_name();
-    res = argc > 2 ? fclose(yyin) : 0;
-
-    if (yyres || !root)
+    if (options.typed_constants && options.binary)
     {
-        fprintf(stderr, "Parsing failed! No output will be provided.\n");
-        return 1;
+        fprintf(stderr, "Option `--typed-constants' cannot be combined with `--binary'!\n");
+        return 2;
     }
 
-    if (res == EOF)
+    if (serve_path)
     {
-        fprintf(stderr, "Cannot close opened source file: %s\n", in_name);
-        ast_free(root);
-        return 3;
+        if (files > 0)
+        {
+            fprintf(stderr, "Option `--serve' takes no files, sources come through the socket!\n");
+            return 2;
+        }
+        return server_run(serve_path, batch_options.jobs);
     }
 
-    char *json = ast_to_json(root, 0, "    ", &content_to_str);
-    ast_free(root);
-    if (!json)
+    if (files < 1)
     {
-        fprintf(stderr, "JSON generation failure!\n");
-        return 1;
+        printf("Usage: %s [options] <out_file> OR %s [options] <in_file> <out_file>\n"
+               "    OR %s --batch [options] <in_file | @list_file | ->...\n"
+               "    OR %s --from-binary <in_ast_file> <out_file>\n"
+               "    OR %s --serve=SOCKET [--jobs=N]\n"
+               "Options:\n"
+               "  --flat          build the AST into flat, index-based storage\n"
+               "  --intern-stats  print numbers of distinct and all identifiers\n"
+               "  --binary        write the binary AST (see `ast_binary.h') instead of JSON\n"
+               "  --from-binary   convert the binary AST into JSON\n"
+               "  --ndjson        write every top-level declaration as a line of JSON while parsing\n"
+               "  --stats         print time of phases and counters of every conversion into stderr as JSON\n"
+               "  --prefilter     replace trigraphs and remove line splices in one pass before scanning\n"
+               "  --typed-constants\n"
+               "                  add values and types of integer and floating constants to the JSON\n"
+               "  --alloc-profile print allocations by description into stderr at exit\n"
+               "  --cache-dir=DIR reuse outputs of unchanged sources stored in the directory, store new ones\n"
+               "  --cache-size=MB upper bound of the size of the cache directory (default: %d)\n"
+               "  --cache-link    give outputs from the cache as hard links instead of copies\n"
+               "  --batch         convert many files, `@list_file' and `-' (stdin) list them one per line\n"
+               "  --jobs=N        number of worker threads: for files in batch mode, for JSON of a big file otherwise\n"
+               "                  (default: number of processors)\n"
+               "  --out-dir=DIR   directory for outputs of batch mode (default: current)\n"
+               "  --serve=SOCKET  convert sources sent through the Unix domain socket (see `server.h'),\n"
+               "                  `--jobs' of them at a time\n",
+                argv[0], argv[0], argv[0], argv[0], argv[0], RESULT_CACHE_DEFAULT_SIZE);
+        return 2;
     }
 
-    FILE *out = fopen(argv[in_name ? 2 : 1], "w");
-    if (!out)
+    if (from_binary)
     {
-        fprintf(stderr, "Cannot open for writing: %s\n", out_name);
-        free(json);
-        return 3;
+        if (files != 2)
+        {
+            fprintf(stderr, "Input and output files are needed to convert binary AST!\n");
+            return 2;
+        }
+        return convert_binary_to_json(argv[arg], argv[arg + 1], options.typed_constants);
     }
 
-    res = fputs(json, out);
-    free(json);
-    if (res == EOF)
+    if (batch_mode)
     {
-        fprintf(stderr, "Cannot write into opened target file: %s\n", out_name);
-        return 3;
+        BATCH_LIST list;
+        batch_list_init(&list);
+        for (; arg < argc; ++arg)
+        {
+            if (batch_list_add(&list, argv[arg]) != 0)
+            {
+                batch_list_free(&list);
+                return 3;
+            }
+        }
+        batch_options.convert = options;  // Files are converted in parallel, each on one thread
+        int res = batch_run(&list, &batch_options);
+        batch_list_free(&list);
+        header_cache_clear();
+        return res;
     }
 
-    res = fclose(out);
-    if (res == EOF)
-    {
-        fprintf(stderr, "Cannot close opened target file: %s\n", out_name);
-        return 3;
-    }
+    char *in_name = files > 1 ? argv[arg] : NULL;
+    char *out_name = files > 1 ? argv[arg + 1] : argv[arg];
 
-    return 0;
+    if (!in_name) printf("Input your code here (Ctrl+Z for EOF):\n");
+    options.jobs = batch_options.jobs;
+    int res = convert_file(in_name, out_name, &options);
+    header_cache_clear();
+    return res;
 }
@@ -1,8 +1,10 @@
 #!/bin/bash
 bison -y -d yacc_syntax.y
 flex flex_tokens.l
-gcc main.c lex.yy.c y.tab.c alloc_wrap.c ast.c string_tools.c typedef_name.c -o c_parser
-rm y.tab.c y.tab.h lex.yy.c
+gcc gen_std_headers.c -o gen_std_headers
+./gen_std_headers std_headers.h
+gcc main.c lex.yy.c y.tab.c alloc_wrap.c ast.c string_tools.c typedef_name.c writer.c intern.c parse_context.c convert.c batch.c thread_pool.c -pthread source_map.c header_cache.c ast_binary.c stats.c result_cache.c constant.c server.c -o c_parser
+rm y.tab.c y.tab.h lex.yy.c std_headers.h gen_std_headers
 read -p "Enter input filename (leave empty for `stdin'): " in
 ./c_parser $in out.txt
 rm c_parser
@@ -0,0 +1,283 @@
+/**
+ * End-to-end throughput benchmark: lexing, parsing, JSON generation and freeing
+ * of the given sources are timed separately (see `gen_corpus.c' for a corpus).
+ * Results may be compared against a baseline stored by an earlier run.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ast.h"
+#include "batch.h"
+#include "convert.h"
+#include "header_cache.h"
+#include "parse_context.h"
+#include "stats.h"
+#include "string_tools.h"
+#include "writer.h"
+
+/// Phases measured, in the order they run.
+typedef enum
+{
+    PHASE_LEX,
+    /// Parsing with the lexing it drives, the lexer is called by the parser
+    PHASE_LEX_PARSE,
+    PHASE_JSON,
+    PHASE_FREE,
+    PHASES_NUMBER
+}
+BENCH_PHASE;
+
+/// Names of the phases, as in the baseline file.
+static const char *phase_names[PHASES_NUMBER] = {"lex", "lex+parse", "json", "free"};
+
+/// Maximum number of runs.
+#define MAX_RUNS 101
+
+/// Seconds of processor time since the given moment.
+///
+/// \param start Moment to count from
+/// \return Seconds passed
+static double seconds_since(clock_t start)
+{
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+/// Compare seconds for `qsort'.
+static int by_time(const void *a, const void *b)
+{
+    double ta = *(const double *) a, tb = *(const double *) b;
+    return ta < tb ? -1 : ta > tb;
+}
+
+/// Run every phase over all the files once. The header cache is dropped before
+/// lexing and before parsing each file, so every run scans the same text.
+///
+/// \param list Sources
+/// \param times Receives seconds spent in each phase
+/// \param tokens Receives the number of tokens
+/// \return 0 - OK, 3 - a file cannot be opened, 4 - a file cannot be parsed
+static int run_once(const BATCH_LIST *list, double times[PHASES_NUMBER], size_t *tokens)
+{
+    for (int i = 0; i < PHASES_NUMBER; ++i) times[i] = 0;
+    *tokens = 0;
+    for (size_t i = 0; i < list->number; ++i)
+    {
+        const char *name = list->files[i].name;
+        FILE *in = fopen(name, "r");
+        if (!in)
+        {
+            fprintf(stderr, "Cannot open for reading: %s\n", name);
+            return 3;
+        }
+        PARSE_CONTEXT ctx;
+        parse_context_init(&ctx);
+        ctx.file_name = name;
+        header_cache_clear();
+        clock_t start = clock();
+        *tokens += scan_file(&ctx, in);
+        times[PHASE_LEX] += seconds_since(start);
+        parse_context_free(&ctx);
+        fclose(in);
+
+        if (!(in = fopen(name, "r")))
+        {
+            fprintf(stderr, "Cannot open for reading: %s\n", name);
+            return 3;
+        }
+        parse_context_init(&ctx);
+        ctx.file_name = name;
+        header_cache_clear();
+        start = clock();
+        int res = parse_file(&ctx, in);
+        times[PHASE_LEX_PARSE] += seconds_since(start);
+        fclose(in);
+        if (res || ctx.error_found || !ctx.root)
+        {
+            fprintf(stderr, "Parsing failed: %s\n", name);
+            parse_context_free(&ctx);
+            return 4;
+        }
+
+        WRITER writer;
+        writer_init_buffer(&writer);
+        start = clock();
+        ast_write_json(&writer, ctx.root, 0, "    ", &content_to_str);
+        free(writer_release(&writer));
+        times[PHASE_JSON] += seconds_since(start);
+
+        start = clock();
+        parse_context_free(&ctx);
+        times[PHASE_FREE] += seconds_since(start);
+    }
+    header_cache_clear();
+    return 0;
+}
+
+/// Read throughputs of the phases from the baseline file, lines of `<phase> <MB/s>'.
+///
+/// \param name Name of the file
+/// \param rates Receives throughputs, 0 for phases not found
+/// \return `true' - OK, `false' - the file cannot be opened
+static _Bool read_baseline(const char *name, double rates[PHASES_NUMBER])
+{
+    FILE *file = fopen(name, "r");
+    if (!file) return false;
+    for (int i = 0; i < PHASES_NUMBER; ++i) rates[i] = 0;
+    char phase[32];
+    double rate;
+    while (fscanf(file, "%31s %lf", phase, &rate) == 2)
+    {
+        for (int i = 0; i < PHASES_NUMBER; ++i)
+        {
+            if (str_eq(phase, (char *) phase_names[i])) rates[i] = rate;
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+/// Write throughputs of the phases into the baseline file.
+///
+/// \param name Name of the file
+/// \param rates Throughputs of the phases
+/// \return `true' - OK, `false' - the file cannot be written
+static _Bool write_baseline(const char *name, const double rates[PHASES_NUMBER])
+{
+    FILE *file = fopen(name, "w");
+    if (!file)
+    {
+        fprintf(stderr, "Cannot open for writing: %s\n", name);
+        return false;
+    }
+    for (int i = 0; i < PHASES_NUMBER; ++i) fprintf(file, "%s %.3f\n", phase_names[i], rates[i]);
+    if (fclose(file) == EOF)
+    {
+        fprintf(stderr, "Cannot close opened target file: %s\n", name);
+        return false;
+    }
+    return true;
+}
+
+/// Benchmark the given sources.
+///
+/// \param argc Size of `argv'
+/// \param argv Arguments passed to the program
+/// \return 0 - OK, 1 - slower than the baseline, 2 - args error, 3 - I/O error, 4 - parse error
+int main(int argc, char *argv[])
+{
+    int runs = 5;
+    double tolerance = 5;
+    const char *baseline = NULL;
+    _Bool save_baseline = false;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] == '-'; ++arg)
+    {
+        if (strncmp(argv[arg], "--runs=", 7) == 0)
+        {
+            runs = atoi(argv[arg] + 7);
+            if (runs < 1 || runs > MAX_RUNS)
+            {
+                fprintf(stderr, "Wrong number of runs: %s\n", argv[arg] + 7);
+                return 2;
+            }
+        }
+        else if (strncmp(argv[arg], "--tolerance=", 12) == 0)
+        {
+            tolerance = atof(argv[arg] + 12);
+        }
+        else if (strncmp(argv[arg], "--baseline=", 11) == 0)
+        {
+            baseline = argv[arg] + 11;
+        }
+        else if (str_eq(argv[arg], "--save-baseline"))
+        {
+            save_baseline = true;
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option: %s\n", argv[arg]);
+            return 2;
+        }
+    }
+    if (arg == argc)
+    {
+        printf("Usage: %s [options] <in_file | @list_file | ->...\n"
+               "Options:\n"
+               "  --runs=N           number of runs, the median one is reported (default: 5)\n"
+               "  --baseline=FILE    compare against throughputs in the file, it is created if missing\n"
+               "  --save-baseline    overwrite the baseline file with results of this run\n"
+               "  --tolerance=P      percent of throughput below the baseline still accepted (default: 5)\n",
+               argv[0]);
+        return 2;
+    }
+
+    BATCH_LIST list;
+    batch_list_init(&list);
+    for (; arg < argc; ++arg)
+    {
+        if (batch_list_add(&list, argv[arg]) != 0)
+        {
+            batch_list_free(&list);
+            return 3;
+        }
+    }
+    long long bytes = 0;
+    for (size_t i = 0; i < list.number; ++i) bytes += list.files[i].size;
+
+    double times[PHASES_NUMBER][MAX_RUNS];
+    size_t tokens = 0;
+    for (int run = 0; run < runs; ++run)
+    {
+        double run_times[PHASES_NUMBER];
+        int res = run_once(&list, run_times, &tokens);
+        if (res)
+        {
+            batch_list_free(&list);
+            return res;
+        }
+        for (int i = 0; i < PHASES_NUMBER; ++i) times[i][run] = run_times[i];
+    }
+    size_t files = list.number;
+    batch_list_free(&list);
+
+    double rates[PHASES_NUMBER], base_rates[PHASES_NUMBER];
+    _Bool compare = baseline && read_baseline(baseline, base_rates);
+    _Bool slower = false;
+    double total = 0;
+    printf("Files: %zu, %.2f MB (without includes), %zu tokens, runs: %d\n",
+           files, bytes / 1e6, tokens, runs);
+    printf("%-10s %12s %10s", "phase", "median, s", "MB/s");
+    if (compare) printf(" %12s %8s", "baseline", "change");
+    printf("\n");
+    for (int i = 0; i < PHASES_NUMBER; ++i)
+    {
+        qsort(times[i], (size_t) runs, sizeof(double), &by_time);
+        double median = times[i][runs / 2];
+        if (i != PHASE_LEX) total += median;  // `lex+parse' includes it
+        rates[i] = median > 0 ? bytes / median / 1e6 : 0;
+        printf("%-10s %12.4f %10.2f", phase_names[i], median, rates[i]);
+        if (compare && base_rates[i] > 0 && rates[i] > 0)
+        {
+            double change = (rates[i] / base_rates[i] - 1) * 100;
+            _Bool regressed = change < -tolerance;
+            slower |= regressed;
+            printf(" %12.2f %+7.1f%%%s", base_rates[i], change, regressed ? "  SLOWER" : "");
+        }
+        printf("\n");
+    }
+    printf("%-10s %12.4f %10.2f\n", "total", total, total > 0 ? bytes / total / 1e6 : 0);
+    long rss = stats_peak_rss_kb();
+    if (rss) printf("Peak RSS: %ld KB\n", rss);
+
+    if (baseline && (save_baseline || !compare))
+    {
+        if (!write_baseline(baseline, rates)) return 3;
+        printf("Baseline saved: %s\n", baseline);
+    }
+    return slower ? 1 : 0;
+}
@@ -0,0 +1,186 @@
+/**
+ * State of one parse of the C Programming Language (ISO/IEC 9899:2018)
+ * source, shared by the lexer and the parser.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "alloc_wrap.h"
+#include "header_cache.h"
+#include "intern.h"
+#include "parse_context.h"
+#include "source_map.h"
+#include "typedef_name.h"
+#include "y.tab.h"
+
+// Defined in `lex.yy.c'
+extern int yylex_init_extra(PARSE_CONTEXT *extra, void **scanner);
+extern void yyset_in(FILE *in, void *scanner);
+extern FILE *yyget_in(void *scanner);
+extern int yylex_destroy(void *scanner);
+extern struct yy_buffer_state *yy_scan_buffer(char *base, size_t size, void *scanner);
+extern void yy_delete_buffer(struct yy_buffer_state *buffer, void *scanner);
+extern int yylex(YYSTYPE *lvalp, void *scanner);
+
+void parse_context_init(PARSE_CONTEXT *ctx)
+{
+    ctx->scanner = NULL;
+    ctx->file_name = NULL;
+    ctx->root = NULL;
+    ctx->error_found = false;
+    ctx->io_failed = false;
+    init_intern_pool(&ctx->strings);
+    init_typedef_name(&ctx->typedefs, &ctx->strings);
+    arena_init(&ctx->arena);
+    ctx->flat = NULL;
+    ctx->stream = NULL;
+    ctx->source = (SOURCE_MAP) {NULL, 0, 0, NULL, 0};
+    ctx->prefilter = false;
+    ctx->typed_constants = false;
+    ctx->source_kept = false;
+    ctx->include_depth = 0;
+    header_log_init(&ctx->header_log);
+    ctx->replay = NULL;
+    ctx->replay_pos = 0;
+    ctx->stats = NULL;
+    ctx->deps = NULL;
+    ctx->messages = NULL;
+}
+
+/// Create the scanner of the context.
+///
+/// \param ctx Initialized context
+static void scanner_create(PARSE_CONTEXT *ctx)
+{
+    if (yylex_init_extra(ctx, &ctx->scanner)) alloc_fail("lexer");
+}
+
+/// Create the scanner of the context reading the given source.
+///
+/// \param ctx Initialized context
+/// \param in Opened source file
+static void scan_begin(PARSE_CONTEXT *ctx, FILE *in)
+{
+    scanner_create(ctx);
+    yyset_in(in, ctx->scanner);
+    if (in != stdin && source_map(&ctx->source, in))
+    {
+        if (ctx->prefilter) source_prefilter(&ctx->source);
+        yy_scan_buffer(ctx->source.data, ctx->source.size + SOURCE_MAP_SENTINELS, ctx->scanner);
+        ctx->source_kept = true;
+    }
+}
+
+/// Close everything left opened by the scanner and destroy it.
+///
+/// \param ctx Context whose scanner is done
+static void scan_end(PARSE_CONTEXT *ctx)
+{
+    // Sources left opened when parsing stopped inside of an included one
+    FILE *current = yyget_in(ctx->scanner);
+    while (ctx->include_depth > 0)
+    {
+        INCLUDE_SOURCE *suspended = &ctx->include_stack[--ctx->include_depth];
+        fclose(current);
+        source_unmap(&ctx->source);
+        yy_delete_buffer(suspended->buffer, ctx->scanner);
+        header_key_free(&suspended->key);
+        current = suspended->file;
+        ctx->source = suspended->map;
+    }
+    if (ctx->replay) header_cache_release(ctx->replay);
+    ctx->replay = NULL;
+    header_log_clear(&ctx->header_log);
+    yylex_destroy(ctx->scanner);
+    ctx->scanner = NULL;
+    // The mapping of the main source is kept: constants of the AST point into it
+    ctx->file_name = NULL;
+}
+
+int parse_file(PARSE_CONTEXT *ctx, FILE *in)
+{
+    scan_begin(ctx, in);
+    int res = yyparse(ctx->scanner, ctx);
+    scan_end(ctx);
+    return res;
+}
+
+int parse_buffer(PARSE_CONTEXT *ctx, char *data, size_t size)
+{
+    if (ctx->prefilter)
+    {
+        // Filtered like a mapped file, the shifts are not needed
+        SOURCE_MAP text = {data, size, 0, NULL, 0};
+        source_prefilter(&text);
+        my_free(text.shifts);
+        size = text.size;
+    }
+    scanner_create(ctx);
+    yy_scan_buffer(data, size + SOURCE_MAP_SENTINELS, ctx->scanner);
+    ctx->source_kept = true;
+    int res = yyparse(ctx->scanner, ctx);
+    scan_end(ctx);
+    return res;
+}
+
+size_t scan_file(PARSE_CONTEXT *ctx, FILE *in)
+{
+    scan_begin(ctx, in);
+    YYSTYPE value;
+    size_t res = 0;
+    while (yylex(&value, ctx->scanner) != 0) ++res;
+    scan_end(ctx);
+    return res;
+}
+
+void parse_abort(PARSE_CONTEXT *ctx)
+{
+    if (ctx->scanner) scan_end(ctx);
+}
+
+void parse_message(PARSE_CONTEXT *ctx, const char *prefix, const char *str)
+{
+    if (!ctx->messages)
+    {
+        if (prefix) fprintf(stderr, "%s: %s\n", prefix, str);
+        else fprintf(stderr, "%s\n", str);
+        return;
+    }
+    if (prefix)
+    {
+        writer_puts(ctx->messages, prefix);
+        writer_put(ctx->messages, ": ", 2);
+    }
+    writer_puts(ctx->messages, str);
+    writer_putc(ctx->messages, '\n');
+}
+
+void parse_context_reset(PARSE_CONTEXT *ctx)
+{
+    free_typedef_name(&ctx->typedefs);
+    free_intern_pool(&ctx->strings);
+    init_intern_pool(&ctx->strings);
+    init_typedef_name(&ctx->typedefs, &ctx->strings);
+    arena_reset(&ctx->arena);
+    source_unmap(&ctx->source);
+    ctx->source_kept = false;
+    ctx->root = NULL;
+    ctx->error_found = false;
+    ctx->io_failed = false;
+    ctx->flat = NULL;
+    ctx->stream = NULL;
+}
+
+void parse_context_free(PARSE_CONTEXT *ctx)
+{
+    free_typedef_name(&ctx->typedefs);
+    free_intern_pool(&ctx->strings);
+    arena_free(&ctx->arena);
+    header_log_free(&ctx->header_log);
+    source_unmap(&ctx->source);
+    ctx->source_kept = false;
+    ctx->root = NULL;
+}
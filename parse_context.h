@@ -0,0 +1,157 @@
+/**
+ * State of one parse of the C Programming Language (ISO/IEC 9899:2018)
+ * source, shared by the lexer and the parser.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#ifndef C_PARSER_PARSE_CONTEXT_H_INCLUDED
+#define C_PARSER_PARSE_CONTEXT_H_INCLUDED
+
+#include <stdio.h>
+#include "alloc_wrap.h"
+#include "ast.h"
+#include "header_cache.h"
+#include "intern.h"
+#include "result_cache.h"
+#include "source_map.h"
+#include "stats.h"
+#include "typedef_name.h"
+#include "writer.h"
+
+// ISO/IEC 9899:2017, 5.2.4.1 Translation limits, page 20
+/// Maximum depth of the `#include' directive.
+#define MAX_INCLUDE_DEPTH 15
+
+// Defined by Flex
+struct yy_buffer_state;
+
+/// Source the lexer returns to when the included one is over.
+typedef struct
+{
+    FILE *file;
+    struct yy_buffer_state *buffer;
+    int start_cond;
+    SOURCE_MAP map;
+    /// Key to cache the included source by, `path' is NULL if it is not cached
+    HEADER_KEY key;
+    /// Where tokens of the included source start in `header_log'
+    size_t log_start;
+    size_t text_start;
+    size_t includes_start;
+}
+INCLUDE_SOURCE;
+
+/// Everything one parse works with. Contexts are independent,
+/// so several translation units may be parsed at once on different threads.
+/// NOTE: The context refers to its own fields, it must not be moved after `parse_context_init'.
+typedef struct PARSE_CONTEXT
+{
+    /// Flex scanner, valid during `parse_file'
+    void *scanner;
+    /// Name of the source to prefix messages with, or NULL
+    const char *file_name;
+    /// Root of the parsed translation unit (unless `flat' is used)
+    AST_NODE *root;
+    /// Was error already found?
+    _Bool error_found;
+    /// Was it an input error (like a missing included file)?
+    _Bool io_failed;
+    /// Interned identifiers
+    INTERN_POOL strings;
+    /// typedef-names known at the current point
+    TYPEDEF_TABLE typedefs;
+    /// Arena owning all the AST nodes and token strings
+    ARENA arena;
+    /// Flat AST receiving completed top-level declarations, NULL if not used
+    AST_FLAT *flat;
+    /// Stream receiving completed top-level declarations (unless `flat' is used), NULL if not used
+    AST_STREAM *stream;
+    /// Mapping of the source being read, `data' is NULL if it is read through `stdio'.
+    /// The mapping of the main source is kept after parsing, until the context is reset or freed
+    SOURCE_MAP source;
+    /// Is the main source scanned in place and kept until the context is reset or freed?
+    /// Then constants scanned from it point into its text (see `AST_NODE.length') instead of copies
+    _Bool source_kept;
+    /// Are mapped sources passed through `source_prefilter' before scanning?
+    _Bool prefilter;
+    /// Are integer and floating constants converted into their values while scanning
+    /// (see `ast_create_value_node')? Set only if the values are written, others convert them when needed
+    _Bool typed_constants;
+    /// Stack of sources suspended by `#include'
+    INCLUDE_SOURCE include_stack[MAX_INCLUDE_DEPTH];
+    /// Size of `include_stack'
+    int include_depth;
+    /// Tokens given to the parser from included sources, to be cached when each of them is over
+    HEADER_LOG header_log;
+    /// Cached header being replayed instead of scanning, or NULL
+    HEADER_CACHE_ENTRY *replay;
+    /// Index of the next token of `replay'
+    size_t replay_pos;
+    /// Measurements of the lexer (tokens, scanning time, include depth), NULL if not measured
+    PARSE_STATS *stats;
+    /// Files included, for `result_cache', NULL if not needed
+    RESULT_DEPS *deps;
+    /// Writer receiving error and warning messages one per line, NULL - they go into `stderr'
+    WRITER *messages;
+}
+PARSE_CONTEXT;
+
+/// Initialize a context for a new parse.
+///
+/// \param ctx Context to initialize
+void parse_context_init(PARSE_CONTEXT *ctx);
+
+/// Parse the given source into the context: its AST is put into `root'
+/// (or `flat', or written into `stream'), owned by the context's arena. Regular files are scanned
+/// in place through `source_map', others (like `stdin') are read through `stdio'.
+/// Included files unchanged since they were scanned last are replayed from `header_cache'.
+///
+/// \param ctx Initialized context
+/// \param in Opened source file
+/// \return 0 - OK, otherwise - parsing failed
+int parse_file(PARSE_CONTEXT *ctx, FILE *in);
+
+/// Parse the source held in memory the way `parse_file' does.
+///
+/// \param ctx Initialized context
+/// \param data Text of the source followed by `SOURCE_MAP_SENTINELS' zero bytes, changed by the scanner.
+///             The AST points into it, so it must be kept until the context is reset or freed
+/// \param size Size of the text
+/// \return 0 - OK, otherwise - parsing failed
+int parse_buffer(PARSE_CONTEXT *ctx, char *data, size_t size);
+
+/// Only scan the given source into tokens the way `parse_file' does, without parsing them.
+/// Used to measure the lexer alone: typedef-names are not declared, so they come as identifiers.
+///
+/// \param ctx Initialized context
+/// \param in Opened source file
+/// \return Number of tokens
+size_t scan_file(PARSE_CONTEXT *ctx, FILE *in);
+
+/// Stop the parse left by a jump out of it (see `alloc_failure_catch'): close included
+/// sources and destroy the scanner. The context may only be freed afterwards.
+///
+/// \param ctx Context whose parse was stopped
+void parse_abort(PARSE_CONTEXT *ctx);
+
+/// Report an error or a warning of the parse.
+///
+/// \param ctx Context of the parse
+/// \param prefix What to put before the message and a colon, NULL if nothing
+/// \param str Message
+void parse_message(PARSE_CONTEXT *ctx, const char *prefix, const char *str);
+
+/// Make the context ready for a new parse, dropping the AST built (and unmapping its source) but keeping
+/// a block of its arena and other memory, cheaper than freeing and initializing it again.
+/// Options of the parse (`prefilter', `stats', `deps') are kept.
+///
+/// \param ctx Context to reset
+void parse_context_reset(PARSE_CONTEXT *ctx);
+
+/// Free memory associated with the context, including the AST built.
+///
+/// \param ctx Context to free
+void parse_context_free(PARSE_CONTEXT *ctx);
+
+#endif //C_PARSER_PARSE_CONTEXT_H_INCLUDED
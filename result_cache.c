@@ -0,0 +1,462 @@
+/**
+ * On-disk cache of conversion results keyed by the content of the source,
+ * so unchanged sources are not parsed again by later runs.
+ *
+ * An entry is two files named by the key: `<key>.out' with the output
+ * and `<key>.deps' with the hashes of the files the source included.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <utime.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+#include "alloc_wrap.h"
+#include "result_cache.h"
+#include "source_map.h"
+
+/// First line of `.deps' files.
+#define DEPS_HEADER "c-to-json result cache"
+
+/// Longest name of an included file kept in `.deps' files.
+#define DEPS_MAX_NAME 4096
+
+/// Part of the size bound the cache is shrunk to by eviction, percents,
+/// so that it is not done again by the next store.
+#define EVICTION_TARGET 90
+
+/// Guards everything below.
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/// Size of the entries of the cache directory as this process knows it, -1 if not known yet.
+static long long known_size = -1;
+
+/// Number of temporary files made by this process, for their names.
+static size_t temp_number = 0;
+
+/// Numbers of `result_cache_fetch' calls which gave the result and which did not, entries evicted.
+static size_t hit_number = 0, miss_number = 0, eviction_number = 0;
+
+void result_deps_init(RESULT_DEPS *deps)
+{
+    *deps = (RESULT_DEPS) {NULL, 0, 0};
+}
+
+void result_deps_add(RESULT_DEPS *deps, const char *name)
+{
+    for (size_t i = 0; i < deps->number; ++i)
+    {
+        if (strcmp(deps->names[i], name) == 0) return;
+    }
+    if (deps->number == deps->capacity)
+    {
+        deps->capacity = deps->capacity ? deps->capacity * 2 : 8;
+        deps->names = (char **) my_realloc(deps->names, deps->capacity * sizeof(char *), "included files");
+    }
+    char *copy = (char *) my_malloc(strlen(name) + 1, "included file name");
+    strcpy(copy, name);
+    deps->names[deps->number++] = copy;
+}
+
+void result_deps_free(RESULT_DEPS *deps)
+{
+    for (size_t i = 0; i < deps->number; ++i) my_free(deps->names[i]);
+    my_free(deps->names);
+    result_deps_init(deps);
+}
+
+/// Rotate the bits left.
+///
+/// \param x Value to rotate
+/// \param r Number of bits, 1..63
+/// \return Rotated value
+static uint64_t rotl(uint64_t x, int r)
+{
+    return x << r | x >> (64 - r);
+}
+
+/// Mix one word into the hash.
+///
+/// \param hash Hash so far
+/// \param word Next 8 bytes
+/// \return New hash
+static uint64_t hash_word(uint64_t hash, uint64_t word)
+{
+    return rotl(hash ^ word * 0x87C37B91114253D5u, 31) * 0x4CF5AD432745937Fu;
+}
+
+uint64_t result_cache_hash(const void *data, size_t size, uint64_t seed)
+{
+    const unsigned char *p = (const unsigned char *) data;
+    uint64_t hash = seed ^ size * 0x9E3779B97F4A7C15u;
+    uint64_t word;
+    for (; size >= 8; p += 8, size -= 8)
+    {
+        memcpy(&word, p, 8);
+        hash = hash_word(hash, word);
+    }
+    word = 0;
+    memcpy(&word, p, size);
+    hash = hash_word(hash, word);
+    // Final mixing of MurmurHash3, every bit of the input changes every bit of the hash
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDu;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53u;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/// Hash the content of a file.
+///
+/// \param name Name of the file
+/// \param seed Seed of the hash
+/// \param hash Receives the hash
+/// \return `true' - OK, `false' - the file cannot be read
+static _Bool hash_file(const char *name, uint64_t seed, uint64_t *hash)
+{
+    FILE *file = fopen(name, "rb");
+    if (!file) return false;
+    _Bool res = true;
+    SOURCE_MAP map;
+    if (source_map(&map, file))
+    {
+        *hash = result_cache_hash(map.data, map.size, seed);
+        source_unmap(&map);
+    }
+    else
+    {
+        // Not a regular file, or no `mmap': read it whole
+        size_t capacity = 65536, size = 0, read;
+        char *data = (char *) my_malloc(capacity, "hashed file");
+        while ((read = fread(data + size, 1, capacity - size, file)) > 0)
+        {
+            size += read;
+            if (size == capacity)
+            {
+                capacity *= 2;
+                data = (char *) my_realloc(data, capacity, "hashed file");
+            }
+        }
+        res = !ferror(file);
+        *hash = result_cache_hash(data, size, seed);
+        my_free(data);
+    }
+    fclose(file);
+    return res;
+}
+
+_Bool result_cache_key(const char *in_name, unsigned format, uint64_t *key)
+{
+    return hash_file(in_name, (uint64_t) RESULT_CACHE_VERSION << 32 | format, key);
+}
+
+/// Name of a file of the entry. NOTE: Needs to be freed.
+///
+/// \param cache Cache holding the entry
+/// \param key Key of the entry
+/// \param suffix Suffix of the file
+/// \return Path of the file
+static char *entry_path(const RESULT_CACHE *cache, uint64_t key, const char *suffix)
+{
+    size_t size = strlen(cache->dir) + strlen(suffix) + 18;
+    char *res = (char *) my_malloc(size, "cache entry path");
+    snprintf(res, size, "%s/%016llx%s", cache->dir, (unsigned long long) key, suffix);
+    return res;
+}
+
+/// Name of a new temporary file in the cache, unique among processes and threads. NOTE: Needs to be freed.
+///
+/// \param cache Cache to put the file into
+/// \param key Key of the entry the file is for
+/// \return Path of the file
+static char *temp_path(const RESULT_CACHE *cache, uint64_t key)
+{
+    pthread_mutex_lock(&cache_lock);
+    size_t number = temp_number++;
+    pthread_mutex_unlock(&cache_lock);
+    char suffix[48];
+#ifdef _WIN32
+    snprintf(suffix, sizeof(suffix), ".%d-%zu.tmp", _getpid(), number);
+#else
+    snprintf(suffix, sizeof(suffix), ".%ld-%zu.tmp", (long) getpid(), number);
+#endif
+    return entry_path(cache, key, suffix);
+}
+
+/// Copy the file.
+///
+/// \param from Name of the file to copy
+/// \param to Name of the copy, replaced
+/// \return `true' - OK, `false' - I/O error, the copy is removed
+static _Bool copy_file(const char *from, const char *to)
+{
+    FILE *in = fopen(from, "rb");
+    if (!in) return false;
+    FILE *out = fopen(to, "wb");
+    if (!out)
+    {
+        fclose(in);
+        return false;
+    }
+    char buf[65536];
+    size_t read;
+    _Bool res = true;
+    while (res && (read = fread(buf, 1, sizeof(buf), in)) > 0)
+    {
+        res = fwrite(buf, 1, read, out) == read;
+    }
+    res = res && !ferror(in);
+    fclose(in);
+    if (fclose(out) == EOF || !res)
+    {
+        remove(to);
+        return false;
+    }
+    return true;
+}
+
+/// Make `to' the same file as `from': a hard link if asked for and possible, a copy otherwise.
+///
+/// \param from Name of the existing file
+/// \param to Name to give, replaced
+/// \param link_it Try a hard link first
+/// \return `true' - OK, `false' - I/O error
+static _Bool give_file(const char *from, const char *to, _Bool link_it)
+{
+    remove(to);  // It may be a hard link to an entry itself, not to be written through
+#ifndef _WIN32
+    if (link_it && link(from, to) == 0) return true;
+#else
+    (void) link_it;
+#endif
+    return copy_file(from, to);
+}
+
+/// Put the temporary file in place of the target, at once.
+///
+/// \param temp Name of the complete temporary file
+/// \param target Name to give it, replaced
+/// \return `true' - OK, `false' - it cannot be renamed, it is removed
+static _Bool commit_file(const char *temp, const char *target)
+{
+#ifdef _WIN32
+    remove(target);  // `rename' does not replace files there
+#endif
+    if (rename(temp, target) == 0) return true;
+    remove(temp);
+    return false;
+}
+
+/// Do the files listed in `.deps' still have the same content?
+///
+/// \param deps_path Name of the `.deps' file
+/// \return `true' - all of them are the same, `false' - some changed, or there is no such entry
+static _Bool deps_valid(const char *deps_path)
+{
+    FILE *file = fopen(deps_path, "r");
+    if (!file) return false;
+    char line[DEPS_MAX_NAME + 32];
+    int version = 0;
+    _Bool res = fgets(line, sizeof(line), file)
+        && sscanf(line, DEPS_HEADER " %d", &version) == 1 && version == RESULT_CACHE_VERSION;
+    while (res && fgets(line, sizeof(line), file))
+    {
+        unsigned long long stored;
+        int name_start = 0;
+        size_t len = strlen(line);
+        if (len == 0 || line[len - 1] != '\n' || sscanf(line, "%16llx %n", &stored, &name_start) != 1
+            || name_start == 0)
+        {
+            res = false;
+            break;
+        }
+        line[len - 1] = '\0';
+        uint64_t hash;
+        res = hash_file(line + name_start, 0, &hash) && hash == stored;
+    }
+    res = res && !ferror(file);
+    fclose(file);
+    return res;
+}
+
+_Bool result_cache_fetch(const RESULT_CACHE *cache, uint64_t key, const char *out_name)
+{
+    char *deps_path = entry_path(cache, key, ".deps");
+    char *out_path = entry_path(cache, key, ".out");
+    _Bool hit = deps_valid(deps_path) && give_file(out_path, out_name, cache->link);
+    if (hit) utime(out_path, NULL);  // Recently used, evicted last
+    my_free(deps_path);
+    my_free(out_path);
+
+    pthread_mutex_lock(&cache_lock);
+    if (hit) ++hit_number;
+    else ++miss_number;
+    pthread_mutex_unlock(&cache_lock);
+    return hit;
+}
+
+/// Write the `.deps' file of an entry.
+///
+/// \param name Name of the file
+/// \param deps Files included by the conversion
+/// \return `true' - OK, `false' - a file cannot be read or the list cannot be written
+static _Bool write_deps(const char *name, const RESULT_DEPS *deps)
+{
+    FILE *file = fopen(name, "w");
+    if (!file) return false;
+    _Bool res = fprintf(file, DEPS_HEADER " %d\n", RESULT_CACHE_VERSION) > 0;
+    for (size_t i = 0; res && i < deps->number; ++i)
+    {
+        uint64_t hash;
+        res = strlen(deps->names[i]) <= DEPS_MAX_NAME && !strchr(deps->names[i], '\n')
+            && hash_file(deps->names[i], 0, &hash)
+            && fprintf(file, "%016llx %s\n", (unsigned long long) hash, deps->names[i]) > 0;
+    }
+    if (fclose(file) == EOF) res = false;
+    return res;
+}
+
+/// Size of a file.
+///
+/// \param name Name of the file
+/// \param mtime If not NULL, receives the modification time of the file
+/// \return Size in bytes, 0 if there is no such file
+static long long file_size(const char *name, long long *mtime)
+{
+    struct stat info;
+    if (stat(name, &info) != 0) return 0;
+    if (mtime) *mtime = (long long) info.st_mtime;
+    return (long long) info.st_size;
+}
+
+/// Entry found in the cache directory by `evict'.
+typedef struct
+{
+    char *out_path;
+    long long mtime;
+    long long size;
+}
+CACHE_ENTRY_INFO;
+
+/// Compare entries for `qsort': least recently used first.
+static int by_mtime(const void *a, const void *b)
+{
+    long long ta = ((const CACHE_ENTRY_INFO *) a)->mtime, tb = ((const CACHE_ENTRY_INFO *) b)->mtime;
+    return ta < tb ? -1 : ta > tb;
+}
+
+/// Remove the least recently used entries until the cache is below `EVICTION_TARGET' percents
+/// of its bound. NOTE: `cache_lock' must be held.
+///
+/// \param cache Cache to shrink
+/// \return Size of the entries left
+static long long evict(const RESULT_CACHE *cache)
+{
+    DIR *dir = opendir(cache->dir);
+    if (!dir) return 0;
+    CACHE_ENTRY_INFO *entries = NULL;
+    size_t number = 0, capacity = 0;
+    long long total = 0;
+    size_t dir_len = strlen(cache->dir);
+    struct dirent *item;
+    while ((item = readdir(dir)))
+    {
+        size_t len = strlen(item->d_name);
+        if (len != 20 || strcmp(item->d_name + 16, ".out") != 0) continue;
+        if (number == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            entries = (CACHE_ENTRY_INFO *) my_realloc(entries, capacity * sizeof(CACHE_ENTRY_INFO), "cache entries");
+        }
+        CACHE_ENTRY_INFO *entry = &entries[number++];
+        entry->out_path = (char *) my_malloc(dir_len + 27, "cache entry path");
+        sprintf(entry->out_path, "%s/%s", cache->dir, item->d_name);
+        entry->mtime = 0;
+        entry->size = file_size(entry->out_path, &entry->mtime);
+        strcpy(entry->out_path + dir_len + 18, "deps");
+        entry->size += file_size(entry->out_path, NULL);
+        strcpy(entry->out_path + dir_len + 18, "out");
+        total += entry->size;
+    }
+    closedir(dir);
+
+    qsort(entries, number, sizeof(CACHE_ENTRY_INFO), &by_mtime);
+    long long target = cache->max_size / 100 * EVICTION_TARGET;
+    for (size_t i = 0; i < number; ++i)
+    {
+        if (total > target)
+        {
+            // Without `.deps' the entry is not valid any more, it goes first
+            strcpy(entries[i].out_path + dir_len + 18, "deps");
+            remove(entries[i].out_path);
+            strcpy(entries[i].out_path + dir_len + 18, "out");
+            remove(entries[i].out_path);
+            total -= entries[i].size;
+            ++eviction_number;
+        }
+        my_free(entries[i].out_path);
+    }
+    my_free(entries);
+    return total;
+}
+
+/// Count the stored entry into the size of the cache and shrink it if needed.
+///
+/// \param cache Cache the entry is stored into
+/// \param added Size of the entry
+static void account_store(const RESULT_CACHE *cache, long long added)
+{
+    pthread_mutex_lock(&cache_lock);
+    // The directory is looked through once per process, then stores are counted
+    if (known_size < 0) known_size = evict(cache);
+    else known_size += added;
+    if (known_size > cache->max_size) known_size = evict(cache);
+    pthread_mutex_unlock(&cache_lock);
+}
+
+void result_cache_store(const RESULT_CACHE *cache, uint64_t key, const char *out_name, const RESULT_DEPS *deps)
+{
+#ifdef _WIN32
+    _mkdir(cache->dir);
+#else
+    mkdir(cache->dir, 0777);  // Fails if it exists already
+#endif
+    char *out_path = entry_path(cache, key, ".out");
+    char *deps_path = entry_path(cache, key, ".deps");
+    char *temp = temp_path(cache, key);
+    // The output goes first: an entry is valid once its `.deps' is in place.
+    // It is always a copy: a hard link would let the entry change with the target
+    _Bool stored = copy_file(out_name, temp) && commit_file(temp, out_path);
+    if (stored)
+    {
+        stored = write_deps(temp, deps) && commit_file(temp, deps_path);
+        if (!stored) remove(temp);
+    }
+    if (stored) account_store(cache, file_size(out_path, NULL) + file_size(deps_path, NULL));
+    my_free(out_path);
+    my_free(deps_path);
+    my_free(temp);
+}
+
+void result_cache_stats(size_t *hits, size_t *misses, size_t *evictions)
+{
+    pthread_mutex_lock(&cache_lock);
+    if (hits) *hits = hit_number;
+    if (misses) *misses = miss_number;
+    if (evictions) *evictions = eviction_number;
+    pthread_mutex_unlock(&cache_lock);
+}
@@ -0,0 +1,102 @@
+/**
+ * On-disk cache of conversion results keyed by the content of the source,
+ * so unchanged sources are not parsed again by later runs.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#ifndef C_PARSER_RESULT_CACHE_H_INCLUDED
+#define C_PARSER_RESULT_CACHE_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Version of the output, part of every key: to be increased whenever
+/// the same source starts being converted into different bytes.
+#define RESULT_CACHE_VERSION 2
+
+/// Default upper bound of the size of the cache directory, MB.
+#define RESULT_CACHE_DEFAULT_SIZE 1024
+
+/// Cache directory and how it is used.
+typedef struct
+{
+    /// Directory holding the entries, created if missing
+    const char *dir;
+    /// Upper bound of the size of the entries, bytes: the least recently used ones are removed beyond it
+    long long max_size;
+    /// Give hits as hard links to the entries instead of copies
+    _Bool link;
+}
+RESULT_CACHE;
+
+/// Files read by a conversion through `#include', in the order they were included.
+typedef struct
+{
+    char **names;
+    size_t number;
+    size_t capacity;
+}
+RESULT_DEPS;
+
+/// Initialize an empty list of files.
+///
+/// \param deps List to initialize
+void result_deps_init(RESULT_DEPS *deps);
+
+/// Append a file unless it is in the list already.
+///
+/// \param deps List to append to
+/// \param name Name the file is opened by, copied
+void result_deps_add(RESULT_DEPS *deps, const char *name);
+
+/// Free memory of the list.
+///
+/// \param deps List to free
+void result_deps_free(RESULT_DEPS *deps);
+
+/// Hash of bytes (64-bit, a word at a time), fast and not cryptographic.
+///
+/// \param data Bytes to hash
+/// \param size Number of bytes
+/// \param seed Initial value, different seeds give unrelated hashes
+/// \return Hash value
+uint64_t result_cache_hash(const void *data, size_t size, uint64_t seed);
+
+/// Get the key of a conversion: the hash of the source's content, `RESULT_CACHE_VERSION'
+/// and the output format. Included files are checked by `result_cache_fetch'.
+///
+/// \param in_name Name of the source file
+/// \param format Number telling different kinds of output of the same source apart
+/// \param key Receives the key
+/// \return `true' - OK, `false' - the source cannot be read
+_Bool result_cache_key(const char *in_name, unsigned format, uint64_t *key);
+
+/// Give the stored result of the conversion if every file it included still has the same content.
+/// The target is replaced by a copy (or a hard link) of the stored output.
+///
+/// \param cache Cache to look into
+/// \param key Key of the conversion
+/// \param out_name Name of the target file
+/// \return `true' - hit, the target is written, `false' - miss
+_Bool result_cache_fetch(const RESULT_CACHE *cache, uint64_t key, const char *out_name);
+
+/// Store the result of a successful conversion. Files of the entry are written under temporary
+/// names and renamed, so other processes never see them half-written. The output is always copied,
+/// so the entry does not change with the target (see `RESULT_CACHE.link'). The least recently used
+/// entries are removed when the cache grows beyond its size.
+///
+/// \param cache Cache to store into
+/// \param key Key of the conversion
+/// \param out_name Name of the target file written by the conversion
+/// \param deps Files included by the conversion
+void result_cache_store(const RESULT_CACHE *cache, uint64_t key, const char *out_name, const RESULT_DEPS *deps);
+
+/// Get numbers describing the use of caches by this process.
+///
+/// \param hits If not NULL, receives the number of results given from the cache
+/// \param misses If not NULL, receives the number of conversions not found in the cache
+/// \param evictions If not NULL, receives the number of entries removed to bound the size
+void result_cache_stats(size_t *hits, size_t *misses, size_t *evictions);
+
+#endif //C_PARSER_RESULT_CACHE_H_INCLUDED
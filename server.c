@@ -0,0 +1,469 @@
+/**
+ * Parse server: conversions requested over a Unix domain socket.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "server.h"
+
+#ifdef _WIN32
+
+int server_run(const char *path, int workers)
+{
+    (void) path;
+    (void) workers;
+    fprintf(stderr, "Unix domain sockets are not supported on this platform!\n");
+    return 3;
+}
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "alloc_wrap.h"
+#include "convert.h"
+#include "header_cache.h"
+#include "source_map.h"
+#include "writer.h"
+
+/// Set by SIGINT and SIGTERM.
+static volatile sig_atomic_t stop_requested = 0;
+
+/// Pipe waking the dispatcher up: written by the signal handler and by workers giving connections back.
+static int wake_pipe[2] = {-1, -1};
+
+/// Wake the dispatcher up to look at the connections again.
+static void wake_dispatcher()
+{
+    ssize_t res;
+    do res = write(wake_pipe[1], "", 1);
+    while (res < 0 && errno == EINTR);  // A full pipe wakes it up already
+}
+
+/// Stop serving, for SIGINT and SIGTERM.
+///
+/// \param signal Number of the signal
+static void stop_server(int signal)
+{
+    (void) signal;
+    int saved = errno;
+    stop_requested = 1;
+    wake_dispatcher();
+    errno = saved;
+}
+
+/// Read exactly `size' bytes from the connection. Each read waits for at most `SERVER_TIMEOUT'
+/// (see `SO_RCVTIMEO' of accepted connections), and all of them end by the deadline.
+///
+/// \param fd Connection
+/// \param data Buffer to read into
+/// \param size Number of bytes
+/// \param deadline Time the bytes are to be read by
+/// \return `true' - OK, `false' - the connection is closed, failed or timed out
+static _Bool read_all(int fd, void *data, size_t size, time_t deadline)
+{
+    char *to = (char *) data;
+    while (size > 0)
+    {
+        if (time(NULL) > deadline) return false;
+        ssize_t got = read(fd, to, size);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        to += got;
+        size -= (size_t) got;
+    }
+    return true;
+}
+
+/// Write exactly `size' bytes into the connection, by the deadline (see `read_all').
+///
+/// \param fd Connection
+/// \param data Bytes to write
+/// \param size Number of bytes
+/// \param deadline Time the bytes are to be written by
+/// \return `true' - OK, `false' - the connection is closed, failed or timed out
+static _Bool write_all(int fd, const void *data, size_t size, time_t deadline)
+{
+    const char *from = (const char *) data;
+    while (size > 0)
+    {
+        if (time(NULL) > deadline) return false;
+        ssize_t put = write(fd, from, size);
+        if (put < 0 && errno == EINTR) continue;
+        if (put <= 0) return false;
+        from += put;
+        size -= (size_t) put;
+    }
+    return true;
+}
+
+/// Read a number of the protocol.
+static _Bool read_u32(int fd, uint32_t *value, time_t deadline)
+{
+    unsigned char bytes[4];
+    if (!read_all(fd, bytes, 4, deadline)) return false;
+    *value = (uint32_t) bytes[0] << 24 | (uint32_t) bytes[1] << 16 | (uint32_t) bytes[2] << 8 | bytes[3];
+    return true;
+}
+
+/// Write a number of the protocol into the buffer.
+static void put_u32(unsigned char *bytes, uint32_t value)
+{
+    bytes[0] = (unsigned char) (value >> 24);
+    bytes[1] = (unsigned char) (value >> 16);
+    bytes[2] = (unsigned char) (value >> 8);
+    bytes[3] = (unsigned char) value;
+}
+
+/// Send a response: its status, output and messages, within `SERVER_TIMEOUT'.
+///
+/// \param fd Connection
+/// \param status Status of the response
+/// \param body Output, may be NULL if `size' is 0
+/// \param size Size of the output
+/// \param messages Error and warning messages, may be NULL if `messages_size' is 0
+/// \param messages_size Size of the messages
+/// \return `true' - OK, `false' - the connection is closed or failed
+static _Bool send_response(int fd, uint32_t status, const char *body, uint32_t size,
+                           const char *messages, uint32_t messages_size)
+{
+    unsigned char header[8], footer[4];
+    put_u32(header, status);
+    put_u32(header + 4, size);
+    put_u32(footer, messages_size);
+    time_t deadline = time(NULL) + SERVER_TIMEOUT;
+    return write_all(fd, header, 8, deadline) && write_all(fd, body, size, deadline)
+        && write_all(fd, footer, 4, deadline) && write_all(fd, messages, messages_size, deadline);
+}
+
+/// State kept by a worker between requests.
+typedef struct
+{
+    PARSE_CONTEXT ctx;
+    WRITER out;
+    /// Error and warning messages of the request being served
+    WRITER messages;
+    char *request;
+    size_t capacity;
+}
+SERVER_WORKER;
+
+/// Connections shared by the dispatcher and the workers.
+typedef struct
+{
+    int listen_fd;
+    /// Guards everything below
+    pthread_mutex_t lock;
+    /// Signalled when a connection is ready or the server stops
+    pthread_cond_t ready_cond;
+    /// Connections with a request coming, waiting for a worker, a ring of `SERVER_MAX_CONNECTIONS'
+    int *ready;
+    size_t ready_begin;
+    size_t ready_number;
+    /// Connections waiting for their next request, watched by the dispatcher
+    int *idle;
+    size_t idle_number;
+    /// Open connections, wherever they are
+    size_t connections;
+    _Bool stopped;
+}
+SERVER;
+
+/// Answer one request coming through the connection. The request has to arrive
+/// within `SERVER_TIMEOUT', so a stalled client does not hold the worker.
+///
+/// \param worker State of the worker
+/// \param fd Connection
+/// \return `true' - the connection may carry the next request, `false' - it is to be closed
+static _Bool serve_request(SERVER_WORKER *worker, int fd)
+{
+    time_t deadline = time(NULL) + SERVER_TIMEOUT;
+    uint32_t flags, size;
+    if (!read_u32(fd, &flags, deadline) || !read_u32(fd, &size, deadline)) return false;
+    if (size > SERVER_MAX_REQUEST || (flags & SERVER_NDJSON && flags & (SERVER_BINARY | SERVER_FLAT))
+        || (flags & SERVER_TYPED_CONSTANTS && flags & SERVER_BINARY))
+    {
+        // The rest of the request is not read, so the connection cannot go on
+        send_response(fd, SERVER_BAD_REQUEST, NULL, 0, NULL, 0);
+        return false;
+    }
+    if (size + SOURCE_MAP_SENTINELS > worker->capacity)
+    {
+        ALLOC_FAILURE failure;
+        ALLOC_FAILURE *outer = alloc_failure_catch(&failure);
+        if (setjmp(failure.jump))
+        {
+            alloc_failure_catch(outer);
+            send_response(fd, CONVERT_NO_MEMORY, NULL, 0, NULL, 0);
+            return false;
+        }
+        my_free(worker->request);
+        worker->request = NULL;
+        worker->capacity = 0;
+        worker->request = (char *) my_malloc(size + SOURCE_MAP_SENTINELS, "server request");
+        worker->capacity = size + SOURCE_MAP_SENTINELS;
+        alloc_failure_catch(outer);
+    }
+    if (!read_all(fd, worker->request, size, deadline)) return false;
+    memset(worker->request + size, 0, SOURCE_MAP_SENTINELS);
+
+    CONVERT_OPTIONS options = {
+            (flags & SERVER_FLAT) != 0, false, (flags & SERVER_BINARY) != 0,
+            (flags & SERVER_NDJSON) != 0, false, (flags & SERVER_PREFILTER) != 0,
+            (flags & SERVER_TYPED_CONSTANTS) != 0, 1, NULL};
+    worker->out.len = 0;
+    worker->messages.len = 0;
+    int res = convert_buffer(&worker->ctx, worker->request, size, &worker->out, &options);
+    if (res == CONVERT_OK && worker->out.len > UINT32_MAX) res = CONVERT_IO_ERROR;
+    uint32_t messages_size = worker->messages.len > UINT32_MAX ? UINT32_MAX : (uint32_t) worker->messages.len;
+    return send_response(fd, (uint32_t) res, worker->out.buf, res == CONVERT_OK ? (uint32_t) worker->out.len : 0,
+                         worker->messages.buf, messages_size);
+}
+
+/// Take ready connections one by one and answer one request of each until the server stops.
+/// Connections still open go back to the dispatcher, so a worker is never held by an idle one.
+///
+/// \param server Shared connections
+static void serve_worker(SERVER *server)
+{
+    SERVER_WORKER worker;
+    parse_context_init(&worker.ctx);
+    writer_init_buffer(&worker.out);
+    writer_init_buffer(&worker.messages);
+    worker.ctx.messages = &worker.messages;
+    worker.request = NULL;
+    worker.capacity = 0;
+    for (;;)
+    {
+        pthread_mutex_lock(&server->lock);
+        while (!server->ready_number && !server->stopped) pthread_cond_wait(&server->ready_cond, &server->lock);
+        if (server->stopped)
+        {
+            pthread_mutex_unlock(&server->lock);
+            break;
+        }
+        int fd = server->ready[server->ready_begin];
+        server->ready_begin = (server->ready_begin + 1) % SERVER_MAX_CONNECTIONS;
+        --server->ready_number;
+        pthread_mutex_unlock(&server->lock);
+
+        _Bool keep = serve_request(&worker, fd);
+        pthread_mutex_lock(&server->lock);
+        keep = keep && !server->stopped;
+        if (keep) server->idle[server->idle_number++] = fd;
+        else --server->connections;
+        pthread_mutex_unlock(&server->lock);
+        if (keep) wake_dispatcher();
+        else close(fd);
+    }
+    my_free(worker.request);
+    my_free(worker.out.buf);
+    my_free(worker.messages.buf);
+    parse_context_free(&worker.ctx);
+}
+
+/// Accept connections and watch the idle ones, giving those with a request coming to the workers,
+/// until SIGINT or SIGTERM.
+///
+/// \param server Shared connections
+static void dispatch(SERVER *server)
+{
+    // The wake-up pipe, the listening socket and the idle connections
+    struct pollfd *fds = (struct pollfd *) my_malloc(sizeof(struct pollfd) * (SERVER_MAX_CONNECTIONS + 2),
+            "server connections");
+    while (!stop_requested)
+    {
+        pthread_mutex_lock(&server->lock);
+        nfds_t number = 0;
+        fds[number++] = (struct pollfd) {wake_pipe[0], POLLIN, 0};
+        // Beyond the limit, new connections wait in the listen queue
+        _Bool accepting = server->connections < SERVER_MAX_CONNECTIONS;
+        if (accepting) fds[number++] = (struct pollfd) {server->listen_fd, POLLIN, 0};
+        nfds_t first_idle = number;
+        for (size_t i = 0; i < server->idle_number; ++i) fds[number++] = (struct pollfd) {server->idle[i], POLLIN, 0};
+        pthread_mutex_unlock(&server->lock);
+
+        if (poll(fds, number, -1) < 0)
+        {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Cannot wait for connections: %s\n", strerror(errno));
+            break;
+        }
+        if (fds[0].revents)
+        {
+            char drain[64];
+            while (read(wake_pipe[0], drain, sizeof(drain)) > 0) continue;
+        }
+
+        pthread_mutex_lock(&server->lock);
+        // Workers only append to `idle', so the connections polled are still its first ones
+        size_t kept = 0, polled = (size_t) (number - first_idle);
+        for (size_t i = 0; i < server->idle_number; ++i)
+        {
+            int fd = server->idle[i];
+            if (i < polled && fds[first_idle + i].revents)
+            {
+                server->ready[(server->ready_begin + server->ready_number++) % SERVER_MAX_CONNECTIONS] = fd;
+                pthread_cond_signal(&server->ready_cond);
+            }
+            else
+            {
+                server->idle[kept++] = fd;
+            }
+        }
+        server->idle_number = kept;
+        if (accepting && fds[1].revents)
+        {
+            int fd = accept(server->listen_fd, NULL, NULL);
+            if (fd >= 0)
+            {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);  // Inherited on some systems
+                struct timeval timeout = {SERVER_TIMEOUT, 0};
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                server->idle[server->idle_number++] = fd;
+                ++server->connections;
+            }
+        }
+        pthread_mutex_unlock(&server->lock);
+    }
+    my_free(fds);
+
+    // Requests being answered are finished, the connections waiting are closed
+    pthread_mutex_lock(&server->lock);
+    server->stopped = true;
+    pthread_cond_broadcast(&server->ready_cond);
+    for (size_t i = 0; i < server->idle_number; ++i) close(server->idle[i]);
+    for (; server->ready_number > 0; --server->ready_number)
+    {
+        close(server->ready[server->ready_begin]);
+        server->ready_begin = (server->ready_begin + 1) % SERVER_MAX_CONNECTIONS;
+    }
+    server->connections -= server->idle_number;
+    server->idle_number = 0;
+    pthread_mutex_unlock(&server->lock);
+}
+
+/// Thread of a worker.
+///
+/// \param arg Shared connections (SERVER)
+/// \return NULL
+static void *worker_main(void *arg)
+{
+    serve_worker((SERVER *) arg);
+    return NULL;
+}
+
+int server_run(const char *path, int workers)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "Too long path of the socket: %s\n", path);
+        return 3;
+    }
+    strcpy(address.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Cannot create the socket: %s\n", strerror(errno));
+        return 3;
+    }
+    unlink(path);  // Left by a server not stopped properly
+    if (bind(fd, (struct sockaddr *) &address, sizeof(address)) != 0
+        || listen(fd, workers * SERVER_BACKLOG_PER_WORKER) != 0)
+    {
+        fprintf(stderr, "Cannot listen on the socket: %s: %s\n", path, strerror(errno));
+        close(fd);
+        return 3;
+    }
+
+    // The dispatcher must not block on a connection gone before it is accepted
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    if (pipe(wake_pipe) != 0)
+    {
+        fprintf(stderr, "Cannot create the wake-up pipe: %s\n", strerror(errno));
+        close(fd);
+        unlink(path);
+        return 3;
+    }
+    fcntl(wake_pipe[0], F_SETFL, fcntl(wake_pipe[0], F_GETFL) | O_NONBLOCK);
+    fcntl(wake_pipe[1], F_SETFL, fcntl(wake_pipe[1], F_GETFL) | O_NONBLOCK);
+
+    SERVER server;
+    server.listen_fd = fd;
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.ready_cond, NULL);
+    server.ready = (int *) my_malloc(sizeof(int) * SERVER_MAX_CONNECTIONS, "server connections");
+    server.ready_begin = 0;
+    server.ready_number = 0;
+    server.idle = (int *) my_malloc(sizeof(int) * SERVER_MAX_CONNECTIONS, "server connections");
+    server.idle_number = 0;
+    server.connections = 0;
+    server.stopped = false;
+
+    stop_requested = 0;
+    signal(SIGPIPE, SIG_IGN);  // Clients going away are seen by `write'
+    signal(SIGINT, &stop_server);
+    signal(SIGTERM, &stop_server);
+    // The threads serve until the server stops, none of them may be missing
+    int res = 0, started = 0;
+    pthread_t *threads = (pthread_t *) my_malloc(sizeof(pthread_t) * workers, "server workers");
+    for (; started < workers; ++started)
+    {
+        int error = pthread_create(&threads[started], NULL, &worker_main, &server);
+        if (error != 0)
+        {
+            fprintf(stderr, "Cannot start a worker thread: %s\n", strerror(error));
+            res = 3;
+            break;
+        }
+    }
+    if (res == 0)
+    {
+        fprintf(stderr, "Serving on %s with %d workers\n", path, workers);
+        dispatch(&server);
+    }
+    else
+    {
+        pthread_mutex_lock(&server.lock);
+        server.stopped = true;
+        pthread_cond_broadcast(&server.ready_cond);
+        pthread_mutex_unlock(&server.lock);
+    }
+    for (int i = 0; i < started; ++i) pthread_join(threads[i], NULL);
+    my_free(threads);
+
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    my_free(server.ready);
+    my_free(server.idle);
+    pthread_cond_destroy(&server.ready_cond);
+    pthread_mutex_destroy(&server.lock);
+    close(wake_pipe[0]);
+    close(wake_pipe[1]);
+    wake_pipe[0] = wake_pipe[1] = -1;
+    close(fd);
+    unlink(path);
+    header_cache_clear();
+    return res;
+}
+
+#endif
@@ -0,0 +1,61 @@
+/**
+ * Parse server: conversions requested over a Unix domain socket
+ * by a persistent process, so they pay no startup and keep warm state.
+ *
+ * A connection carries any number of requests, answered in order.
+ * Numbers are 4-byte unsigned integers in network byte order.
+ *  Request:  flags (`SERVER_*' bits), size, then `size' bytes of the source.
+ *  Response: status (`CONVERT_*' or `SERVER_BAD_REQUEST'), size, then `size' bytes
+ *            of the output (nothing if the status is not CONVERT_OK),
+ *            then size and bytes of the error and warning messages of the request.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#ifndef C_PARSER_SERVER_H_INCLUDED
+#define C_PARSER_SERVER_H_INCLUDED
+
+/// Request flag: write the binary AST of `ast_binary.h' instead of JSON.
+#define SERVER_BINARY 1
+
+/// Request flag: write every top-level declaration as a line of JSON (NDJSON).
+#define SERVER_NDJSON 2
+
+/// Request flag: build the AST into flat, index-based storage (same output).
+#define SERVER_FLAT 4
+
+/// Request flag: replace trigraphs and remove line splices before scanning.
+#define SERVER_PREFILTER 8
+
+/// Request flag: write values and types of integer and floating constants into JSON.
+#define SERVER_TYPED_CONSTANTS 16
+
+/// Status of a response: the request is malformed or too big, the connection is closed after it.
+#define SERVER_BAD_REQUEST 2
+
+/// Largest source accepted, bytes.
+#define SERVER_MAX_REQUEST (64 * 1024 * 1024)
+
+/// Connections not accepted yet, per worker. Beyond them new connections are refused.
+#define SERVER_BACKLOG_PER_WORKER 4
+
+/// Most connections open at once, others wait in the listen queue of the socket.
+#define SERVER_MAX_CONNECTIONS 1024
+
+/// Seconds a request may take to arrive once its first byte has, and a response to be taken
+/// by the client. Connections stalled longer are closed, so they hold a worker (and delay
+/// stopping the server) for at most that long.
+#define SERVER_TIMEOUT 10
+
+/// Serve requests on the socket until SIGINT or SIGTERM. A dispatcher thread accepts
+/// connections and watches the idle ones with `poll'; each request coming is answered by
+/// the next free worker, which then gives the connection back, so idle connections hold no
+/// worker. Workers keep their parse context and output buffer between requests;
+/// included headers are shared by all of them through `header_cache'.
+///
+/// \param path Path of the socket to create, an old one is replaced
+/// \param workers Number of worker threads
+/// \return 0 - stopped by a signal, 3 - the socket cannot be created or a worker thread cannot be started
+int server_run(const char *path, int workers);
+
+#endif //C_PARSER_SERVER_H_INCLUDED
@@ -0,0 +1,152 @@
+/**
+ * Source files mapped into memory, ready to be scanned by Flex in place.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "alloc_wrap.h"
+#include "source_map.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+
+_Bool source_map(SOURCE_MAP *map, FILE *file)
+{
+    *map = (SOURCE_MAP) {NULL, 0, 0, NULL, 0};
+#if defined(_WIN32) || !defined(MAP_ANONYMOUS)
+    return false;
+#else
+    int fd = fileno(file);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0) return false;
+    size_t size = (size_t) info.st_size;
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t length = (size + SOURCE_MAP_SENTINELS + page - 1) / page * page;
+
+    // Zero pages are reserved first and the file is put over them, so the sentinels
+    // are addressable even when the file ends exactly at a page boundary
+    char *data = (char *) mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) return false;
+    if (mmap(data, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+        munmap(data, length);
+        return false;
+    }
+    data[size] = '\0';
+    data[size + 1] = '\0';
+    *map = (SOURCE_MAP) {data, size, length, NULL, 0};
+    return true;
+#endif
+}
+
+/// Character a trigraph ends by stands for.
+///
+/// \param c Third character of a possible trigraph
+/// \return Replacement, or `\0' if it is not a trigraph
+static char trigraph(char c)
+{
+    switch (c)
+    {
+        case '=': return '#';
+        case '(': return '[';
+        case '/': return '\\';
+        case ')': return ']';
+        case '\'': return '^';
+        case '<': return '{';
+        case '!': return '|';
+        case '>': return '}';
+        case '-': return '~';
+        default: return '\0';
+    }
+}
+
+/// Remember that the text from `offset' on lies `removed' bytes further in the file.
+///
+/// \param map Mapping being filtered
+/// \param capacity Capacity of `shifts', updated
+/// \param offset Offset in the filtered text
+/// \param removed Bytes removed before it in total
+static void add_shift(SOURCE_MAP *map, size_t *capacity, size_t offset, size_t removed)
+{
+    if (map->shifts_number > 0 && map->shifts[map->shifts_number - 1].offset == offset)
+    {
+        map->shifts[map->shifts_number - 1].removed = removed;
+        return;
+    }
+    if (map->shifts_number == *capacity)
+    {
+        *capacity = *capacity ? *capacity * 2 : 16;
+        map->shifts = (SOURCE_SHIFT *) my_realloc(map->shifts, *capacity * sizeof(SOURCE_SHIFT), "source shifts");
+    }
+    map->shifts[map->shifts_number++] = (SOURCE_SHIFT) {offset, removed};
+}
+
+void source_prefilter(SOURCE_MAP *map)
+{
+    char *text = map->data;
+    size_t size = map->size, read = 0, write = 0, capacity = 0;
+    while (read < size)
+    {
+        // Plain runs are moved at once, only `?' and `\' start anything to filter
+        size_t run = strcspn(text + read, "?\\");
+        if (write != read) memmove(text + write, text + read, run);
+        read += run;
+        write += run;
+        if (read == size) break;
+
+        char c = text[read];
+        size_t len = 1;
+        if (c == '?' && read + 2 < size && text[read + 1] == '?' && trigraph(text[read + 2]))
+        {
+            c = trigraph(text[read + 2]);
+            len = 3;
+        }
+        size_t end = read + len;
+        if (c == '\\' && end < size && (text[end] == '\n' || text[end] == '\r'))
+        {
+            end += text[end] == '\r' && end + 1 < size && text[end + 1] == '\n' ? 2 : 1;
+            read = end;
+            add_shift(map, &capacity, write, read - write);
+            continue;
+        }
+        text[write++] = c;
+        read = end;
+        if (len > 1) add_shift(map, &capacity, write, read - write);
+    }
+    memset(text + write, '\0', SOURCE_MAP_SENTINELS);
+    map->size = write;
+}
+
+size_t source_offset(const SOURCE_MAP *map, size_t offset)
+{
+    // The last shift at or before the offset applies
+    size_t low = 0, high = map->shifts_number;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (map->shifts[mid].offset <= offset) low = mid + 1;
+        else high = mid;
+    }
+    return low == 0 ? offset : offset + map->shifts[low - 1].removed;
+}
+
+void source_unmap(SOURCE_MAP *map)
+{
+#if !defined(_WIN32) && defined(MAP_ANONYMOUS)
+    if (map->data) munmap(map->data, map->length);
+#endif
+    my_free(map->shifts);
+    *map = (SOURCE_MAP) {NULL, 0, 0, NULL, 0};
+}
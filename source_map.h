@@ -0,0 +1,71 @@
+/**
+ * Source files mapped into memory, ready to be scanned by Flex in place.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#ifndef C_PARSER_SOURCE_MAP_H_INCLUDED
+#define C_PARSER_SOURCE_MAP_H_INCLUDED
+
+#include <stddef.h>
+#include <stdio.h>
+
+/// Number of zero bytes Flex requires after the scanned buffer.
+#define SOURCE_MAP_SENTINELS 2
+
+/// Place where `source_prefilter' shortened the text.
+typedef struct
+{
+    /// Offset in the filtered text the shift applies from
+    size_t offset;
+    /// Bytes removed before `offset' in total
+    size_t removed;
+}
+SOURCE_SHIFT;
+
+/// Source file mapped into memory.
+typedef struct
+{
+    /// Content of the file followed by `SOURCE_MAP_SENTINELS' zero bytes, NULL if not mapped
+    char *data;
+    /// Size of the file, or of its text left by `source_prefilter'
+    size_t size;
+    /// Size of the whole mapping
+    size_t length;
+    /// Shifts made by `source_prefilter' in increasing order of offsets, NULL if none
+    SOURCE_SHIFT *shifts;
+    /// Size of `shifts'
+    size_t shifts_number;
+}
+SOURCE_MAP;
+
+/// Map a regular file into writable private memory, without copying it.
+/// Other files (pipes, terminals, empty files) and systems without `mmap' are not mapped,
+/// they are to be read through `stdio' as before.
+///
+/// \param map Where to put the mapping
+/// \param file Opened file to map, stays opened
+/// \return `true' - file is mapped, `false' - it is to be read through `stdio'
+_Bool source_map(SOURCE_MAP *map, FILE *file);
+
+/// Do translation phases 1 and 2 over the mapped text in place, in one pass:
+/// trigraphs are replaced and line splices (a backslash, possibly spelled `??/',
+/// before a line break) are removed. The text is shortened, `size' is updated
+/// and the place of every removal is remembered for `source_offset'.
+///
+/// \param map Mapping to filter
+void source_prefilter(SOURCE_MAP *map);
+
+/// Offset in the file of a byte of the text left by `source_prefilter'.
+///
+/// \param map Filtered mapping
+/// \param offset Offset in the filtered text
+/// \return Offset in the file
+size_t source_offset(const SOURCE_MAP *map, size_t offset);
+
+/// Release the mapping. Does nothing for a file that was not mapped.
+///
+/// \param map Mapping to release
+void source_unmap(SOURCE_MAP *map);
+
+#endif //C_PARSER_SOURCE_MAP_H_INCLUDED
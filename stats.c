@@ -0,0 +1,155 @@
+/**
+ * Measurements of one conversion printed by `--stats': time of its phases
+ * and counters of the lexer, the parser and the allocator.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+#include "alloc_wrap.h"
+#include "ast.h"
+#include "stats.h"
+#include "writer.h"
+
+/// Names of the phases in the report.
+static const char *phase_names[STATS_PHASES_NUMBER] = {"lex", "parse", "output", "write", "free"};
+
+/// Names of the token classes in the report.
+static const char *token_class_names[STATS_TOKEN_CLASSES_NUMBER] =
+    {
+        "keyword", "identifier", "typedef_name", "integer_constant",
+        "floating_constant", "character_constant", "string_literal", "punctuator"
+    };
+
+void stats_init(PARSE_STATS *stats)
+{
+    memset(stats, 0, sizeof(PARSE_STATS));
+    stats->allocations = alloc_counters;
+}
+
+double stats_wall_now()
+{
+    struct timespec now;
+#ifdef _WIN32
+    timespec_get(&now, TIME_UTC);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#endif
+    return (double) now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void stats_now(STATS_TIME *now)
+{
+    now->wall = stats_wall_now();
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    struct timespec cpu;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+    now->cpu = (double) cpu.tv_sec + cpu.tv_nsec / 1e9;
+#else
+    now->cpu = (double) clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+void stats_phase_start(PARSE_STATS *stats, STATS_TIME *start)
+{
+    if (stats) stats_now(start);
+}
+
+void stats_phase_end(PARSE_STATS *stats, STATS_PHASE phase, const STATS_TIME *start)
+{
+    if (!stats) return;
+    STATS_TIME now;
+    stats_now(&now);
+    stats->phases[phase].wall += now.wall - start->wall;
+    stats->phases[phase].cpu += now.cpu - start->cpu;
+}
+
+long stats_peak_rss_kb()
+{
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return (long) (usage.ru_maxrss / 1024);
+#else
+    return (long) usage.ru_maxrss;
+#endif
+#endif
+}
+
+/// Write `"name":value' of a counter.
+///
+/// \param out Writer to write to
+/// \param name Name of the counter
+/// \param value Value of the counter
+static void write_counter(WRITER *out, const char *name, size_t value)
+{
+    char num[24];
+    writer_put_quoted(out, name);
+    writer_put(out, num, (size_t) sprintf(num, ":%zu", value));
+}
+
+void stats_write_json(WRITER *out, PARSE_STATS *stats, const char *file_name)
+{
+    stats->allocations.calls = alloc_counters.calls - stats->allocations.calls;
+    stats->allocations.bytes = alloc_counters.bytes - stats->allocations.bytes;
+
+    char num[64];
+    writer_puts(out, "{\"file\":");
+    if (file_name) writer_put_quoted(out, file_name);
+    else writer_puts(out, "null");
+
+    writer_puts(out, ",\"phases\":{");
+    for (int i = 0; i < STATS_PHASES_NUMBER; ++i)
+    {
+        if (i > 0) writer_putc(out, ',');
+        writer_put_quoted(out, phase_names[i]);
+        writer_put(out, num, (size_t) sprintf(num, ":{\"wall\":%.6f", stats->phases[i].wall));
+        // Scanning is not timed by processor clock, it is too costly per token
+        if (i != STATS_LEX) writer_put(out, num, (size_t) sprintf(num, ",\"cpu\":%.6f", stats->phases[i].cpu));
+        writer_putc(out, '}');
+    }
+
+    size_t total = 0;
+    writer_puts(out, "},\"tokens\":{");
+    for (int i = 0; i < STATS_TOKEN_CLASSES_NUMBER; ++i)
+    {
+        write_counter(out, token_class_names[i], stats->tokens[i]);
+        writer_putc(out, ',');
+        total += stats->tokens[i];
+    }
+    write_counter(out, "total", total);
+
+    total = 0;
+    writer_puts(out, "},\"nodes\":{");
+    for (int i = 0; i < AST_NODE_TYPES_NUMBER; ++i)
+    {
+        write_counter(out, ast_type_to_str((AST_NODE_TYPE) i), stats->nodes[i]);
+        writer_putc(out, ',');
+        total += stats->nodes[i];
+    }
+    write_counter(out, "total", total);
+
+    writer_puts(out, "},\"typedefs\":{");
+    write_counter(out, "names", (size_t) stats->typedef_names);
+    writer_putc(out, ',');
+    write_counter(out, "lookups", stats->typedef_lookups);
+    writer_puts(out, "},\"allocations\":{");
+    write_counter(out, "calls", stats->allocations.calls);
+    writer_putc(out, ',');
+    write_counter(out, "bytes", stats->allocations.bytes);
+    writer_puts(out, "},");
+    write_counter(out, "include_depth", (size_t) stats->include_depth);
+    writer_putc(out, ',');
+    write_counter(out, "peak_rss_kb", (size_t) stats_peak_rss_kb());
+    writer_putc(out, '}');
+}
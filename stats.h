@@ -0,0 +1,112 @@
+/**
+ * Measurements of one conversion printed by `--stats': time of its phases
+ * and counters of the lexer, the parser and the allocator.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#ifndef C_PARSER_STATS_H_INCLUDED
+#define C_PARSER_STATS_H_INCLUDED
+
+#include <stddef.h>
+#include "ast.h"
+#include "writer.h"
+
+/// Phases of a conversion.
+typedef enum
+{
+    /// Scanning of tokens, timed inside of parsing by wall clock only
+    STATS_LEX,
+    /// Parsing without scanning (its CPU time includes scanning)
+    STATS_PARSE,
+    /// Generation of the output, without writing it
+    STATS_OUTPUT,
+    /// Writing and closing of the output file
+    STATS_WRITE,
+    /// Freeing of the AST and everything else of the parse
+    STATS_FREE,
+    STATS_PHASES_NUMBER
+}
+STATS_PHASE;
+
+/// Classes of tokens counted.
+typedef enum
+{
+    STATS_KEYWORD,
+    STATS_IDENTIFIER,
+    STATS_TYPEDEF_NAME,
+    STATS_INTEGER_CONSTANT,
+    STATS_FLOATING_CONSTANT,
+    STATS_CHARACTER_CONSTANT,
+    STATS_STRING_LITERAL,
+    STATS_PUNCTUATOR,
+    STATS_TOKEN_CLASSES_NUMBER
+}
+STATS_TOKEN_CLASS;
+
+/// Moment or duration, seconds.
+typedef struct
+{
+    double wall;
+    /// Processor time of the current thread
+    double cpu;
+}
+STATS_TIME;
+
+/// Measurements of one conversion.
+typedef struct
+{
+    STATS_TIME phases[STATS_PHASES_NUMBER];
+    size_t tokens[STATS_TOKEN_CLASSES_NUMBER];
+    size_t nodes[AST_NODE_TYPES_NUMBER];
+    /// typedef-names known at the end of the translation unit
+    int typedef_names;
+    size_t typedef_lookups;
+    /// Deepest `#include' nesting reached
+    int include_depth;
+    /// `alloc_counters' of the thread when the conversion began, then their increase
+    ALLOC_COUNTERS allocations;
+}
+PARSE_STATS;
+
+/// Start measuring a conversion: everything is zeroed, allocation counters are remembered.
+///
+/// \param stats Measurements to initialize
+void stats_init(PARSE_STATS *stats);
+
+/// Get the current moment.
+///
+/// \param now Receives the moment
+void stats_now(STATS_TIME *now);
+
+/// Get the current moment by wall clock only, cheaper than `stats_now'.
+///
+/// \return Seconds since some moment in the past
+double stats_wall_now();
+
+/// Remember the beginning of a phase. Does nothing without measurements.
+///
+/// \param stats Measurements or NULL
+/// \param start Receives the current moment
+void stats_phase_start(PARSE_STATS *stats, STATS_TIME *start);
+
+/// Add the time since the beginning to the phase. Does nothing without measurements.
+///
+/// \param stats Measurements or NULL
+/// \param phase Phase to add to
+/// \param start Moment the phase began
+void stats_phase_end(PARSE_STATS *stats, STATS_PHASE phase, const STATS_TIME *start);
+
+/// Peak resident set size of the process.
+///
+/// \return Size in KB, 0 if it is not known
+long stats_peak_rss_kb();
+
+/// Finish measuring and write the report: one line of JSON without a line break.
+///
+/// \param out Writer to write to
+/// \param stats Measurements
+/// \param file_name Name of the source, NULL - `stdin'
+void stats_write_json(WRITER *out, PARSE_STATS *stats, const char *file_name);
+
+#endif //C_PARSER_STATS_H_INCLUDED
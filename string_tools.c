@@ -8,6 +8,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
 #include "alloc_wrap.h"
 #include "string_tools.h"
 
@@ -23,42 +28,319 @@ _Bool str_eq(char *str1, char *str2)
     return str1[i] == str2[i];  // Both could be '\0'
 }
 
-/// Checks if provided character is needed to be escaped.
+uint32_t str_hash(const char *str, size_t *len)
+{
+    uint32_t hash = 2166136261u;
+    const unsigned char *p = (const unsigned char *) str;
+    for (; *p != '\0'; ++p)
+    {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    if (len) *len = (size_t) (p - (const unsigned char *) str);
+    return hash;
+}
+
+uint32_t str_hash_len(const char *str, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    const unsigned char *p = (const unsigned char *) str;
+    for (size_t i = 0; i < len; ++i)
+    {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/// Does the byte need an escape inside of a JSON string?
 ///
-/// \param ch character to check
+/// \param ch Byte to check
 /// \return `true' - it is to be escaped, `false' - otherwise
-_Bool is_to_escape(char ch)
+static inline _Bool is_to_escape(unsigned char ch)
 {
-    return ch == '"' || ch == '\\' || ch == '\b' || ch == '\f'
-        || ch == '\n' || ch == '\r' || ch == '\t';
+    return ch < 0x20 || ch == '"' || ch == '\\';
+}
+
+/// Index of the lowest set bit of a non-zero mask.
+///
+/// \param mask Mask to look into
+/// \return Index of the bit
+static inline unsigned lowest_bit(uint32_t mask)
+{
+#if defined(__GNUC__)
+    return (unsigned) __builtin_ctz(mask);
+#else
+    unsigned i = 0;
+    while (!(mask & 1u)) mask >>= 1, ++i;
+    return i;
+#endif
+}
+
+/// Length of the run of bytes not needing escapes at the beginning.
+/// Bytes at or below 0x1F are found by the unsigned minimum, as SSE2 has no unsigned comparison.
+///
+/// \param str Bytes to look through
+/// \param len Number of bytes
+/// \return Index of the first byte to escape, `len' if there are none
+static size_t clean_run(const unsigned char *str, size_t len)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i quote32 = _mm256_set1_epi8('"');
+    const __m256i backslash32 = _mm256_set1_epi8('\\');
+    const __m256i control32 = _mm256_set1_epi8(0x1F);
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *) (str + i));
+        __m256i special = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote32), _mm256_cmpeq_epi8(chunk, backslash32)),
+            _mm256_cmpeq_epi8(_mm256_min_epu8(chunk, control32), chunk));
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8(special);
+        if (mask) return i + lowest_bit(mask);
+    }
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) (str + i));
+        __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+            _mm_cmpeq_epi8(_mm_min_epu8(chunk, control), chunk));
+        uint32_t mask = (uint32_t) _mm_movemask_epi8(special);
+        if (mask) return i + lowest_bit(mask);
+    }
+#endif
+    while (i < len && !is_to_escape(str[i])) ++i;
+    return i;
+}
+
+size_t json_escape(char *dst, const char *src, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char *str = (const unsigned char *) src;
+    char *res = dst;
+    size_t i = 0;
+    while (true)
+    {
+        size_t run = clean_run(str + i, len - i);
+        memcpy(res, str + i, run);
+        res += run;
+        i += run;
+        if (i == len) break;
+        unsigned char ch = str[i++];
+        *res++ = '\\';
+        switch (ch)
+        {
+            case '\\': *res++ = '\\'; break;
+            case '\"': *res++ = '"'; break;
+            case '\b': *res++ = 'b'; break;
+            case '\f': *res++ = 'f'; break;
+            case '\n': *res++ = 'n'; break;
+            case '\r': *res++ = 'r'; break;
+            case '\t': *res++ = 't'; break;
+            default:
+                res[0] = 'u'; res[1] = '0'; res[2] = '0';
+                res[3] = hex[ch >> 4]; res[4] = hex[ch & 0xF];
+                res += 5;
+        }
+    }
+    return (size_t) (res - dst);
 }
 
 char *wrap_by_quotes(char *str)
 {
     if (!str) return NULL;
-    int counter = 0;
-    for (int i = 0; i < strlen(str); ++i)
+    size_t len = strlen(str);
+    char *res = (char *) my_malloc(JSON_ESCAPED_MAX(len) + 3, "quoted string");
+    res[0] = '"';
+    size_t end = 1 + json_escape(res + 1, str, len);
+    res[end] = '"';
+    res[end + 1] = '\0';
+    return res;
+}
+
+/// Character a trigraph `??c' stands for.
+///
+/// \param c Last character of the trigraph
+/// \return Replacement of the trigraph, 0 - `??c' is not a trigraph
+static char trigraph_char(char c)
+{
+    switch (c)
     {
-        if (is_to_escape(str[i])) ++counter;
+        case '=': return '#';
+        case '(': return '[';
+        case '/': return '\\';
+        case ')': return ']';
+        case '\'': return '^';
+        case '<': return '{';
+        case '!': return '|';
+        case '>': return '}';
+        case '-': return '~';
+        default: return 0;
     }
-    size_t new_size = strlen(str) + counter + 3;
-    char *res = (char *) my_malloc(new_size, "quoted string");
-    res[0] = '"'; res[new_size-2] = '"'; res[new_size-1] = '\0';
-    int j = 1;
-    for (int i = 0; i < strlen(str); ++i)
+}
+
+/// Take the next source character of a spelling, replacing trigraphs and skipping line splices.
+///
+/// \param raw Spelling
+/// \param len Length of the spelling
+/// \param pos Position in the spelling, moved past the character
+/// \return The character, -1 - the spelling is over
+static int spelling_next(const char *raw, size_t len, size_t *pos)
+{
+    while (*pos < len)
     {
-        switch (str[i])
+        size_t i = *pos;
+        int c = (unsigned char) raw[i++];
+        if (c == '?' && i + 1 < len && raw[i] == '?' && trigraph_char(raw[i + 1]))
+        {
+            c = trigraph_char(raw[i + 1]);
+            i += 2;
+        }
+        *pos = i;
+        if (c != '\\' || i == len || (raw[i] != '\n' && raw[i] != '\r')) return c;
+        *pos = i + (raw[i] == '\r' && i + 1 < len && raw[i + 1] == '\n' ? 2 : 1);
+    }
+    return -1;
+}
+
+/// Value of a hexadecimal digit.
+///
+/// \param c Character to convert
+/// \return Value of the digit, -1 - it is not a hexadecimal digit
+static int hex_digit(int c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/// Read up to `max' digits of the given base from a spelling.
+///
+/// \param raw Spelling
+/// \param len Length of the spelling
+/// \param pos Position in the spelling, moved past the digits
+/// \param base 8 or 16
+/// \param max Maximal number of digits
+/// \param value Receives the number, larger ones than 0x10FFFF are kept as 0x110000
+/// \return Number of digits read
+static int read_digits(const char *raw, size_t len, size_t *pos, int base, int max, uint32_t *value)
+{
+    int n = 0;
+    *value = 0;
+    while (n < max)
+    {
+        size_t next = *pos;
+        int d = hex_digit(spelling_next(raw, len, &next));
+        if (d < 0 || d >= base) break;
+        *value = *value * base + d;
+        if (*value > 0x10FFFF) *value = 0x110000;
+        *pos = next;
+        ++n;
+    }
+    return n;
+}
+
+/// Write a code point in UTF-8.
+///
+/// \param out Buffer of at least 4 bytes, NULL - only count the bytes
+/// \param cp Code point, not above 0x10FFFF
+/// \return Number of bytes of the code point
+static size_t put_utf8(char *out, uint32_t cp)
+{
+    size_t n = cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+    if (!out) return n;
+    if (n == 1)
+    {
+        out[0] = (char) cp;
+        return 1;
+    }
+    static const unsigned char lead[] = {0, 0, 0xC0, 0xE0, 0xF0};
+    for (size_t i = n - 1; i > 0; --i)
+    {
+        out[i] = (char) (0x80 | (cp & 0x3F));
+        cp >>= 6;
+    }
+    out[0] = (char) (lead[n] | cp);
+    return n;
+}
+
+_Bool literal_has_escapes(const char *raw, size_t len)
+{
+    if (memchr(raw, '\\', len)) return true;
+    const char *end = raw + len;
+    for (const char *q = raw; (q = (const char *) memchr(q, '?', (size_t) (end - q))) && end - q >= 3; ++q)
+    {
+        if (q[1] == '?' && trigraph_char(q[2])) return true;
+    }
+    return false;
+}
+
+size_t literal_decode(const char *raw, size_t len, char *out, size_t *chars)
+{
+    size_t pos = 0, res = 0, number = 0;
+    int c;
+    while ((c = spelling_next(raw, len, &pos)) >= 0)
+    {
+        ++number;
+        if (c != '\\')
+        {
+            if (out) out[res] = (char) c;
+            ++res;
+            continue;
+        }
+        uint32_t value;
+        _Bool ucn = false;
+        c = spelling_next(raw, len, &pos);
+        switch (c)
+        {
+            case '\'': case '"': case '?': case '\\': value = (uint32_t) c; break;
+            case 'a': value = '\a'; break;
+            case 'b': value = '\b'; break;
+            case 'f': value = '\f'; break;
+            case 'n': value = '\n'; break;
+            case 'r': value = '\r'; break;
+            case 't': value = '\t'; break;
+            case 'v': value = '\v'; break;
+            case 'x':
+                if (!read_digits(raw, len, &pos, 16, (int) len, &value)) return LITERAL_INVALID;
+                break;
+            case 'u':
+            case 'U':
+                ucn = true;
+                if (read_digits(raw, len, &pos, 16, c == 'u' ? 4 : 8, &value) != (c == 'u' ? 4 : 8))
+                {
+                    return LITERAL_INVALID;
+                }
+                break;
+            default:
+                if (c < '0' || c > '7') return LITERAL_INVALID;
+                pos -= 1;  // Octal digits are never trigraphs or splices
+                read_digits(raw, len, &pos, 8, 3, &value);
+                if (value > 0377) return LITERAL_INVALID;  // Does not fit a byte
+        }
+        // ISO/IEC 9899:2017, page 53: universal character names of the basic character set
+        // (except `$', `@' and `\`') and of surrogates are not allowed
+        if (value > 0x10FFFF || (ucn && ((value < 0xA0 && value != 0x24 && value != 0x40 && value != 0x60)
+                                         || (value >= 0xD800 && value <= 0xDFFF))))
+        {
+            return LITERAL_INVALID;
+        }
+        // Bytes above 0x7F would not be valid UTF-8 alone, so they are taken as U+0080..U+00FF
+        if (value < 0x80 && !ucn)
+        {
+            if (out) out[res] = (char) value;
+            ++res;
+        }
+        else
         {
-            case '\\' : res[j++] = '\\'; res[j++] = '\\'; break;
-            case '\"' : res[j++] = '\\'; res[j++] = '"'; break;
-            case '\b' : res[j++] = '\\'; res[j++] = 'b'; break;
-            case '\f' : res[j++] = '\\'; res[j++] = 'f'; break;
-            case '\n' : res[j++] = '\\'; res[j++] = 'n'; break;
-            case '\r' : res[j++] = '\\'; res[j++] = 'r'; break;
-            case '\t' : res[j++] = '\\'; res[j++] = 't'; break;
-            default: res[j++] = str[i];
+            res += put_utf8(out ? out + res : NULL, value);
         }
     }
+    if (chars) *chars = number;
     return res;
 }
 
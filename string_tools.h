@@ -7,6 +7,9 @@
 #ifndef C_PARSER_STRING_TOOLS_H_INCLUDED
 #define C_PARSER_STRING_TOOLS_H_INCLUDED
 
+#include <stddef.h>
+#include <stdint.h>
+
 /// Are the given strings equal?
 ///
 /// \param str1 First string for comparison
@@ -14,14 +17,66 @@
 /// \return `true' - strings contents are identical, `false' - otherwise
 _Bool str_eq(char *str1, char *str2);
 
+/// Hash of a string (32-bit FNV-1a).
+///
+/// \param str String to hash
+/// \param len If not NULL, receives the length of the string
+/// \return Hash value
+uint32_t str_hash(const char *str, size_t *len);
+
+/// Hash of `len' bytes, the same `str_hash' gives for the string of them.
+///
+/// \param str Bytes to hash
+/// \param len Number of bytes
+/// \return Hash value
+uint32_t str_hash_len(const char *str, size_t len);
+
+/// Upper bound of the length of `len' bytes escaped by `json_escape'.
+#define JSON_ESCAPED_MAX(len) ((len) * 6)
+
+/// Escape bytes for a JSON string in one pass: `"', `\\' and control characters
+/// below 0x20 are escaped (`\\n' and similar where JSON has them, `\\u00XX' otherwise),
+/// other bytes are copied unchanged. Runs of bytes without escapes are found
+/// by SSE2 or AVX2 where available and copied at once.
+///
+/// \param dst Buffer of at least `JSON_ESCAPED_MAX(len)' bytes, no null terminator is added
+/// \param src Bytes to escape
+/// \param len Number of bytes
+/// \return Number of bytes written into `dst'
+size_t json_escape(char *dst, const char *src, size_t len);
+
 /// Wrap a given string into double quotes.
-/// If the string contains special symbols, it escapes them.
+/// If the string contains special symbols, it escapes them (see `json_escape').
 /// Needs to be released.
 ///
 /// \param str String to wrap
 /// \return New string inside quotes
 char *wrap_by_quotes(char *str);
 
+/// Result of `literal_decode' for a spelling with an invalid escape sequence.
+#define LITERAL_INVALID ((size_t) -1)
+
+/// Does the spelling of a character constant or string literal need decoding,
+/// i.e. does it have escape sequences, trigraphs or line splices?
+///
+/// \param raw Spelling between the quotes
+/// \param len Length of the spelling
+/// \return `true' - it differs from its value, `false' - it is its own value
+_Bool literal_has_escapes(const char *raw, size_t len);
+
+/// Decode the spelling of a character constant or string literal into its value:
+/// trigraphs are replaced, line splices removed and escape sequences expanded.
+/// Universal character names, and numeric escapes above 0x7F, are written in UTF-8
+/// (`\xff' is U+00FF); octal escapes above 0377 are invalid.
+/// The value is never longer than the spelling.
+///
+/// \param raw Spelling between the quotes
+/// \param len Length of the spelling
+/// \param out Buffer of at least `len' bytes for the value (not null-terminated), NULL - only check the spelling
+/// \param chars If not NULL, receives the number of characters of the value
+/// \return Length of the value in bytes, `LITERAL_INVALID' - the spelling has an invalid escape sequence
+size_t literal_decode(const char *raw, size_t len, char *out, size_t *chars);
+
 /// Convert a constant string to an allocated memory.
 /// Needs to be released.
 ///
@@ -1,5 +1,7 @@
 #!/bin/bash
-gcc unit_tests.c alloc_wrap.c ast.c string_tools.c typedef_name.c -o unit_tests
+gcc gen_std_headers.c -o gen_std_headers
+./gen_std_headers std_headers.h
+gcc unit_tests.c alloc_wrap.c ast.c string_tools.c typedef_name.c writer.c intern.c header_cache.c ast_binary.c source_map.c stats.c thread_pool.c result_cache.c constant.c -pthread -o unit_tests
 ./unit_tests
-rm unit_tests
+rm unit_tests std_headers.h gen_std_headers
 read -p "Press any key to continue . . ."
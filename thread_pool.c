@@ -0,0 +1,175 @@
+/**
+ * Pool of worker threads running a fixed set of jobs with work stealing.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "alloc_wrap.h"
+#include "thread_pool.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+/// Jobs dealt to one worker. The owner takes them from the front, thieves - from the back.
+typedef struct
+{
+    pthread_mutex_t lock;
+    size_t *jobs;
+    size_t begin;
+    size_t end;
+}
+WORK_QUEUE;
+
+/// Shared state of one `thread_pool_run'.
+typedef struct
+{
+    WORK_QUEUE *queues;
+    int n_workers;
+    THREAD_POOL_JOB job;
+    void *arg;
+}
+THREAD_POOL;
+
+/// Argument of a worker thread.
+typedef struct
+{
+    THREAD_POOL *pool;
+    int index;
+    /// Allocations of the thread (see `alloc_counters'), set when it is over
+    ALLOC_COUNTERS allocations;
+}
+WORKER;
+
+int thread_pool_default_size()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    long n = (long) info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return n > 0 ? (int) n : 1;
+}
+
+/// Take the next job from the front of the own queue.
+///
+/// \param queue Queue of the worker
+/// \param job Where to put the taken job
+/// \return `true' - job is taken, `false' - queue is empty
+static _Bool pop_front(WORK_QUEUE *queue, size_t *job)
+{
+    pthread_mutex_lock(&queue->lock);
+    _Bool res = queue->begin < queue->end;
+    if (res) *job = queue->jobs[queue->begin++];
+    pthread_mutex_unlock(&queue->lock);
+    return res;
+}
+
+/// Steal a job from the back of another worker's queue.
+///
+/// \param queue Queue to steal from
+/// \param job Where to put the stolen job
+/// \return `true' - job is stolen, `false' - queue is empty
+static _Bool pop_back(WORK_QUEUE *queue, size_t *job)
+{
+    pthread_mutex_lock(&queue->lock);
+    _Bool res = queue->begin < queue->end;
+    if (res) *job = queue->jobs[--queue->end];
+    pthread_mutex_unlock(&queue->lock);
+    return res;
+}
+
+/// Worker thread: run own jobs, then steal until every queue is empty.
+///
+/// \param arg Worker description (WORKER)
+/// \return NULL
+static void *worker_main(void *arg)
+{
+    WORKER *self = (WORKER *) arg;
+    THREAD_POOL *pool = self->pool;
+    size_t job;
+    for (;;)
+    {
+        if (pop_front(&pool->queues[self->index], &job))
+        {
+            pool->job(job, self->index, pool->arg);
+            continue;
+        }
+        _Bool stolen = false;
+        for (int i = 1; i < pool->n_workers && !stolen; ++i)
+        {
+            stolen = pop_back(&pool->queues[(self->index + i) % pool->n_workers], &job);
+        }
+        // No jobs are added while running, so empty queues stay empty
+        if (!stolen)
+        {
+            self->allocations = alloc_counters;
+            return NULL;
+        }
+        pool->job(job, self->index, pool->arg);
+    }
+}
+
+void thread_pool_run(size_t n_jobs, int n_workers, THREAD_POOL_JOB job, void *arg)
+{
+    if ((size_t) n_workers > n_jobs) n_workers = n_jobs ? (int) n_jobs : 1;
+    if (n_workers <= 1)
+    {
+        for (size_t i = 0; i < n_jobs; ++i) job(i, 0, arg);
+        return;
+    }
+
+    THREAD_POOL pool = {NULL, n_workers, job, arg};
+    pool.queues = (WORK_QUEUE *) my_malloc(sizeof(WORK_QUEUE) * n_workers, "work queues");
+    size_t per_queue = (n_jobs + n_workers - 1) / n_workers;
+    for (int w = 0; w < n_workers; ++w)
+    {
+        WORK_QUEUE *queue = &pool.queues[w];
+        pthread_mutex_init(&queue->lock, NULL);
+        queue->jobs = (size_t *) my_malloc(sizeof(size_t) * per_queue, "work queues");
+        queue->begin = queue->end = 0;
+        // Round robin: each queue starts with one of the first jobs
+        for (size_t i = w; i < n_jobs; i += n_workers) queue->jobs[queue->end++] = i;
+    }
+
+    pthread_t *threads = (pthread_t *) my_malloc(sizeof(pthread_t) * n_workers, "worker threads");
+    WORKER *workers = (WORKER *) my_malloc(sizeof(WORKER) * n_workers, "worker threads");
+    int started = 0;
+    for (int w = 1; w < n_workers; ++w)
+    {
+        workers[w] = (WORKER) {&pool, w, {0, 0}};
+        if (pthread_create(&threads[w], NULL, worker_main, &workers[w]) != 0)
+        {
+            // Jobs of a missing worker are stolen by the others
+            fprintf(stderr, "WARNING: Cannot start worker thread, continuing with %d.\n", started + 1);
+            break;
+        }
+        ++started;
+    }
+    workers[0] = (WORKER) {&pool, 0, {0, 0}};
+    worker_main(&workers[0]);
+    // Threads are new, so their counters are what the jobs allocated; the calling thread has its own
+    for (int w = 1; w <= started; ++w)
+    {
+        pthread_join(threads[w], NULL);
+        alloc_counters.calls += workers[w].allocations.calls;
+        alloc_counters.bytes += workers[w].allocations.bytes;
+    }
+
+    for (int w = 0; w < n_workers; ++w)
+    {
+        pthread_mutex_destroy(&pool.queues[w].lock);
+        my_free(pool.queues[w].jobs);
+    }
+    my_free(pool.queues);
+    my_free(threads);
+    my_free(workers);
+}
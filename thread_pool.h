@@ -0,0 +1,36 @@
+/**
+ * Pool of worker threads running a fixed set of jobs with work stealing.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#ifndef C_PARSER_THREAD_POOL_H_INCLUDED
+#define C_PARSER_THREAD_POOL_H_INCLUDED
+
+#include <stddef.h>
+
+/// Function doing one job.
+///
+/// \param job Index of the job
+/// \param worker Index of the worker thread running it
+/// \param arg Argument given to `thread_pool_run'
+typedef void (*THREAD_POOL_JOB)(size_t job, int worker, void *arg);
+
+/// Number of workers to use by default: number of online processors.
+///
+/// \return Number of processors, at least 1
+int thread_pool_default_size();
+
+/// Run jobs 0..`n_jobs'-1 on `n_workers' threads and wait for all of them.
+/// Jobs are dealt out to per-worker queues in index order, so lower indexes start first;
+/// a worker with an empty queue steals from the tails of the others.
+/// With 1 worker, jobs are run on the calling thread.
+/// Allocations of the other threads are added to `alloc_counters' of the calling one.
+///
+/// \param n_jobs Number of jobs
+/// \param n_workers Number of worker threads
+/// \param job Function doing one job, called concurrently
+/// \param arg Argument to pass to `job'
+void thread_pool_run(size_t n_jobs, int n_workers, THREAD_POOL_JOB job, void *arg);
+
+#endif //C_PARSER_THREAD_POOL_H_INCLUDED
@@ -0,0 +1,153 @@
+/**
+ * Benchmark of typedef-name symbol table lookups
+ * against the former linear table.
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "alloc_wrap.h"
+#include "intern.h"
+#include "string_tools.h"
+#include "typedef_name.h"
+
+/// Number of lookups per measurement.
+#define LOOKUPS 2000000
+
+/// Number of project-specific typedef-names put in addition to standard ones.
+#define PROJECT_TYPEDEFS 300
+
+/// Former linear typedef-name table.
+char **linear_table;
+
+/// Size of the former linear typedef-name table.
+int linear_table_size = 0;
+
+/// Former `is_typedef_name': linear scan with `str_eq'.
+_Bool linear_is_typedef_name(char *id)
+{
+    for (int i = 0; i < linear_table_size; ++i)
+    {
+        if (str_eq(id, linear_table[i])) return true;
+    }
+    return false;
+}
+
+/// Former `put_typedef_name': one `realloc' per entry.
+void linear_put_typedef_name(char *id)
+{
+    linear_table = (char **) my_realloc(linear_table, sizeof(char *) * (linear_table_size + 1),
+            "typedef-name symbol table");
+    linear_table[linear_table_size++] = alloc_const_str(id);
+}
+
+/// Seconds of processor time since the given moment.
+double seconds_since(clock_t start)
+{
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main()
+{
+    char *headers[] = {"stddef.h", "stdint.h", "stdio.h", "stdlib.h", "stdatomic.h", "wchar.h",
+                       "threads.h", "time.h", "uchar.h", "wctype.h", "inttypes.h", "math.h"};
+    int n_headers = sizeof(headers) / sizeof(*headers);
+    char name[32];
+    INTERN_POOL strings;
+    init_intern_pool(&strings);
+    TYPEDEF_TABLE table;
+    init_typedef_name(&table, &strings);
+
+    // Tables of the same size: standard headers and project typedefs
+    for (int i = 0; i < n_headers; ++i) add_std_typedef(&table, headers[i]);
+    for (int i = 0; i < PROJECT_TYPEDEFS; ++i)
+    {
+        sprintf(name, "project_type%d_t", i);
+        put_typedef_name(&table, name);
+    }
+    char *std_names[] = {"size_t", "FILE", "uint32_t", "atomic_int", "wint_t", "thrd_t", "float_t",
+                         "imaxdiv_t", "time_t", "char16_t", "wctype_t", "atomic_uintmax_t"};
+    for (int i = 0; i < sizeof(std_names) / sizeof(*std_names); ++i) linear_put_typedef_name(std_names[i]);
+    // Pad the standard part up to the size of the hashed one
+    while (linear_table_size < table.size - PROJECT_TYPEDEFS)
+    {
+        sprintf(name, "std_filler%d", linear_table_size);
+        linear_put_typedef_name(name);
+    }
+    for (int i = 0; i < PROJECT_TYPEDEFS; ++i)
+    {
+        sprintf(name, "project_type%d_t", i);
+        linear_put_typedef_name(name);
+    }
+
+    // Typical identifier stream: mostly ordinary identifiers, some typedef-names
+    char *ids[] = {"i", "len", "buffer", "size_t", "result", "node", "uint32_t", "count", "FILE", "ptr",
+                   "project_type42_t", "value", "index", "project_type299_t", "atomic_int", "data"};
+    int n_ids = sizeof(ids) / sizeof(*ids);
+
+    long found = 0;
+    clock_t start = clock();
+    for (int i = 0; i < LOOKUPS; ++i) found += linear_is_typedef_name(ids[i % n_ids]);
+    double linear_time = seconds_since(start);
+
+    long found_hashed = 0;
+    start = clock();
+    for (int i = 0; i < LOOKUPS; ++i) found_hashed += is_typedef_name(&table, ids[i % n_ids]);
+    double hashed_time = seconds_since(start);
+    // Lexer's path: identifiers are interned before the lookup
+    char *interned[sizeof(ids) / sizeof(*ids)];
+    for (int i = 0; i < n_ids; ++i) interned[i] = intern_str(&strings, ids[i]);
+    long found_interned = 0;
+    start = clock();
+    for (int i = 0; i < LOOKUPS; ++i) found_interned += is_typedef_name_interned(&table, interned[i % n_ids]);
+    double interned_time = seconds_since(start);
+    if (found_hashed != found || found_interned != found)
+    {
+        fprintf(stderr, "Tables disagree: %ld vs %ld typedef-names found!\n", found, found_hashed);
+        return 1;
+    }
+
+    // Block-scoped typedefs: put and forget on every block
+    start = clock();
+    for (int i = 0; i < LOOKUPS / 100; ++i)
+    {
+        typedef_scope_push(&table);
+        put_typedef_name(&table, "local_t");
+        if (!is_typedef_name(&table, "local_t")) return 1;
+        typedef_scope_pop(&table);
+    }
+    double scope_time = seconds_since(start);
+
+    // Standard headers: first include in a fresh table, then repeated ones
+    start = clock();
+    for (int i = 0; i < LOOKUPS / 1000; ++i)
+    {
+        TYPEDEF_TABLE fresh;
+        init_typedef_name(&fresh, &strings);
+        for (int j = 0; j < n_headers; ++j) add_std_typedef(&fresh, headers[j]);
+        free_typedef_name(&fresh);
+    }
+    double std_first_time = seconds_since(start);
+    start = clock();
+    for (int i = 0; i < LOOKUPS / 1000; ++i)
+    {
+        for (int j = 0; j < n_headers; ++j) add_std_typedef(&table, headers[j]);
+    }
+    double std_repeated_time = seconds_since(start);
+
+    printf("typedef-names: %d, lookups: %d (found %ld)\n", linear_table_size, LOOKUPS, found);
+    printf("linear table: %.3f s, %.1f ns/lookup\n", linear_time, linear_time * 1e9 / LOOKUPS);
+    printf("hash table:   %.3f s, %.1f ns/lookup\n", hashed_time, hashed_time * 1e9 / LOOKUPS);
+    printf("interned:     %.3f s, %.1f ns/lookup\n", interned_time, interned_time * 1e9 / LOOKUPS);
+    printf("block scopes: %.3f s, %.1f ns/scope\n", scope_time, scope_time * 1e9 / (LOOKUPS / 100));
+    printf("std headers:  %.1f ns/first include, %.1f ns/repeated include\n",
+           std_first_time * 1e9 / (LOOKUPS / 1000 * n_headers), std_repeated_time * 1e9 / (LOOKUPS / 1000 * n_headers));
+    printf("speedup: %.1fx\n", hashed_time > 0 ? linear_time / hashed_time : 0.0);
+
+    free_typedef_name(&table);
+    free_intern_pool(&strings);
+    return 0;
+}
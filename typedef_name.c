@@ -6,274 +6,181 @@
  */
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "typedef_name.h"
 #include "alloc_wrap.h"
-#include "string_tools.h"
+#include "intern.h"
+#include "std_headers.h"
 
-/// typedef-name table.
-char **typedef_table;
+/// Initial capacity of typedef-name table, power of two.
+#define TYPEDEF_TABLE_INIT_SIZE 256
 
-/// Size of typedef-name table.
-int typedef_table_size = 0;
+/// Marker of a slot whose entry was removed.
+#define TYPEDEF_TOMBSTONE ((char *) &typedef_tombstone)
 
-_Bool is_typedef_name(char *id)
+/// Target of the removed slot marker.
+static char typedef_tombstone;
+
+void init_typedef_name(TYPEDEF_TABLE *table, INTERN_POOL *strings)
 {
-    if (!typedef_table_size) return false;
-    for (int i = 0; i < typedef_table_size; ++i)
-    {
-        if (str_eq(id, typedef_table[i])) return true;
-    }
-    return false;
+    memset(table, 0, sizeof(TYPEDEF_TABLE));
+    table->strings = strings;
 }
 
-void put_typedef_name(char *id)
+/// Hash of an interned name, computed from its address.
+///
+/// \param name Interned name
+/// \return Hash value
+static uint32_t name_hash(char *name)
 {
-    typedef_table = (char **) my_realloc(typedef_table,
-            sizeof(char *) * (typedef_table_size + 1),
-            "typedef-name symbol table");
-    typedef_table[typedef_table_size] = (char *) my_malloc(
-            sizeof(char) * (strlen(id) + 1),
-            "new typedef-name");
-    strcpy(typedef_table[typedef_table_size], id);
-    ++typedef_table_size;
+    uintptr_t p = (uintptr_t) name;
+    return (uint32_t) ((p >> 3) ^ (p >> 32)) * 2654435761u;
 }
 
-void free_typedef_name()
+/// Find the slot of the given typedef-name, or a free slot for it.
+///
+/// \param table Table to search in
+/// \param name Interned identifier to search for
+/// \param hash Hash of `name'
+/// \return Slot with this name, or the first free slot where it can be put
+static TYPEDEF_ENTRY *find_slot(TYPEDEF_TABLE *table, char *name, uint32_t hash)
 {
-    for (int i = 0; i < typedef_table_size; ++i)
+    uint32_t mask = table->capacity - 1;
+    TYPEDEF_ENTRY *free_slot = NULL;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask)
     {
-        free(typedef_table[i]);
+        TYPEDEF_ENTRY *slot = &table->slots[i];
+        if (!slot->name) return free_slot ? free_slot : slot;
+        if (slot->name == name) return slot;
+        if (slot->name == TYPEDEF_TOMBSTONE && !free_slot) free_slot = slot;
     }
-    free(typedef_table);
-    typedef_table_size = 0;
 }
 
-void add_std_typedef(char *header_name)
+/// Rebuild the table with the given capacity, dropping removed slots.
+///
+/// \param table Table to rebuild
+/// \param capacity New number of slots, power of two
+static void rehash(TYPEDEF_TABLE *table, uint32_t capacity)
 {
-    if (str_eq(header_name, "assert.h"))
-    {
-        // Nothing
-    }
-    else if (str_eq(header_name, "complex.h"))
-    {
-        put_typedef_name(alloc_const_str("complex"));
-        put_typedef_name(alloc_const_str("_Complex_I"));
-        put_typedef_name(alloc_const_str("imaginary"));
-        put_typedef_name(alloc_const_str("_Imaginary_I"));
-        put_typedef_name(alloc_const_str("I"));
-    }
-    else if (str_eq(header_name, "ctype.h"))
-    {
-        // Nothing
-    }
-    else if (str_eq(header_name, "errno.h"))
-    {
-        put_typedef_name(alloc_const_str("errno_t"));
-    }
-    else if (str_eq(header_name, "fenv.h"))
-    {
-        put_typedef_name(alloc_const_str("fenv_t"));
-        put_typedef_name(alloc_const_str("fexcept_t"));
-    }
-    else if (str_eq(header_name, "float.h"))
-    {
-        // Nothing
-    }
-    else if (str_eq(header_name, "inttypes.h"))
-    {
-        if (!is_typedef_name("wchar_t")) add_std_typedef("stddef.h");
-        if (!is_typedef_name("intmax_t")) add_std_typedef("stdint.h");
-        put_typedef_name(alloc_const_str("imaxdiv_t"));
-    }
-    else if (str_eq(header_name, "iso646.h"))
-    {
-        // Nothing
-    }
-    else if (str_eq(header_name, "limits.h"))
-    {
-        // Nothing
-    }
-    else if (str_eq(header_name, "locale.h"))
-    {
-        // Nothing
-    }
-    else if (str_eq(header_name, "math.h"))
-    {
-        put_typedef_name(alloc_const_str("float_t"));
-        put_typedef_name(alloc_const_str("double_t"));
-    }
-    else if (str_eq(header_name, "setjmp.h"))
-    {
-        put_typedef_name(alloc_const_str("jmp_buf"));
-    }
-    else if (str_eq(header_name, "signal.h"))
-    {
-        put_typedef_name(alloc_const_str("sig_atomic_t"));
-    }
-    else if (str_eq(header_name, "stdalign.h"))
-    {
-        put_typedef_name(alloc_const_str("alignas"));
-        put_typedef_name(alloc_const_str("alignof"));
-    }
-    else if (str_eq(header_name, "stdarg.h"))
-    {
-        put_typedef_name(alloc_const_str("va_list"));
-    }
-    else if (str_eq(header_name, "stdatomic.h"))
-    {
-        put_typedef_name(alloc_const_str("memory_order"));
-        put_typedef_name(alloc_const_str("atomic_flag"));
-        put_typedef_name(alloc_const_str("atomic_bool"));
-        put_typedef_name(alloc_const_str("atomic_char"));
-        put_typedef_name(alloc_const_str("atomic_schar"));
-        put_typedef_name(alloc_const_str("atomic_uchar"));
-        put_typedef_name(alloc_const_str("atomic_short"));
-        put_typedef_name(alloc_const_str("atomic_ushort"));
-        put_typedef_name(alloc_const_str("atomic_int"));
-        put_typedef_name(alloc_const_str("atomic_uint"));
-        put_typedef_name(alloc_const_str("atomic_long"));
-        put_typedef_name(alloc_const_str("atomic_ulong"));
-        put_typedef_name(alloc_const_str("atomic_llong"));
-        put_typedef_name(alloc_const_str("atomic_ullong"));
-        put_typedef_name(alloc_const_str("atomic_char16_t"));
-        put_typedef_name(alloc_const_str("atomic_char32_t"));
-        put_typedef_name(alloc_const_str("atomic_wchar_t"));
-        put_typedef_name(alloc_const_str("atomic_int_least8_t"));
-        put_typedef_name(alloc_const_str("atomic_uint_least8_t"));
-        put_typedef_name(alloc_const_str("atomic_int_least16_t"));
-        put_typedef_name(alloc_const_str("atomic_uint_least16_t"));
-        put_typedef_name(alloc_const_str("atomic_int_least32_t"));
-        put_typedef_name(alloc_const_str("atomic_uint_least32_t"));
-        put_typedef_name(alloc_const_str("atomic_int_least64_t"));
-        put_typedef_name(alloc_const_str("atomic_uint_least64_t"));
-        put_typedef_name(alloc_const_str("atomic_int_fast8_t"));
-        put_typedef_name(alloc_const_str("atomic_uint_fast8_t"));
-        put_typedef_name(alloc_const_str("atomic_int_fast16_t"));
-        put_typedef_name(alloc_const_str("atomic_uint_fast16_t"));
-        put_typedef_name(alloc_const_str("atomic_int_fast32_t"));
-        put_typedef_name(alloc_const_str("atomic_uint_fast32_t"));
-        put_typedef_name(alloc_const_str("atomic_int_fast64_t"));
-        put_typedef_name(alloc_const_str("atomic_uint_fast64_t"));
-        put_typedef_name(alloc_const_str("atomic_intptr_t"));
-        put_typedef_name(alloc_const_str("atomic_uintptr_t"));
-        put_typedef_name(alloc_const_str("atomic_size_t"));
-        put_typedef_name(alloc_const_str("atomic_ptrdiff_t"));
-        put_typedef_name(alloc_const_str("atomic_intmax_t"));
-        put_typedef_name(alloc_const_str("atomic_uintmax_t"));
-    }
-    else if (str_eq(header_name, "stdbool.h"))
-    {
-        put_typedef_name(alloc_const_str("bool"));
-    }
-    else if (str_eq(header_name, "stddef.h"))
-    {
-        put_typedef_name(alloc_const_str("ptrdiff_t"));
-        put_typedef_name(alloc_const_str("size_t"));
-        put_typedef_name(alloc_const_str("max_align_t"));
-        put_typedef_name(alloc_const_str("wchar_t"));
-        put_typedef_name(alloc_const_str("rsize_t"));
-    }
-    else if (str_eq(header_name, "stdint.h"))
-    {
-        put_typedef_name(alloc_const_str("int8_t"));
-        put_typedef_name(alloc_const_str("int16_t"));
-        put_typedef_name(alloc_const_str("int32_t"));
-        put_typedef_name(alloc_const_str("int64_t"));
-        put_typedef_name(alloc_const_str("uint8_t"));
-        put_typedef_name(alloc_const_str("uint16_t"));
-        put_typedef_name(alloc_const_str("uint32_t"));
-        put_typedef_name(alloc_const_str("uint64_t"));
-        put_typedef_name(alloc_const_str("int_least8_t"));
-        put_typedef_name(alloc_const_str("int_least16_t"));
-        put_typedef_name(alloc_const_str("int_least32_t"));
-        put_typedef_name(alloc_const_str("int_least64_t"));
-        put_typedef_name(alloc_const_str("uint_least8_t"));
-        put_typedef_name(alloc_const_str("uint_least16_t"));
-        put_typedef_name(alloc_const_str("uint_least32_t"));
-        put_typedef_name(alloc_const_str("uint_least64_t"));
-        put_typedef_name(alloc_const_str("int_fast8_t"));
-        put_typedef_name(alloc_const_str("int_fast16_t"));
-        put_typedef_name(alloc_const_str("int_fast32_t"));
-        put_typedef_name(alloc_const_str("int_fast64_t"));
-        put_typedef_name(alloc_const_str("uint_fast8_t"));
-        put_typedef_name(alloc_const_str("uint_fast16_t"));
-        put_typedef_name(alloc_const_str("uint_fast32_t"));
-        put_typedef_name(alloc_const_str("uint_fast64_t"));
-        put_typedef_name(alloc_const_str("intptr_t"));
-        put_typedef_name(alloc_const_str("uintptr_t"));
-        put_typedef_name(alloc_const_str("intmax_t"));
-        put_typedef_name(alloc_const_str("uintmax_t"));
-    }
-    else if (str_eq(header_name, "stdio.h"))
-    {
-        if (!is_typedef_name("errno_t")) add_std_typedef("errno.h");
-        if (!is_typedef_name("size_t")) add_std_typedef("stddef.h");
-        put_typedef_name(alloc_const_str("FILE"));
-        put_typedef_name(alloc_const_str("fpos_t"));
-    }
-    else if (str_eq(header_name, "stdlib.h"))
+    TYPEDEF_ENTRY *old = table->slots;
+    uint32_t old_capacity = table->capacity;
+    table->slots = (TYPEDEF_ENTRY *) calloc(capacity, sizeof(TYPEDEF_ENTRY));
+    if (!table->slots)
     {
-        if (!is_typedef_name("errno_t")) add_std_typedef("errno.h");
-        if (!is_typedef_name("size_t")) add_std_typedef("stddef.h");
-        put_typedef_name(alloc_const_str("div_t"));
-        put_typedef_name(alloc_const_str("ldiv_t"));
-        put_typedef_name(alloc_const_str("lldiv_t"));
-        put_typedef_name(alloc_const_str("constraint_handler_t"));
+        table->slots = old;
+        alloc_fail("typedef-name symbol table");
     }
-    else if (str_eq(header_name, "stdnoreturn.h"))
+    table->capacity = capacity;
+    table->used = 0;
+    for (uint32_t i = 0; i < old_capacity; ++i)
     {
-        put_typedef_name(alloc_const_str("noreturn"));
+        if (!old[i].name || old[i].name == TYPEDEF_TOMBSTONE) continue;
+        *find_slot(table, old[i].name, old[i].hash) = old[i];
+        ++table->used;
     }
-    else if (str_eq(header_name, "string.h"))
-    {
-        if (!is_typedef_name("errno_t")) add_std_typedef("errno.h");
-        if (!is_typedef_name("size_t")) add_std_typedef("stddef.h");
-    }
-    else if (str_eq(header_name, "tgmath.h"))
-    {
-        add_std_typedef("math.h");
-        add_std_typedef("complex.h");
-    }
-    else if (str_eq(header_name, "threads.h"))
-    {
-        put_typedef_name(alloc_const_str("thread_local"));
-        put_typedef_name(alloc_const_str("cnd_t"));
-        put_typedef_name(alloc_const_str("thrd_t"));
-        put_typedef_name(alloc_const_str("tss_t"));
-        put_typedef_name(alloc_const_str("mtx_t"));
-        put_typedef_name(alloc_const_str("tss_dtor_t"));
-        put_typedef_name(alloc_const_str("thrd_start_t"));
-        put_typedef_name(alloc_const_str("once_flag"));
-    }
-    else if (str_eq(header_name, "time.h"))
-    {
-        if (!is_typedef_name("errno_t")) add_std_typedef("errno.h");
-        if (!is_typedef_name("size_t")) add_std_typedef("stddef.h");
-        put_typedef_name(alloc_const_str("clock_t"));
-        put_typedef_name(alloc_const_str("time_t"));
-    }
-    else if (str_eq(header_name, "uchar.h"))
+    free(old);
+}
+
+/// `is_typedef_name_interned' without counting the lookup.
+static _Bool find_interned(TYPEDEF_TABLE *table, char *name)
+{
+    if (!table->size) return false;
+    unsigned char first = (unsigned char) name[0];
+    if (!(table->first_chars[first >> 6] & (UINT64_C(1) << (first & 63)))) return false;
+    return find_slot(table, name, name_hash(name))->name == name;
+}
+
+_Bool is_typedef_name_interned(TYPEDEF_TABLE *table, char *name)
+{
+    ++table->lookups;
+    return find_interned(table, name);
+}
+
+_Bool is_typedef_name(TYPEDEF_TABLE *table, char *id)
+{
+    ++table->lookups;
+    if (!table->size) return false;
+    char *name = intern_find(table->strings, id);
+    return name && find_interned(table, name);
+}
+
+void put_typedef_name(TYPEDEF_TABLE *table, char *id)
+{
+    if ((table->used + 1) * 4 > table->capacity * 3)
+    {
+        uint32_t capacity = table->capacity ? table->capacity : TYPEDEF_TABLE_INIT_SIZE;
+        if ((uint32_t) (table->size + 1) * 2 > capacity) capacity *= 2;
+        rehash(table, capacity);
+    }
+    char *name = intern_str(table->strings, id);
+    uint32_t hash = name_hash(name);
+    TYPEDEF_ENTRY *slot = find_slot(table, name, hash);
+    if (slot->name == name) return;  // Repetition
+    if (!slot->name) ++table->used;
+    *slot = (TYPEDEF_ENTRY) {name, hash};
+    ++table->size;
+    unsigned char first = (unsigned char) name[0];
+    table->first_chars[first >> 6] |= UINT64_C(1) << (first & 63);
+
+    if (table->scope_depth > 0)
     {
-        if (!is_typedef_name("mbstate_t")) add_std_typedef("wchar.h");
-        if (!is_typedef_name("size_t")) add_std_typedef("stddef.h");
-        put_typedef_name(alloc_const_str("char16_t"));
-        put_typedef_name(alloc_const_str("char32_t"));
+        if (table->scope_log_size == table->scope_log_capacity)
+        {
+            table->scope_log_capacity = table->scope_log_capacity ? table->scope_log_capacity * 2 : 16;
+            table->scope_log = (char **) my_realloc(table->scope_log,
+                    sizeof(char *) * table->scope_log_capacity, "typedef-name scope");
+        }
+        table->scope_log[table->scope_log_size++] = name;
     }
-    else if (str_eq(header_name, "wchar.h"))
+}
+
+void typedef_scope_push(TYPEDEF_TABLE *table)
+{
+    if (table->scope_depth == table->scopes_capacity)
     {
-        if (!is_typedef_name("errno_t")) add_std_typedef("errno.h");
-        if (!is_typedef_name("size_t")) add_std_typedef("stddef.h");
-        if (!is_typedef_name("FILE")) add_std_typedef("stdio.h");
-        put_typedef_name(alloc_const_str("mbstate_t"));
-        put_typedef_name(alloc_const_str("wint_t"));
+        table->scopes_capacity = table->scopes_capacity ? table->scopes_capacity * 2 : 16;
+        table->scopes = (int *) my_realloc(table->scopes,
+                sizeof(int) * table->scopes_capacity, "typedef-name scope");
     }
-    else if (str_eq(header_name, "wctype.h"))
+    table->scopes[table->scope_depth++] = table->scope_log_size;
+}
+
+void typedef_scope_pop(TYPEDEF_TABLE *table)
+{
+    if (table->scope_depth == 0) return;
+    int begin = table->scopes[--table->scope_depth];
+    while (table->scope_log_size > begin)
     {
-        if (!is_typedef_name("wint_t")) add_std_typedef("wchar.h");
-        put_typedef_name(alloc_const_str("wctrans_t"));
-        put_typedef_name(alloc_const_str("wctype_t"));
+        char *name = table->scope_log[--table->scope_log_size];
+        find_slot(table, name, name_hash(name))->name = TYPEDEF_TOMBSTONE;
+        --table->size;
     }
 }
+
+void free_typedef_name(TYPEDEF_TABLE *table)
+{
+    free(table->slots);
+    my_free(table->scope_log);
+    my_free(table->scopes);
+    init_typedef_name(table, table->strings);
+}
+
+void add_std_typedef(TYPEDEF_TABLE *table, char *header_name)
+{
+    int header = std_header_find(header_name);
+    if (header < 0) return;
+    uint32_t missing = std_header_closures[header] & ~table->std_headers;
+    for (int h = 0; h < STD_HEADERS_NUMBER; ++h)
+    {
+        if (!(missing & (UINT32_C(1) << h))) continue;
+        for (int i = std_header_typedefs_begin[h]; i < std_header_typedefs_begin[h + 1]; ++i)
+        {
+            put_typedef_name(table, (char *) std_header_typedefs[i]);
+        }
+    }
+    // Names put in a block scope are forgotten with it, so the header may be needed again
+    if (table->scope_depth == 0) table->std_headers |= missing;
+}
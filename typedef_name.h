@@ -8,24 +8,97 @@
 #ifndef C_PARSER_TYPEDEF_NAME_H_H_INCLUDED
 #define C_PARSER_TYPEDEF_NAME_H_H_INCLUDED
 
+#include <stdint.h>
+#include "intern.h"
+
+/// Entry of typedef-name table. Names are interned, so they are compared by address.
+typedef struct
+{
+    char *name;
+    uint32_t hash;
+}
+TYPEDEF_ENTRY;
+
+/// typedef-name symbol table with block scopes.
+typedef struct
+{
+    /// Slots (open addressing, linear probing)
+    TYPEDEF_ENTRY *slots;
+    /// Number of slots
+    uint32_t capacity;
+    /// Number of typedef-names in the table
+    int size;
+    /// Number of lookups made in the table
+    size_t lookups;
+    /// Number of occupied slots (typedef-names and removed ones)
+    uint32_t used;
+    /// First characters of typedef-names ever put, one bit per character
+    uint64_t first_chars[4];
+    /// typedef-names put in block scopes, in order of declaration
+    char **scope_log;
+    int scope_log_size;
+    int scope_log_capacity;
+    /// For each opened block scope, size of `scope_log' at its beginning
+    int *scopes;
+    int scope_depth;
+    int scopes_capacity;
+    /// Standard headers already applied at file scope, bit per header (see `std_headers.h')
+    uint32_t std_headers;
+    /// Pool the names are interned in
+    INTERN_POOL *strings;
+}
+TYPEDEF_TABLE;
+
+/// Initialize an empty typedef-name table.
+///
+/// \param table Table to initialize
+/// \param strings Pool to intern the names in
+void init_typedef_name(TYPEDEF_TABLE *table, INTERN_POOL *strings);
+
 /// Is given identifier - typedef-name?
 ///
+/// \param table Table to search in
 /// \param id Identifier to check
 /// \return `true' - there is such typedef-name table entry, `false' - otherwise
-_Bool is_typedef_name(char *id);
+_Bool is_typedef_name(TYPEDEF_TABLE *table, char *id);
 
-/// Put this string into typedef-name symbol table. Repetitions allowed.
+/// Is given interned identifier (see `intern_str') - typedef-name?
+/// Faster than `is_typedef_name', names are compared by address.
 ///
+/// \param table Table to search in
+/// \param name Interned identifier to check
+/// \return `true' - there is such typedef-name table entry, `false' - otherwise
+_Bool is_typedef_name_interned(TYPEDEF_TABLE *table, char *name);
+
+/// Put this string into typedef-name symbol table (it is interned). Repetitions allowed.
+/// Inside of a block scope, the name is forgotten when the scope is closed.
+///
+/// \param table Table to put to
 /// \param id Identifier to put to the typedef-name table
-void put_typedef_name(char *id);
+void put_typedef_name(TYPEDEF_TABLE *table, char *id);
+
+/// Open a new block scope for typedef-names.
+///
+/// \param table Table to open the scope in
+void typedef_scope_push(TYPEDEF_TABLE *table);
+
+/// Close the innermost block scope, removing typedef-names declared in it.
+///
+/// \param table Table to close the scope in
+void typedef_scope_pop(TYPEDEF_TABLE *table);
 
 /// Free memory allocated by typedef-name symbol table.
-void free_typedef_name();
+/// Interned names stay in the pool.
+///
+/// \param table Table to free
+void free_typedef_name(TYPEDEF_TABLE *table);
 
-/// Add typedef-name units from the specified header.
-/// NOTE: Supported only ones from the ISO/IEC 9899:2018, Section 7.
+/// Add typedef-name units from the specified header and the ones it depends on.
+/// Repeated headers cost nothing.
+/// NOTE: Supported only ones from the ISO/IEC 9899:2018, Section 7 (see `gen_std_headers.c').
 ///
+/// \param table Table to put to
 /// \param header_name Name of the header to add typedef-names from
-void add_std_typedef(char *header_name);
+void add_std_typedef(TYPEDEF_TABLE *table, char *header_name);
 
 #endif //C_PARSER_TYPEDEF_NAME_H_H_INCLUDED
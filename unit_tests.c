@@ -5,11 +5,25 @@
  * @authors: Denis Chernikov, Vladislav Kuleykin
  */
 
+#include <locale.h>
+#include <setjmp.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc_wrap.h"
 #include "ast.h"
+#include "ast_binary.h"
+#include "header_cache.h"
+#include "intern.h"
+#include "result_cache.h"
+#include "source_map.h"
 #include "string_tools.h"
+#include "thread_pool.h"
 #include "typedef_name.h"
+#include "writer.h"
 
 /// Conversion function for AST node content.
 /// Copied from `main.c'.
@@ -18,7 +32,27 @@
 /// \return String representation of the given object, NULL if not AST_NODE
 char *content_to_str(AST_NODE *node)
 {
-    return alloc_const_str((char *) node->content);
+    return alloc_const_str((char *) node->content.value);
+}
+
+/// Create an instance of AST_CONTENT with a `value' inside.
+#define content_v(v)  ((AST_CONTENT) {.value = v})
+
+/// Sink of a writer for tests: appends the bytes to a memory writer, refuses them if it is NULL.
+static _Bool test_sink(void *arg, const char *data, size_t len)
+{
+    if (!arg) return false;
+    writer_put((WRITER *) arg, data, len);
+    return true;
+}
+
+/// Job of a thread pool for tests: allocates 100 bytes.
+static void alloc_job(size_t job, int worker, void *arg)
+{
+    (void) job;
+    (void) worker;
+    (void) arg;
+    my_free(my_malloc(100, "test job"));
 }
 
 int passed = 0;
@@ -77,33 +111,91 @@ int main()
          "wrap_by_quotes(\"\\\" \\\\ \\b \\f \\n \\r \\t\")");
     pass_test(str_eq(wrap_by_quotes(NULL), NULL), "wrap_by_quotes(NULL)");
     pass_test(str_eq(wrap_by_quotes(""), "\"\""), "wrap_by_quotes(\"\")");
+    pass_test(str_eq(wrap_by_quotes("\x01" "a\x1f\x7f\xc3\xa9"), "\"\\u0001a\\u001f\x7f\xc3\xa9\""),
+         "wrap_by_quotes(\"\\x01a\\x1f\\x7f\\xc3\\xa9\")");
+
+    // Test `json_escape': a byte to escape at every position of a string longer than a vector
+    char escape_src[100], escape_dst[JSON_ESCAPED_MAX(100)];
+    _Bool escape_ok = true;
+    for (int i = 0; i < 100; ++i)
+    {
+        memset(escape_src, 0xA0, sizeof(escape_src));
+        escape_src[i] = i % 2 ? '\n' : '\x10';
+        size_t escaped = json_escape(escape_dst, escape_src, sizeof(escape_src));
+        const char *expected = i % 2 ? "\\n" : "\\u0010";
+        size_t expected_len = strlen(expected);
+        escape_ok &= escaped == 99 + expected_len && memcmp(escape_dst, escape_src, (size_t) i) == 0
+            && memcmp(escape_dst + i, expected, expected_len) == 0
+            && memcmp(escape_dst + i + expected_len, escape_src + i + 1, (size_t) (99 - i)) == 0;
+    }
+    pass_test(escape_ok, "json_escape() of a byte at every position");
+
+    // Test `intern_str'
+    INTERN_POOL strings;
+    init_intern_pool(&strings);
+    char interned_buf[] = "ident";
+    char *interned = intern_str(&strings, "ident");
+    pass_test(intern_str(&strings, interned_buf) == interned, "intern_str(\"ident\") == intern_str(interned_buf)");
+    pass_test(interned != interned_buf && str_eq(interned, "ident"), "intern_str(\"ident\") is a copy");
+    pass_test(intern_find(&strings, "ident") == interned && intern_find(&strings, "other") == NULL, "intern_find(\"ident\")");
+    size_t distinct, occurrences;
+    intern_stats(&strings, &distinct, &occurrences, NULL);
+    pass_test(distinct == 1 && occurrences == 2, "intern_stats(&distinct, &occurrences, NULL)");
 
     // Test `is_typedef_name'
-    put_typedef_name("a");
-    pass_test(is_typedef_name("a"), "put_typedef_name(\"a\");\nis_typedef_name(\"a\")");
-    pass_test(!is_typedef_name("b"), "put_typedef_name(\"a\");\nis_typedef_name(\"b\")");
-    add_std_typedef("math.h");
-    pass_test(is_typedef_name("float_t"), "add_std_typedef(\"math.h\");\nis_typedef_name(\"float_t\")");
-    pass_test(!is_typedef_name("real_t"), "add_std_typedef(\"math.h\");\nis_typedef_name(\"real_t\")");
+    TYPEDEF_TABLE typedefs;
+    init_typedef_name(&typedefs, &strings);
+    put_typedef_name(&typedefs, "a");
+    pass_test(is_typedef_name(&typedefs, "a"), "put_typedef_name(\"a\");\nis_typedef_name(\"a\")");
+    pass_test(!is_typedef_name(&typedefs, "b"), "put_typedef_name(\"a\");\nis_typedef_name(\"b\")");
+    add_std_typedef(&typedefs, "math.h");
+    pass_test(is_typedef_name(&typedefs, "float_t"), "add_std_typedef(\"math.h\");\nis_typedef_name(\"float_t\")");
+    pass_test(!is_typedef_name(&typedefs, "real_t"), "add_std_typedef(\"math.h\");\nis_typedef_name(\"real_t\")");
+    typedef_scope_push(&typedefs);
+    put_typedef_name(&typedefs, "local_t");
+    put_typedef_name(&typedefs, "a");
+    pass_test(is_typedef_name(&typedefs, "local_t"), "typedef_scope_push();\nput_typedef_name(\"local_t\");\nis_typedef_name(\"local_t\")");
+    typedef_scope_pop(&typedefs);
+    pass_test(!is_typedef_name(&typedefs, "local_t"), "typedef_scope_pop();\n!is_typedef_name(\"local_t\")");
+    pass_test(is_typedef_name(&typedefs, "a"), "typedef_scope_pop();\nis_typedef_name(\"a\") declared outside is kept");
+    pass_test(is_typedef_name_interned(&typedefs, intern_str(&strings, "a")), "is_typedef_name_interned(intern_str(\"a\"))");
+    add_std_typedef(&typedefs, "stdio.h");
+    pass_test(is_typedef_name(&typedefs, "FILE") && is_typedef_name(&typedefs, "size_t")
+              && is_typedef_name(&typedefs, "errno_t"),
+        "add_std_typedef(\"stdio.h\");\nis_typedef_name(\"size_t\") from its dependency");
+    int typedefs_size = typedefs.size;
+    add_std_typedef(&typedefs, "stdio.h");
+    add_std_typedef(&typedefs, "stddef.h");
+    add_std_typedef(&typedefs, "unknown.h");
+    pass_test(typedefs.size == typedefs_size, "add_std_typedef(\"stdio.h\") again adds nothing");
+    free_typedef_name(&typedefs);
+    pass_test(!is_typedef_name(&typedefs, "a"), "free_typedef_name();\n!is_typedef_name(\"a\")");
+    TYPEDEF_TABLE other_typedefs;
+    init_typedef_name(&other_typedefs, &strings);
+    put_typedef_name(&other_typedefs, "b");
+    pass_test(is_typedef_name(&other_typedefs, "b") && !is_typedef_name(&typedefs, "b"),
+        "put_typedef_name(&other_typedefs, \"b\");\n!is_typedef_name(&typedefs, \"b\")");
+    free_typedef_name(&other_typedefs);
+    free_intern_pool(&strings);
 
     // Test `ast_create_node'
-    AST_NODE *node1 = ast_create_node(Identifier, "node1", 0);
+    AST_NODE *node1 = ast_create_node(NULL, Identifier, content_v("node1"), 0);
     pass_test(node1->type == Identifier,
         "ast_create_node(Identifier, \"node1\", 0); node1->type == Identifier;");
-    pass_test(str_eq(node1->content, "node1"),
+    pass_test(str_eq(node1->content.value, "node1"),
         "ast_create_node(Identifier, \"node1\", 0); node1->content == \"node1\";");
     pass_test(node1->children_number == 0,
         "ast_create_node(Identifier, \"node1\", 0); node1->children_number == 0;");
     pass_test(node1->children == NULL,
         "ast_create_node(Identifier, \"node1\", 0); node1->children == NULL;");
-    AST_NODE *node2 = ast_create_node(Identifier, "node2", 1, node1);
+    AST_NODE *node2 = ast_create_node(NULL, Identifier, content_v("node2"), 1, node1);
     pass_test(node2->children_number == 1,
         "ast_create_node(Identifier, \"node2\", 1, node1); node2->children_number == 1;");
     pass_test(node2->children != NULL,
         "ast_create_node(Identifier, \"node2\", 1, node1); node2->children != NULL;");
     pass_test(node2->children[0] == node1,
         "ast_create_node(Identifier, \"node2\", 1, node1); node2->children[0] == node1;");
-    AST_NODE *node3 = ast_create_node(Identifier, "node3", 2, node1, node2);
+    AST_NODE *node3 = ast_create_node(NULL, Identifier, content_v("node3"), 2, node1, node2);
     pass_test(node3->children_number == 2,
         "ast_create_node(Identifier, \"node3\", 2, node1, node2); node3->children_number == 2;");
     pass_test(node3->children != NULL,
@@ -114,48 +206,71 @@ int main()
         "ast_create_node(Identifier, \"node3\", 2, node1, node2); node3->children[1] == node2;");
 
     // Test `ast_expand_node'
-    AST_NODE* ast_node = ast_create_node(TranslationUnit, NULL, 0);
-    AST_NODE* ast_node_to_add = ast_create_node(TranslationUnit, NULL, 0);
-    AST_NODE* ast_node_expanded = ast_create_node(TranslationUnit, NULL, 0);
-    ast_expand_node(ast_node_expanded, ast_node_to_add);
-    pass_test(ast_expand_node(ast_node, ast_node_to_add)->type == ast_node_expanded->type,
+    AST_NODE* ast_node = ast_create_node(NULL, TranslationUnit, content_v(NULL), 0);
+    AST_NODE* ast_node_to_add = ast_create_node(NULL, TranslationUnit, content_v(NULL), 0);
+    AST_NODE* ast_node_expanded = ast_create_node(NULL, TranslationUnit, content_v(NULL), 0);
+    ast_expand_node(NULL, ast_node_expanded, ast_node_to_add);
+    pass_test(ast_expand_node(NULL, ast_node, ast_node_to_add)->type == ast_node_expanded->type,
         "AST_NODE* ast_node = ast_create_node(TranslationUnit, NULL, 0);\n"
         "AST_NODE* ast_node_to_add = ast_create_node(TranslationUnit, NULL, 0);\n"
         "AST_NODE* ast_node_expanded = ast_expand_node(ast_node, ast_node_to_add);\n"
         "ast_expand_node(ast_node, ast_node_to_add)->type == ast_node_expanded->type");
-    ast_node = ast_create_node(TranslationUnit, NULL, 0);
-    pass_test(ast_expand_node(ast_node, ast_node_to_add)->content == ast_node_expanded->content,
+    ast_node = ast_create_node(NULL, TranslationUnit, content_v(NULL), 0);
+    pass_test(ast_expand_node(NULL, ast_node, ast_node_to_add)->content.value == ast_node_expanded->content.value,
         "AST_NODE* ast_node = ast_create_node(TranslationUnit, NULL, 0);\n"
         "AST_NODE* ast_node_to_add = ast_create_node(TranslationUnit, NULL, 0);\n"
         "AST_NODE* ast_node_expanded = ast_expand_node(ast_node, ast_node_to_add);\n"
         "ast_expand_node(ast_node, ast_node_to_add)->content == ast_node_expanded->content");
-    ast_node = ast_create_node(TranslationUnit, NULL, 0);
-    pass_test(ast_expand_node(ast_node, ast_node_to_add)->children_number == ast_node_expanded->children_number,
+    ast_node = ast_create_node(NULL, TranslationUnit, content_v(NULL), 0);
+    pass_test(ast_expand_node(NULL, ast_node, ast_node_to_add)->children_number == ast_node_expanded->children_number,
         "AST_NODE* ast_node = ast_create_node(TranslationUnit, NULL, 0);\n"
         "AST_NODE* ast_node_to_add = ast_create_node(TranslationUnit, NULL, 0);\n"
         "AST_NODE* ast_node_expanded = ast_expand_node(ast_node, ast_node_to_add);\n"
         "ast_expand_node(ast_node, ast_node_to_add)->children_number == ast_node_expanded->children_number");
-    ast_node = ast_create_node(TranslationUnit, NULL, 0);
-    pass_test(ast_expand_node(ast_node, ast_node_to_add)->children == ast_node->children,
+    ast_node = ast_create_node(NULL, TranslationUnit, content_v(NULL), 0);
+    pass_test(ast_expand_node(NULL, ast_node, ast_node_to_add)->children == ast_node->children,
         "AST_NODE* ast_node = ast_create_node(TranslationUnit, NULL, 0);\n"
         "AST_NODE* ast_node_to_add = ast_create_node(TranslationUnit, NULL, 0);\n"
         "AST_NODE* ast_node_expanded = ast_expand_node(ast_node, ast_node_to_add);\n"
         "ast_expand_node(ast_node, ast_node_to_add)->children == ast_node->children");
-    pass_test(ast_expand_node(NULL, ast_node_to_add) == NULL,
+    pass_test(ast_expand_node(NULL, NULL, ast_node_to_add) == NULL,
         "AST_NODE* ast_node = ast_create_node(TranslationUnit, NULL, 0);\n"
         "AST_NODE* ast_node_to_add = ast_create_node(TranslationUnit, NULL, 0);\n"
         "ast_expand_node(NULL, ast_node_to_add) == NULL");
-    ast_node = ast_create_node(TranslationUnit, NULL, 0);
-    pass_test(ast_expand_node(ast_node, NULL)->children_number == 0,
+    ast_node = ast_create_node(NULL, TranslationUnit, content_v(NULL), 0);
+    pass_test(ast_expand_node(NULL, ast_node, NULL)->children_number == 0,
         "AST_NODE* ast_node = ast_create_node(TranslationUnit, NULL, 0);\n"
         "AST_NODE* ast_node_to_add = ast_create_node(TranslationUnit, NULL, 0);\n"
         "ast_expand_node(ast_node, NULL)->children_number == 0");
-    ast_node = ast_create_node(TranslationUnit, NULL, 0);
-    pass_test(ast_expand_node(ast_node, NULL)->children == NULL,
+    ast_node = ast_create_node(NULL, TranslationUnit, content_v(NULL), 0);
+    pass_test(ast_expand_node(NULL, ast_node, NULL)->children == NULL,
         "AST_NODE* ast_node = ast_create_node(TranslationUnit, NULL, 0);\n"
         "AST_NODE* ast_node_to_add = ast_create_node(TranslationUnit, NULL, 0);\n"
         "ast_expand_node(ast_node, NULL)->children == NULL");
 
+    // Test arena allocator
+    ARENA arena;
+    arena_init(&arena);
+    char *chunk1 = (char *) arena_alloc(&arena, 3, "test chunk");
+    char *chunk2 = (char *) arena_alloc(&arena, 5, "test chunk");
+    pass_test(chunk2 > chunk1 && (size_t) (chunk2 - chunk1) % _Alignof(max_align_t) == 0,
+        "arena_alloc(&arena, 3, ...); arena_alloc(&arena, 5, ...); aligned and ordered");
+    pass_test(arena.used >= 8 && arena.reserved == ARENA_BLOCK_SIZE,
+        "arena.used >= 8 && arena.reserved == ARENA_BLOCK_SIZE");
+    pass_test(arena_grow(&arena, chunk2, 5, 100, "test chunk") == chunk2,
+        "arena_grow(&arena, chunk2, 5, 100, ...) == chunk2");
+    chunk1[0] = 'x';
+    pass_test(*(char *) arena_grow(&arena, chunk1, 3, 100, "test chunk") == 'x',
+        "arena_grow(&arena, chunk1, 3, 100, ...) copies content");
+    ast_node = ast_create_node(&arena, TranslationUnit, content_v(NULL), 0);
+    for (int i = 0; i < 5; ++i) ast_expand_node(&arena, ast_node, i % 2 ? node1 : node2);
+    pass_test(ast_node->children_number == 5 && ast_node->children[3] == node1 && ast_node->children[4] == node2,
+        "5 x ast_expand_node(&arena, ast_node, ...); children are kept in order");
+    arena_reset(&arena);
+    pass_test(arena.used == 0 && arena.reserved == ARENA_BLOCK_SIZE, "arena_reset(&arena); arena.used == 0");
+    arena_free(&arena);
+    pass_test(arena.head == NULL && arena.reserved == 0, "arena_free(&arena); arena.head == NULL");
+
     // Test `ast_type_to_str'
     pass_test(str_eq(ast_type_to_str(TranslationUnit), "TranslationUnit"), "ast_type_to_str(TranslationUnit)");
     pass_test(str_eq(ast_type_to_str(-1),NULL), "ast_type_to_str(-1)");
@@ -177,6 +292,392 @@ int main()
                   "        }";
     pass_test(str_eq(ast_to_json(node1, 2, "    ", content_to_str), json2),
               "ast_to_json(node1, 2, \"    \", content_to_str)");
+    char *json3 = "{\n"
+                  "    \"type\": \"Identifier\",\n"
+                  "    \"content\": \"node2\",\n"
+                  "    \"children_number\": 1,\n"
+                  "    \"children\": [\n"
+                  "        {\n"
+                  "            \"type\": \"Identifier\",\n"
+                  "            \"content\": \"node1\",\n"
+                  "            \"children_number\": 0,\n"
+                  "            \"children\": null\n"
+                  "        }\n"
+                  "    ]\n"
+                  "}";
+    pass_test(str_eq(ast_to_json(node2, 0, "    ", content_to_str), json3),
+              "ast_to_json(node2, 0, \"    \", content_to_str)");
+
+    // Test `ast_write_json'
+    WRITER writer;
+    writer_init_buffer(&writer);
+    writer_puts(&writer, "[");
+    ast_write_json(&writer, node1, 0, "    ", content_to_str);
+    writer_putc(&writer, ']');
+    char *json4 = writer_release(&writer);
+    pass_test(json4[0] == '[' && str_eq(json4 + 1, "{\n"
+                                                   "    \"type\": \"Identifier\",\n"
+                                                   "    \"content\": \"node1\",\n"
+                                                   "    \"children_number\": 0,\n"
+                                                   "    \"children\": null\n"
+                                                   "}]"),
+              "writer_puts(&writer, \"[\"); ast_write_json(&writer, node1, 0, \"    \", content_to_str)");
+
+    // Constants pointing into the source: only `length' bytes are written
+    AST_NODE *slice_node = ast_create_node(NULL, IntegerConstant, content_v("0x1Fu;\nint"), 0);
+    slice_node->length = 5;
+    writer_init_buffer(&writer);
+    ast_write_json_line(&writer, slice_node, content_to_str);
+    char *slice_json = writer_release(&writer);
+    pass_test(str_eq(slice_json, "{\"type\":\"IntegerConstant\",\"content\":\"0x1Fu\",\"children_number\":0,"
+                                 "\"children\":null}"), "ast_write_json_line(&writer, slice_node, content_to_str)");
+    free(slice_json);
+    writer_init_buffer(&writer);
+    ast_write_binary(&writer, slice_node, content_to_str);
+    AST_BIN slice_bin;
+    _Bool slice_loaded = ast_bin_load(&slice_bin, writer.buf, writer.len);
+    pass_test(slice_loaded && str_eq((char *) ast_bin_content(&slice_bin, slice_bin.header->root), "0x1Fu"),
+              "ast_write_binary(&writer, slice_node, content_to_str)");
+    free(writer_release(&writer));
+    free(slice_node);
+    pass_test(str_hash_len("0x1Fu;", 5) == str_hash("0x1Fu", NULL), "str_hash_len(\"0x1Fu;\", 5)");
+
+    // Test `literal_decode': escapes, trigraphs and splices of literal spellings
+    const char *spelling = "a\\n\\101\\x42?\?/t\\u00e9\\\nz\\0";
+    char value[32];
+    size_t value_chars = 0;
+    size_t value_len = literal_decode(spelling, strlen(spelling), value, &value_chars);
+    pass_test(value_len == 9 && value_chars == 8 && !memcmp(value, "a\nAB\t\xc3\xa9z", 9) && value[8] == '\0',
+              "literal_decode(\"a\\\\n\\\\101\\\\x42?\?/t\\\\u00e9\\\\\\nz\\\\0\")");
+    value_len = literal_decode("\\x80\\xff\\377a", 13, value, &value_chars);
+    pass_test(value_len == 7 && value_chars == 4 && !memcmp(value, "\xc2\x80\xc3\xbf\xc3\xbf" "a", 7),
+              "literal_decode(\"\\\\x80\\\\xff\\\\377a\")");
+    pass_test(literal_decode("\\q", 2, NULL, NULL) == LITERAL_INVALID
+              && literal_decode("\\u0041", 6, NULL, NULL) == LITERAL_INVALID
+              && literal_decode("\\x110000", 8, NULL, NULL) == LITERAL_INVALID
+              && literal_decode("\\400", 4, NULL, NULL) == LITERAL_INVALID,
+              "literal_decode of invalid escapes");
+    pass_test(!literal_has_escapes("a?b?\?c", 6) && literal_has_escapes("?\?=", 3) && literal_has_escapes("\\\\", 2),
+              "literal_has_escapes");
+    AST_NODE *literal = ast_create_node(NULL, StringLiteral, content_v("\\x41\\tb\";"), 0);
+    literal->length = 7;
+    writer_init_buffer(&writer);
+    ast_write_json_line(&writer, literal, content_to_str);
+    char *literal_json = writer_release(&writer);
+    pass_test(str_eq(literal_json, "{\"type\":\"StringLiteral\",\"content\":\"A\\tb\",\"children_number\":0,"
+                                   "\"children\":null}"), "ast_write_json_line(&writer, literal, content_to_str)");
+    free(literal_json);
+    free(literal);
+
+    // Test `constant_convert': types by suffix and value, ISO/IEC 9899:2017, page 46
+    CONSTANT_VALUE constant;
+    pass_test(constant_convert("0x1Fu", 5, false, &constant) && constant.type == CONSTANT_UNSIGNED_INT
+              && constant.integer == 31, "constant_convert(\"0x1Fu\")");
+    pass_test(constant_convert("2147483648", 10, false, &constant) && constant.type == CONSTANT_LONG
+              && constant.integer == 2147483648u, "constant_convert(\"2147483648\")");
+    pass_test(constant_convert("0xFFFFFFFF", 10, false, &constant) && constant.type == CONSTANT_UNSIGNED_INT,
+              "constant_convert(\"0xFFFFFFFF\")");
+    pass_test(!constant_convert("18446744073709551616", 20, false, &constant)
+              && !constant_convert("08", 2, false, &constant) && !constant_convert("1lL", 3, false, &constant),
+              "constant_convert of constants without a type");
+    char constant_json[CONSTANT_JSON_MAX];
+    pass_test(constant_convert("1.5e-3f", 7, true, &constant) && constant.type == CONSTANT_FLOAT
+              && constant_to_json(&constant, constant_json) == 6 && str_eq(constant_json, "0.0015"),
+              "constant_convert(\"1.5e-3f\")");
+    pass_test(constant_convert("0x1.8p3", 7, true, &constant) && constant.type == CONSTANT_DOUBLE
+              && constant.real == 12 && !constant_convert("1e999", 5, true, &constant),
+              "constant_convert(\"0x1.8p3\")");
+    _Bool comma_locale = setlocale(LC_NUMERIC, "de_DE.UTF-8") || setlocale(LC_NUMERIC, "fr_FR.UTF-8")
+                         || setlocale(LC_NUMERIC, "ru_RU.UTF-8");
+    pass_test(constant_convert("2.5", 3, true, &constant) && constant.real == 2.5
+              && constant_to_json(&constant, constant_json) == 3 && str_eq(constant_json, "2.5"),
+              comma_locale ? "constant_convert(\"2.5\") in a locale with a decimal comma" : "constant_convert(\"2.5\")");
+    setlocale(LC_NUMERIC, "C");
+
+    // Test typed constants: the stored value is written after the content
+    CONSTANT_VALUE stored = {CONSTANT_LONG, {.integer = 10}};
+    AST_NODE *typed = ast_create_value_node(NULL, IntegerConstant, content_v("10l"), &stored);
+    writer_init_buffer(&writer);
+    writer.typed_constants = true;
+    ast_write_json_line(&writer, typed, content_to_str);
+    char *typed_json = writer_release(&writer);
+    pass_test(ast_constant_value(typed)->integer == 10
+              && str_eq(typed_json, "{\"type\":\"IntegerConstant\",\"content\":\"10l\",\"value\":10,"
+                                    "\"value_type\":\"long\",\"children_number\":0,\"children\":null}"),
+              "ast_write_json_line(&writer, typed, content_to_str)");
+    free(typed_json);
+    free(typed);
+
+    // Test `ast_write_json_parallel': same bytes as `ast_write_json'
+    ARENA big_arena;
+    arena_init(&big_arena);
+    AST_NODE *big_tree = ast_create_node(&big_arena, TranslationUnit, content_v(NULL), 0);
+    for (int i = 0; i < 3000; ++i)
+    {
+        AST_NODE *chain = ast_create_node(&big_arena, Identifier, content_v("x\"y"), 0);
+        for (int j = 0; j < 30; ++j) chain = ast_create_node(&big_arena, Identifier, content_v("z"), 2, chain, NULL);
+        ast_expand_node(&big_arena, big_tree, chain);
+    }
+    WRITER parallel_writer;
+    writer_init_buffer(&parallel_writer);
+    ast_write_json_parallel(&parallel_writer, big_tree, 1, "  ", content_to_str, 4);
+    char *parallel_json = writer_release(&parallel_writer);
+    pass_test(str_eq(parallel_json, ast_to_json(big_tree, 1, "  ", content_to_str)),
+              "ast_write_json_parallel(&parallel_writer, big_tree, 1, \"  \", content_to_str, 4)");
+    arena_free(&big_arena);
+
+    // Test `thread_pool_run': allocations of the worker threads are counted by the calling one
+    ALLOC_COUNTERS pool_allocations = alloc_counters;
+    thread_pool_run(16, 4, &alloc_job, NULL);
+    pass_test(alloc_counters.calls - pool_allocations.calls >= 16
+              && alloc_counters.bytes - pool_allocations.bytes >= 1600,
+              "thread_pool_run(16, 4, &alloc_job, NULL); alloc_counters");
+
+    // Test `ast_write_json_line' and `ast_stream_collect'
+    WRITER line_writer;
+    writer_init_buffer(&line_writer);
+    ast_write_json_line(&line_writer, node2, content_to_str);
+    char *line = "{\"type\":\"Identifier\",\"content\":\"node2\",\"children_number\":1,\"children\":["
+                 "{\"type\":\"Identifier\",\"content\":\"node1\",\"children_number\":0,\"children\":null}]}";
+    pass_test(str_eq(writer_release(&line_writer), line), "ast_write_json_line(&line_writer, node2, content_to_str)");
+    ARENA scratch;
+    arena_init(&scratch);
+    AST_NODE *scratch_node = ast_create_node(&scratch, Identifier, content_v("node1"), 0);
+    writer_init_buffer(&line_writer);
+    AST_STREAM stream = {&line_writer, content_to_str, 0};
+    AST_NODE *lookahead = ast_create_node(&scratch, StringLiteral, content_v(ast_alloc_str(&scratch, "next")), 0);
+    size_t scratch_used = scratch.used;
+    ast_stream_collect(&stream, &scratch, scratch_node, &lookahead);
+    pass_test(scratch.used > 0 && scratch.used < scratch_used && lookahead->type == StringLiteral
+              && str_eq(lookahead->content.value, "next"),
+              "ast_stream_collect(&stream, &scratch, scratch_node, &lookahead); lookahead moved");
+    scratch_node = ast_create_node(&scratch, Identifier, content_v("node1"), 0);
+    ast_stream_collect(&stream, &scratch, scratch_node, NULL);
+    char *line1 = "{\"type\":\"Identifier\",\"content\":\"node1\",\"children_number\":0,\"children\":null}\n";
+    pass_test(scratch.used == 0 && stream.declarations == 2
+              && str_eq(writer_release(&line_writer), concat_array((char *[]) {line1, line1}, 2, "")),
+        "ast_stream_collect(&stream, &scratch, scratch_node, NULL); arena reset");
+    arena_free(&scratch);
+
+    // Test flat AST
+    AST_FLAT flat;
+    ast_flat_init(&flat);
+    AST_ID flat_id = ast_flat_append(&flat, node2);
+    pass_test(flat_id == 1 && flat.types[1] == Identifier && flat.children_number[1] == 1
+              && flat.children[flat.first_child[1]] == 2,
+        "ast_flat_append(&flat, node2); node2 is 1, node1 is its child 2");
+    ast_flat_append(&flat, node1);
+    pass_test(ast_flat_finish(&flat) == 0 && flat.children_number[0] == 2 && flat.nodes_number == 4,
+        "ast_flat_finish(&flat) == 0; root has 2 children");
+    WRITER flat_writer;
+    writer_init_buffer(&flat_writer);
+    ast_flat_write_json(&flat_writer, &flat, flat_id, 0, "    ", content_to_str);
+    pass_test(str_eq(writer_release(&flat_writer), json3),
+        "ast_flat_write_json(&flat_writer, &flat, flat_id, 0, \"    \", content_to_str)");
+    size_t node_counts[AST_NODE_TYPES_NUMBER] = {0};
+    ast_count_nodes(node2, node_counts);
+    pass_test(node_counts[Identifier] == 2 && node_counts[TranslationUnit] == 0, "ast_count_nodes(node2, node_counts)");
+    ast_flat_count_nodes(&flat, node_counts);
+    pass_test(node_counts[Identifier] == 5 && node_counts[TranslationUnit] == 1,
+        "ast_flat_count_nodes(&flat, node_counts)");
+
+    // Test binary AST
+    WRITER bin_writer;
+    writer_init_buffer(&bin_writer);
+    ast_write_binary(&bin_writer, node2, content_to_str);
+    size_t bin_size = bin_writer.len;
+    char *bin_data = writer_release(&bin_writer);
+    AST_BIN bin;
+    pass_test(ast_bin_load(&bin, bin_data, bin_size) && ast_bin_type(&bin, ast_bin_root(&bin)) == Identifier
+              && str_eq((char *) ast_bin_content(&bin, ast_bin_root(&bin)), "node2")
+              && ast_bin_children_number(&bin, ast_bin_root(&bin)) == 1
+              && str_eq((char *) ast_bin_content(&bin, ast_bin_child(&bin, ast_bin_root(&bin), 0)), "node1"),
+        "ast_write_binary(&bin_writer, node2, content_to_str); ast_bin_load(&bin, bin_data, bin_size)");
+    writer_init_buffer(&bin_writer);
+    ast_bin_write_json(&bin_writer, &bin, ast_bin_root(&bin), 0, "    ");
+    pass_test(str_eq(writer_release(&bin_writer), json3), "ast_bin_write_json(&bin_writer, &bin, root, 0, \"    \")");
+    writer_init_buffer(&bin_writer);
+    ast_flat_write_binary(&bin_writer, &flat, flat_id, content_to_str);
+    pass_test(bin_writer.len == bin_size && memcmp(bin_writer.buf, bin_data, bin_size) == 0,
+        "ast_flat_write_binary(&bin_writer, &flat, flat_id, content_to_str)");
+    free(writer_release(&bin_writer));
+    bin_data[0] = 'X';
+    pass_test(!ast_bin_load(&bin, bin_data, bin_size), "ast_bin_load(&bin, bin_data, bin_size); wrong magic");
+    bin_data[0] = 'C';
+    pass_test(!ast_bin_load(&bin, bin_data, bin_size - 1), "ast_bin_load(&bin, bin_data, bin_size - 1)");
+    AST_BIN_NODE *bin_root = (AST_BIN_NODE *) (bin_data + ((AST_BIN_HEADER *) bin_data)->nodes_offset);
+    bin_root->type = AST_NODE_TYPES_NUMBER;
+    pass_test(!ast_bin_load(&bin, bin_data, bin_size), "ast_bin_load(&bin, bin_data, bin_size); unknown node type");
+    free(bin_data);
+    ast_flat_free(&flat);
+
+    // header_cache.h
+    HEADER_LOG log;
+    header_log_init(&log);
+    header_log_add(&log, 1, 0, NULL);
+    header_log_add(&log, 2, Identifier, "size_t");
+    header_log_add(&log, 3, StringLiteral, "text");
+    pass_test(log.length == 3 && log.tokens[0].text == HEADER_NO_TEXT && str_eq(log.text + log.tokens[2].text, "text"),
+        "header_log_add(&log, 3, StringLiteral, \"text\")");
+    HEADER_KEY key = {"/project/a.h", 100, 42};
+    pass_test(header_cache_acquire(&key) == NULL, "header_cache_acquire(&key) == NULL");
+    header_cache_put(&key, &log, 1, log.tokens[1].text, 0);
+    HEADER_CACHE_ENTRY *header = header_cache_acquire(&key);
+    pass_test(header && header->length == 2 && header->tokens[0].token == 2
+        && str_eq(header->text + header->tokens[1].text, "text"), "header_cache_put(&key, &log, 1, ...)");
+    HEADER_KEY changed = {"/project/a.h", 101, 42};
+    pass_test(header_cache_acquire(&changed) == NULL, "header_cache_acquire(&changed) == NULL");
+    header_cache_put(&changed, &log, 0, 0, 0);
+    pass_test(header_cache_acquire(&key) == NULL && header->length == 2,
+        "header_cache_put(&changed, &log, 0, 0); old entry held");
+    header_cache_release(header);
+    size_t hits, misses, entries;
+    header_cache_stats(&hits, &misses, &entries);
+    pass_test(hits == 1 && misses == 3 && entries == 1, "header_cache_stats(&hits, &misses, &entries)");
+    FILE *inner_file = fopen("unit_tests_inner.h", "w");
+    fputs("int x;", inner_file);
+    fclose(inner_file);
+    HEADER_KEY outer_key = {"/project/outer.h", 100, 42}, inner_key;
+    header_key_init(&inner_key, "unit_tests_inner.h", NULL);
+    header_log_clear(&log);
+    header_log_add_include(&log, "unit_tests_inner.h", &inner_key);
+    header_log_add(&log, 2, Identifier, "x");
+    header_cache_put(&outer_key, &log, 0, 0, 0);
+    header = header_cache_acquire(&outer_key);
+    pass_test(header && header->includes_length == 1 && header->tokens[0].token == HEADER_FILE_INCLUDE
+              && header->tokens[0].type == 0 && str_eq(header->includes[0].path, inner_key.path),
+              "header_log_add_include(&log, \"unit_tests_inner.h\", &inner_key)");
+    if (header) header_cache_release(header);
+    inner_file = fopen("unit_tests_inner.h", "w");
+    fputs("int xy;", inner_file);
+    fclose(inner_file);
+    pass_test(header_cache_acquire(&outer_key) == NULL, "header_cache_acquire(&outer_key) after the included file changed");
+    header_key_free(&inner_key);
+    header_key_init(&inner_key, "unit_tests_inner.h", NULL);
+    header_log_clear(&log);
+    header_log_add_include(&log, "unit_tests_inner.h", &inner_key);
+    header_cache_put(&outer_key, &log, 0, 0, 0);
+    header = header_cache_acquire(&outer_key);
+    pass_test(header && header->includes[0].size == 7,
+              "header_cache_put(&outer_key, &log, 0, 0, 0) with the changed included file");
+    if (header) header_cache_release(header);
+    header_key_free(&inner_key);
+    remove("unit_tests_inner.h");
+    header_cache_clear();
+    header_log_free(&log);
+
+    // Test `source_prefilter' and `source_offset'
+    FILE *spliced = tmpfile();
+    fputs("a?\?=b\\\nc?\?/\r\nd?\?\?-", spliced);
+    fflush(spliced);
+    SOURCE_MAP spliced_map;
+    if (source_map(&spliced_map, spliced))
+    {
+        source_prefilter(&spliced_map);
+        pass_test(spliced_map.size == 7 && str_eq(spliced_map.data, "a#bcd?~"),
+                  "source_prefilter(\"a?\?=b\\\\\\nc?\?/\\r\\nd?\?\?-\")");
+        pass_test(source_offset(&spliced_map, 1) == 1 && source_offset(&spliced_map, 2) == 4
+                  && source_offset(&spliced_map, 3) == 7 && source_offset(&spliced_map, 4) == 13
+                  && source_offset(&spliced_map, 6) == 15, "source_offset(&map, 1..6)");
+        source_unmap(&spliced_map);
+    }
+    fclose(spliced);
+
+    // Test `result_cache'
+    RESULT_DEPS deps;
+    result_deps_init(&deps);
+    result_deps_add(&deps, "unit_tests_dep.h");
+    result_deps_add(&deps, "unit_tests_dep.h");
+    pass_test(deps.number == 1, "result_deps_add(&deps, \"unit_tests_dep.h\") twice");
+    pass_test(result_cache_hash("abcdefghi", 9, 0) == result_cache_hash("abcdefghi", 9, 0)
+              && result_cache_hash("abcdefghi", 9, 0) != result_cache_hash("abcdefghj", 9, 0)
+              && result_cache_hash("abcdefghi", 9, 0) != result_cache_hash("abcdefghi", 9, 1),
+              "result_cache_hash(\"abcdefghi\", 9, 0)");
+    FILE *cached_file = fopen("unit_tests_dep.h", "w");
+    fputs("int x;", cached_file);
+    fclose(cached_file);
+    cached_file = fopen("unit_tests_out.json", "w");
+    fputs("{}", cached_file);
+    fclose(cached_file);
+    RESULT_CACHE cache = {"unit_tests_cache", 1 << 20, false};
+    result_cache_store(&cache, 42, "unit_tests_out.json", &deps);
+    remove("unit_tests_out.json");
+    char cached_output[8] = "";
+    _Bool cache_hit = result_cache_fetch(&cache, 42, "unit_tests_out.json");
+    if ((cached_file = fopen("unit_tests_out.json", "r")))
+    {
+        fgets(cached_output, sizeof(cached_output), cached_file);
+        fclose(cached_file);
+    }
+    pass_test(cache_hit && str_eq(cached_output, "{}"), "result_cache_fetch(&cache, 42, \"unit_tests_out.json\")");
+    cached_file = fopen("unit_tests_dep.h", "w");
+    fputs("int y;", cached_file);
+    fclose(cached_file);
+    size_t cache_hits, cache_misses;
+    cache_hit = result_cache_fetch(&cache, 42, "unit_tests_out.json");
+    result_cache_stats(&cache_hits, &cache_misses, NULL);
+    pass_test(!cache_hit && cache_hits == 1 && cache_misses == 1,
+              "result_cache_fetch(&cache, 42, \"unit_tests_out.json\") after the included file changed");
+    result_deps_free(&deps);
+    remove("unit_tests_dep.h");
+    remove("unit_tests_out.json");
+    remove("unit_tests_cache/000000000000002a.out");
+    remove("unit_tests_cache/000000000000002a.deps");
+    remove("unit_tests_cache");
+
+    // writer.h, function writer
+    WRITER sink_target, sink_writer;
+    writer_init_buffer(&sink_target);
+    writer_init_sink(&sink_writer, &test_sink, &sink_target);
+    for (int i = 0; i < 10000; ++i) writer_puts(&sink_writer, "0123456789");
+    int sink_flushed = writer_flush(&sink_writer);
+    char *sunk = writer_release(&sink_target);
+    pass_test(sink_flushed == 0 && strlen(sunk) == 100000 && strncmp(sunk + 99990, "0123456789", 10) == 0,
+              "writer_init_sink(&writer, &test_sink, &target); 100000 bytes");
+    free(sunk);
+    writer_release(&sink_writer);
+    writer_init_sink(&sink_writer, &test_sink, NULL);
+    writer_puts(&sink_writer, "refused");
+    pass_test(writer_flush(&sink_writer) == EOF, "writer_flush(&writer) == EOF, the sink failed");
+    writer_release(&sink_writer);
+
+    // alloc_wrap.h, catching failures
+    ALLOC_FAILURE alloc_failure;
+    ALLOC_FAILURE *outer_failure = alloc_failure_catch(&alloc_failure);
+    if (!setjmp(alloc_failure.jump))
+    {
+        my_free(my_malloc(SIZE_MAX, "test failure"));
+        pass_test(false, "my_malloc(SIZE_MAX, \"test failure\") jumps");
+    }
+    else
+    {
+        pass_test(str_eq((char *) alloc_failure.description, "test failure"),
+                  "my_malloc(SIZE_MAX, \"test failure\") jumps");
+    }
+    pass_test(alloc_failure_catch(outer_failure) == &alloc_failure, "alloc_failure_catch(outer)");
+
+    // alloc_wrap.h, profiling
+    alloc_profile_start();
+    char *profiled = (char *) my_malloc(100, "profiled test buffer");
+    profiled = (char *) my_realloc(profiled, 200, "profiled test buffer");
+    profiled = (char *) my_realloc(profiled, 400, "profiled test buffer");
+    my_free(profiled);
+    FILE *profile = tmpfile();
+    alloc_profile_write(profile);
+    rewind(profile);
+    char profile_line[512];
+    size_t calls = 0, reallocs = 0, frees = 0, total_bytes = 0, live_bytes = 1, peak_bytes = 0, chains = 0, longest = 0;
+    while (fgets(profile_line, sizeof(profile_line), profile))
+    {
+        if (strncmp(profile_line, "profiled test buffer ", 21) == 0)
+        {
+            sscanf(profile_line + 21, "%zu %zu %zu %zu %zu %zu %zu %zu", &calls, &reallocs, &frees, &total_bytes,
+                   &live_bytes, &peak_bytes, &chains, &longest);
+        }
+    }
+    fclose(profile);
+    pass_test(calls == 1 && reallocs == 2 && frees == 1 && total_bytes == 700 && live_bytes == 0 && peak_bytes == 400
+              && chains == 1 && longest == 2, "alloc_profile_write(profile); malloc, 2 reallocs, free");
 
     printf("\nResults:\n Total number of tests: %d\n Passed: %d\n Failed: %d\n",
         passed + failed, passed, failed);
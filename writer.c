@@ -0,0 +1,193 @@
+/**
+ * Buffered output sink for generated text
+ * (a `FILE', a function or a growable memory buffer).
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc_wrap.h"
+#include "stats.h"
+#include "string_tools.h"
+#include "writer.h"
+
+/// Initial capacity of a memory writer.
+#define WRITER_MEM_INIT_SIZE 4096
+
+/// Bytes of a string escaped at once by `writer_put_quoted',
+/// small enough for its escaped form to fit into the file buffer.
+#define WRITER_ESCAPE_CHUNK 4096
+
+void writer_init_file(WRITER *w, FILE *file)
+{
+    w->file = file;
+    w->sink = NULL;
+    w->sink_arg = NULL;
+    w->buf = (char *) my_malloc(WRITER_FILE_BUF_SIZE, "output buffer");
+    w->len = 0;
+    w->cap = WRITER_FILE_BUF_SIZE;
+    w->failed = false;
+    w->timed = false;
+    w->typed_constants = false;
+    w->write_wall = w->write_cpu = 0;
+}
+
+void writer_init_sink(WRITER *w, WRITER_SINK sink, void *arg)
+{
+    writer_init_file(w, NULL);
+    w->sink = sink;
+    w->sink_arg = arg;
+}
+
+void writer_init_buffer(WRITER *w)
+{
+    w->file = NULL;
+    w->sink = NULL;
+    w->sink_arg = NULL;
+    w->buf = (char *) my_malloc(WRITER_MEM_INIT_SIZE, "output buffer");
+    w->len = 0;
+    w->cap = WRITER_MEM_INIT_SIZE;
+    w->failed = false;
+    w->timed = false;
+    w->typed_constants = false;
+    w->write_wall = w->write_cpu = 0;
+}
+
+/// Does the writer pass its content on, rather than collecting it in memory?
+///
+/// \param w Writer to check
+/// \return `true' - it has a `FILE' or a function, `false' - memory writer
+static _Bool is_flushed(const WRITER *w)
+{
+    return w->file || w->sink;
+}
+
+/// Write the bytes into the file (or the function) of the writer, measuring the time if needed.
+///
+/// \param w Writer with a `FILE' or a function
+/// \param str Bytes to write
+/// \param len Number of bytes
+static void write_file(WRITER *w, const char *str, size_t len)
+{
+    STATS_TIME start, end;
+    if (w->timed) stats_now(&start);
+    if (w->sink)
+    {
+        if (!w->failed && !w->sink(w->sink_arg, str, len)) w->failed = true;
+    }
+    else if (fwrite(str, 1, len, w->file) != len)
+    {
+        w->failed = true;
+    }
+    if (w->timed)
+    {
+        stats_now(&end);
+        w->write_wall += end.wall - start.wall;
+        w->write_cpu += end.cpu - start.cpu;
+    }
+}
+
+int writer_flush(WRITER *w)
+{
+    if (is_flushed(w) && w->len > 0)
+    {
+        write_file(w, w->buf, w->len);
+        w->len = 0;
+    }
+    return w->failed ? EOF : 0;
+}
+
+void writer_put(WRITER *w, const char *str, size_t len)
+{
+    if (w->len + len > w->cap)
+    {
+        if (is_flushed(w))
+        {
+            writer_flush(w);
+            if (len > w->cap)
+            {
+                write_file(w, str, len);
+                return;
+            }
+        }
+        else
+        {
+            while (w->len + len > w->cap) w->cap *= 2;
+            w->buf = (char *) my_realloc(w->buf, w->cap, "output buffer");
+        }
+    }
+    memcpy(w->buf + w->len, str, len);
+    w->len += len;
+}
+
+/// Make room for `len' more bytes in the buffer, flushing or growing it.
+/// `len' must not exceed `WRITER_FILE_BUF_SIZE'.
+///
+/// \param w Writer to prepare
+/// \param len Number of bytes to be appended
+static void writer_reserve(WRITER *w, size_t len)
+{
+    if (w->len + len <= w->cap) return;
+    if (is_flushed(w))
+    {
+        writer_flush(w);
+        return;
+    }
+    while (w->len + len > w->cap) w->cap *= 2;
+    w->buf = (char *) my_realloc(w->buf, w->cap, "output buffer");
+}
+
+void writer_puts(WRITER *w, const char *str)
+{
+    writer_put(w, str, strlen(str));
+}
+
+void writer_putc(WRITER *w, char c)
+{
+    if (w->len == w->cap)
+    {
+        writer_put(w, &c, 1);
+        return;
+    }
+    w->buf[w->len++] = c;
+}
+
+void writer_put_quoted(WRITER *w, const char *str)
+{
+    writer_put_quoted_len(w, str, strlen(str));
+}
+
+void writer_put_quoted_len(WRITER *w, const char *str, size_t len)
+{
+    writer_putc(w, '"');
+    while (len > 0)
+    {
+        size_t part = len < WRITER_ESCAPE_CHUNK ? len : WRITER_ESCAPE_CHUNK;
+        writer_reserve(w, JSON_ESCAPED_MAX(part));
+        w->len += json_escape(w->buf + w->len, str, part);
+        str += part;
+        len -= part;
+    }
+    writer_putc(w, '"');
+}
+
+char *writer_release(WRITER *w)
+{
+    char *res = NULL;
+    if (is_flushed(w))
+    {
+        writer_flush(w);
+        my_free(w->buf);
+    }
+    else
+    {
+        writer_putc(w, '\0');
+        res = w->buf;
+    }
+    w->buf = NULL;
+    w->len = w->cap = 0;
+    return res;
+}
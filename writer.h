@@ -0,0 +1,111 @@
+/**
+ * Buffered output sink for generated text
+ * (a `FILE', a function or a growable memory buffer).
+ *
+ * @authors: Denis Chernikov, Vladislav Kuleykin
+ */
+
+#ifndef C_PARSER_WRITER_H_INCLUDED
+#define C_PARSER_WRITER_H_INCLUDED
+
+#include <stddef.h>
+#include <stdio.h>
+
+/// Size of the intermediate buffer of a `FILE' writer.
+#define WRITER_FILE_BUF_SIZE 65536
+
+/// Function receiving the output of a writer.
+///
+/// \param arg Argument given to `writer_init_sink'
+/// \param data Bytes written
+/// \param len Number of bytes
+/// \return `true' - OK, `false' - failed, nothing more is passed
+typedef _Bool (*WRITER_SINK)(void *arg, const char *data, size_t len);
+
+/// Output sink. If `file' or `sink' is set, `buf' is a fixed-size staging
+/// buffer flushed into it, otherwise `buf' grows to hold everything.
+typedef struct
+{
+    FILE *file;
+    WRITER_SINK sink;
+    void *sink_arg;
+    char *buf;
+    size_t len;
+    size_t cap;
+    _Bool failed;
+    /// Is the time spent writing into `file' measured (for `--stats')?
+    _Bool timed;
+    /// Seconds spent writing into `file' by wall clock and processor time, if `timed'
+    double write_wall;
+    double write_cpu;
+    /// Are values and types of constants written into JSON next to their spellings
+    /// (for `--typed-constants', see `ast_write_json')?
+    _Bool typed_constants;
+}
+WRITER;
+
+/// Initialize writer flushing its content into the given file.
+///
+/// \param w Writer to initialize
+/// \param file Opened target file
+void writer_init_file(WRITER *w, FILE *file);
+
+/// Initialize writer passing its content to the given function in chunks.
+///
+/// \param w Writer to initialize
+/// \param sink Function to pass the content to
+/// \param arg Argument to pass to `sink'
+void writer_init_sink(WRITER *w, WRITER_SINK sink, void *arg);
+
+/// Initialize writer collecting its content in memory.
+///
+/// \param w Writer to initialize
+void writer_init_buffer(WRITER *w);
+
+/// Append `len' bytes of the given memory to the output.
+///
+/// \param w Writer to append to
+/// \param str Bytes to be written
+/// \param len Number of bytes to write
+void writer_put(WRITER *w, const char *str, size_t len);
+
+/// Append the given string to the output.
+///
+/// \param w Writer to append to
+/// \param str Null-terminated string to be written
+void writer_puts(WRITER *w, const char *str);
+
+/// Append one character to the output.
+///
+/// \param w Writer to append to
+/// \param c Character to be written
+void writer_putc(WRITER *w, char c);
+
+/// Append the given string wrapped into double quotes,
+/// escaping special symbols by `json_escape' right into the buffer.
+///
+/// \param w Writer to append to
+/// \param str Null-terminated string to be written
+void writer_put_quoted(WRITER *w, const char *str);
+
+/// Append `len' bytes of the given memory wrapped into double quotes, escaped as by `writer_put_quoted'.
+///
+/// \param w Writer to append to
+/// \param str Bytes to be written, not necessarily null-terminated
+/// \param len Number of bytes
+void writer_put_quoted_len(WRITER *w, const char *str, size_t len);
+
+/// Flush buffered content of a `FILE' or function writer.
+///
+/// \param w Writer to flush
+/// \return 0 - OK, EOF - some write failed
+int writer_flush(WRITER *w);
+
+/// Take the collected content of a memory writer. Needs to be freed.
+/// For a `FILE' or function writer, flushes it and releases the staging buffer.
+///
+/// \param w Writer to release
+/// \return Null-terminated output of a memory writer, NULL for others
+char *writer_release(WRITER *w);
+
+#endif //C_PARSER_WRITER_H_INCLUDED
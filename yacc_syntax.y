@@ -11,9 +11,14 @@
 
 %expect    0  // shift/reduce
 %expect-rr 0  // reduce/reduce
-//%lex-param {}
-%parse-param {void **root}
-//%pure-parser
+%define api.pure full
+%lex-param   {void *scanner}
+%parse-param {void *scanner} {PARSE_CONTEXT *ctx}
+
+%code requires
+{
+#include "parse_context.h"
+}
 
 %{
 #include <stdbool.h>
@@ -22,10 +27,24 @@
 #include <string.h>
 #include "alloc_wrap.h"
 #include "ast.h"
+#include "parse_context.h"
 #include "string_tools.h"
 #include "typedef_name.h"
 #include "y.tab.h"
 
+/// The parser stack grows on the C stack instead of the heap: allocation failures jump out of `yyparse'
+/// (see `alloc_failure_catch'), and a heap stack would be lost then.
+#define YYSTACK_USE_ALLOCA 1
+
+/// Deepest nesting of the parser stack, bounding its size on the C stack (about 10 bytes per level).
+#define YYMAXDEPTH 10000
+
+/// Node of the lookahead token inside of an action, NULL if no token was read or it has no node
+/// (see `ast_flat_collect').
+#define lookahead_node \
+    (yychar == IDENTIFIER || yychar == TYPEDEF_NAME || yychar == CONSTANT || yychar == STRING_LITERAL \
+        ? &yylval.node : NULL)
+
 /// Create an instance of AST_CONTENT with a `token' stored inside.
 #define content_t(v)  ((AST_CONTENT) {.token = v})
 
@@ -34,18 +53,18 @@
 
 /// Get next token from the specified input.
 ///
+/// \param lvalp Semantic value of the token
+/// \param scanner Flex scanner to read from
 /// \return Next token of the source
-extern int yylex();
-
-/// Was error already found?
-_Bool error_found = false;
+extern int yylex(YYSTYPE *lvalp, void *scanner);
 
 /// Called when parse error was detected.
 ///
-/// root AST root node link
+/// \param scanner Flex scanner of the parse
+/// \param ctx Context of the parse
 /// \param str Error description to be printed
 /// \return Always 0
-int yyerror(void *root, const char *str);
+int yyerror(void *scanner, PARSE_CONTEXT *ctx, const char *str);
 
 /// Does this node contains TYPEDEF token?
 ///
@@ -55,8 +74,9 @@ _Bool is_typedef_used(AST_NODE *node);
 
 /// Collect all the identifiers (DirectDeclarators) from this node.
 ///
+/// \param typedefs Table to put typedef-names to
 /// \param node AST Node of `InitDeclaratorList' to collect from
-void collect_typedef_names(AST_NODE *node);
+void collect_typedef_names(TYPEDEF_TABLE *typedefs, AST_NODE *node);
 %}
 
 %start TranslationUnit
@@ -285,16 +305,32 @@ void collect_typedef_names(AST_NODE *node);
 TranslationUnit
         :                 ExternalDeclaration
         {
-            if (!error_found)
+            if (!ctx->error_found && ctx->flat)
+            {
+                ast_flat_collect(ctx->flat, &ctx->arena, $1, lookahead_node);
+            }
+            else if (!ctx->error_found && ctx->stream)
             {
-                *root = (void *) ast_create_node(TranslationUnit, content_null, 1, $1);
+                ast_stream_collect(ctx->stream, &ctx->arena, $1, lookahead_node);
+            }
+            else if (!ctx->error_found)
+            {
+                ctx->root = ast_create_node(&ctx->arena, TranslationUnit, content_null, 1, $1);
             }
         }
         | TranslationUnit ExternalDeclaration
         {
-            if (!error_found)
+            if (!ctx->error_found && ctx->flat)
+            {
+                ast_flat_collect(ctx->flat, &ctx->arena, $2, lookahead_node);
+            }
+            else if (!ctx->error_found && ctx->stream)
             {
-                *root = (void *) ast_expand_node(*root, $2);
+                ast_stream_collect(ctx->stream, &ctx->arena, $2, lookahead_node);
+            }
+            else if (!ctx->error_found)
+            {
+                ctx->root = ast_expand_node(&ctx->arena, ctx->root, $2);
             }
         }
         ;
@@ -307,22 +343,22 @@ ExternalDeclaration
 FunctionDefinition
         : DeclarationSpecifiers Declarator                 CompoundStatement
         {
-            $$ = ast_create_node(FunctionDefinition, content_null, 3, $1, $2, $3);
+            $$ = ast_create_node(&ctx->arena, FunctionDefinition, content_null, 3, $1, $2, $3);
         }
         | DeclarationSpecifiers Declarator DeclarationList CompoundStatement
         {
-            $$ = ast_create_node(FunctionDefinition, content_null, 4, $1, $2, $3, $4);
+            $$ = ast_create_node(&ctx->arena, FunctionDefinition, content_null, 4, $1, $2, $3, $4);
         }
         ;
 
 DeclarationList
         :                 Declaration
         {
-            $$ = ast_create_node(DeclarationList, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, DeclarationList, content_null, 1, $1);
         }
         | DeclarationList Declaration
         {
-            $$ = ast_expand_node($1, $2);
+            $$ = ast_expand_node(&ctx->arena, $1, $2);
         }
         ;
 
@@ -331,12 +367,12 @@ DeclarationList
 Declaration
         : DeclarationSpecifiers                    SEMICOLON
         {
-            $$ = ast_create_node(Declaration, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, Declaration, content_null, 1, $1);
         }
         | DeclarationSpecifiers InitDeclaratorList SEMICOLON
         {
-            if (is_typedef_used($1)) collect_typedef_names($2);  // Storing typedef-name
-            $$ = ast_create_node(Declaration, content_null, 2, $1, $2);
+            if (is_typedef_used($1)) collect_typedef_names(&ctx->typedefs, $2);  // Storing typedef-name
+            $$ = ast_create_node(&ctx->arena, Declaration, content_null, 2, $1, $2);
         }
         | StaticAssertDeclaration  { $$ = $1; }
         ;
@@ -344,90 +380,90 @@ Declaration
 DeclarationSpecifiers
         : StorageClassSpecifier
         {
-            $$ = ast_create_node(DeclarationSpecifiers, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, DeclarationSpecifiers, content_null, 1, $1);
         }
         | TypeSpecifier
         {
-            $$ = ast_create_node(DeclarationSpecifiers, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, DeclarationSpecifiers, content_null, 1, $1);
         }
         | TypeQualifier
         {
-            $$ = ast_create_node(DeclarationSpecifiers, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, DeclarationSpecifiers, content_null, 1, $1);
         }
         | FunctionSpecifier
         {
-            $$ = ast_create_node(DeclarationSpecifiers, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, DeclarationSpecifiers, content_null, 1, $1);
         }
         | AlignmentSpecifier
         {
-            $$ = ast_create_node(DeclarationSpecifiers, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, DeclarationSpecifiers, content_null, 1, $1);
         }
         | StorageClassSpecifier DeclarationSpecifiers
         {
-            $$ = ast_expand_node($2, $1);
+            $$ = ast_expand_node(&ctx->arena, $2, $1);
         }
         | TypeSpecifier         DeclarationSpecifiers
         {
-            $$ = ast_expand_node($2, $1);
+            $$ = ast_expand_node(&ctx->arena, $2, $1);
         }
         | TypeQualifier         DeclarationSpecifiers
         {
-            $$ = ast_expand_node($2, $1);
+            $$ = ast_expand_node(&ctx->arena, $2, $1);
         }
         | FunctionSpecifier     DeclarationSpecifiers
         {
-            $$ = ast_expand_node($2, $1);
+            $$ = ast_expand_node(&ctx->arena, $2, $1);
         }
         | AlignmentSpecifier    DeclarationSpecifiers
         {
-            $$ = ast_expand_node($2, $1);
+            $$ = ast_expand_node(&ctx->arena, $2, $1);
         }
         ;
 
 InitDeclaratorList
         :                          InitDeclarator
         {
-            $$ = ast_create_node(InitDeclaratorList, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, InitDeclaratorList, content_null, 1, $1);
         }
         | InitDeclaratorList COMMA InitDeclarator
         {
-            $$ = ast_expand_node($1, $3);
+            $$ = ast_expand_node(&ctx->arena, $1, $3);
         }
         ;
 
 InitDeclarator
         : Declarator
         {
-            $$ = ast_create_node(InitDeclarator, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, InitDeclarator, content_null, 1, $1);
         }
         | Declarator ASSIGN Initializer
         {
-            $$ = ast_create_node(InitDeclarator, content_null, 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, InitDeclarator, content_null, 2, $1, $3);
         }
         ;
 
 StorageClassSpecifier
-        : TYPEDEF       { $$ = ast_create_node(StorageClassSpecifier, content_t(TYPEDEF), 0); }
-        | EXTERN        { $$ = ast_create_node(StorageClassSpecifier, content_t(EXTERN), 0); }
-        | STATIC        { $$ = ast_create_node(StorageClassSpecifier, content_t(STATIC), 0); }
-        | THREAD_LOCAL  { $$ = ast_create_node(StorageClassSpecifier, content_t(THREAD_LOCAL), 0); }
-        | AUTO          { $$ = ast_create_node(StorageClassSpecifier, content_t(AUTO), 0); }
-        | REGISTER      { $$ = ast_create_node(StorageClassSpecifier, content_t(REGISTER), 0); }
+        : TYPEDEF       { $$ = ast_create_node(&ctx->arena, StorageClassSpecifier, content_t(TYPEDEF), 0); }
+        | EXTERN        { $$ = ast_create_node(&ctx->arena, StorageClassSpecifier, content_t(EXTERN), 0); }
+        | STATIC        { $$ = ast_create_node(&ctx->arena, StorageClassSpecifier, content_t(STATIC), 0); }
+        | THREAD_LOCAL  { $$ = ast_create_node(&ctx->arena, StorageClassSpecifier, content_t(THREAD_LOCAL), 0); }
+        | AUTO          { $$ = ast_create_node(&ctx->arena, StorageClassSpecifier, content_t(AUTO), 0); }
+        | REGISTER      { $$ = ast_create_node(&ctx->arena, StorageClassSpecifier, content_t(REGISTER), 0); }
         ;
 
 TypeSpecifier
-        : VOID       { $$ = ast_create_node(TypeSpecifier, content_t(VOID), 0); }
-        | CHAR       { $$ = ast_create_node(TypeSpecifier, content_t(CHAR), 0); }
-        | SHORT      { $$ = ast_create_node(TypeSpecifier, content_t(SHORT), 0); }
-        | INT        { $$ = ast_create_node(TypeSpecifier, content_t(INT), 0); }
-        | LONG       { $$ = ast_create_node(TypeSpecifier, content_t(LONG), 0); }
-        | FLOAT      { $$ = ast_create_node(TypeSpecifier, content_t(FLOAT), 0); }
-        | DOUBLE     { $$ = ast_create_node(TypeSpecifier, content_t(DOUBLE), 0); }
-        | SIGNED     { $$ = ast_create_node(TypeSpecifier, content_t(SIGNED), 0); }
-        | UNSIGNED   { $$ = ast_create_node(TypeSpecifier, content_t(UNSIGNED), 0); }
-        | BOOL       { $$ = ast_create_node(TypeSpecifier, content_t(BOOL), 0); }
-        | COMPLEX    { $$ = ast_create_node(TypeSpecifier, content_t(COMPLEX), 0); }
-        | IMAGINARY  { $$ = ast_create_node(TypeSpecifier, content_t(IMAGINARY), 0); }
+        : VOID       { $$ = ast_create_node(&ctx->arena, TypeSpecifier, content_t(VOID), 0); }
+        | CHAR       { $$ = ast_create_node(&ctx->arena, TypeSpecifier, content_t(CHAR), 0); }
+        | SHORT      { $$ = ast_create_node(&ctx->arena, TypeSpecifier, content_t(SHORT), 0); }
+        | INT        { $$ = ast_create_node(&ctx->arena, TypeSpecifier, content_t(INT), 0); }
+        | LONG       { $$ = ast_create_node(&ctx->arena, TypeSpecifier, content_t(LONG), 0); }
+        | FLOAT      { $$ = ast_create_node(&ctx->arena, TypeSpecifier, content_t(FLOAT), 0); }
+        | DOUBLE     { $$ = ast_create_node(&ctx->arena, TypeSpecifier, content_t(DOUBLE), 0); }
+        | SIGNED     { $$ = ast_create_node(&ctx->arena, TypeSpecifier, content_t(SIGNED), 0); }
+        | UNSIGNED   { $$ = ast_create_node(&ctx->arena, TypeSpecifier, content_t(UNSIGNED), 0); }
+        | BOOL       { $$ = ast_create_node(&ctx->arena, TypeSpecifier, content_t(BOOL), 0); }
+        | COMPLEX    { $$ = ast_create_node(&ctx->arena, TypeSpecifier, content_t(COMPLEX), 0); }
+        | IMAGINARY  { $$ = ast_create_node(&ctx->arena, TypeSpecifier, content_t(IMAGINARY), 0); }
         | AtomicTypeSpecifier     { $$ = $1; }
         | StructOrUnionSpecifier  { $$ = $1; }
         | EnumSpecifier           { $$ = $1; }
@@ -437,15 +473,15 @@ TypeSpecifier
 StructOrUnionSpecifier
         : StructOrUnion            LBRACE StructDeclarationList RBRACE
         {
-            $$ = ast_create_node($1 ? StructSpecifier : UnionSpecifier, content_null, 1, $3);
+            $$ = ast_create_node(&ctx->arena, $1 ? StructSpecifier : UnionSpecifier, content_null, 1, $3);
         }
         | StructOrUnion IDENTIFIER LBRACE StructDeclarationList RBRACE
         {
-            $$ = ast_create_node($1 ? StructSpecifier : UnionSpecifier, content_null, 2, $2, $4);
+            $$ = ast_create_node(&ctx->arena, $1 ? StructSpecifier : UnionSpecifier, content_null, 2, $2, $4);
         }
         | StructOrUnion IDENTIFIER
         {
-            $$ = ast_create_node($1 ? StructSpecifier : UnionSpecifier, content_null, 1, $2);
+            $$ = ast_create_node(&ctx->arena, $1 ? StructSpecifier : UnionSpecifier, content_null, 1, $2);
         }
         ;
 
@@ -457,22 +493,22 @@ StructOrUnion
 StructDeclarationList
         :                       StructDeclaration
         {
-            $$ = ast_create_node(StructDeclarationList, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, StructDeclarationList, content_null, 1, $1);
         }
         | StructDeclarationList StructDeclaration
         {
-            $$ = ast_expand_node($1, $2);
+            $$ = ast_expand_node(&ctx->arena, $1, $2);
         }
         ;
 
 StructDeclaration
         : SpecifierQualifierList                      SEMICOLON
         {
-            $$ = ast_create_node(StructDeclaration, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, StructDeclaration, content_null, 1, $1);
         }
         | SpecifierQualifierList StructDeclaratorList SEMICOLON
         {
-            $$ = ast_create_node(StructDeclaration, content_null, 2, $1, $2);
+            $$ = ast_create_node(&ctx->arena, StructDeclaration, content_null, 2, $1, $2);
         }
         | StaticAssertDeclaration  { $$ = $1; }
         ;
@@ -480,38 +516,38 @@ StructDeclaration
 SpecifierQualifierList
         : TypeSpecifier
         {
-            $$ = ast_create_node(SpecifierQualifierList, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, SpecifierQualifierList, content_null, 1, $1);
         }
         | TypeQualifier
         {
-            $$ = ast_create_node(SpecifierQualifierList, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, SpecifierQualifierList, content_null, 1, $1);
         }
         | AlignmentSpecifier
         {
-            $$ = ast_create_node(SpecifierQualifierList, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, SpecifierQualifierList, content_null, 1, $1);
         }
         | TypeSpecifier      SpecifierQualifierList
         {
-            $$ = ast_expand_node($2, $1);
+            $$ = ast_expand_node(&ctx->arena, $2, $1);
         }
         | TypeQualifier      SpecifierQualifierList
         {
-            $$ = ast_expand_node($2, $1);
+            $$ = ast_expand_node(&ctx->arena, $2, $1);
         }
         | AlignmentSpecifier SpecifierQualifierList
         {
-            $$ = ast_expand_node($2, $1);
+            $$ = ast_expand_node(&ctx->arena, $2, $1);
         }
         ;
 
 StructDeclaratorList
         :                            StructDeclarator
         {
-            $$ = ast_create_node(StructDeclaratorList, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, StructDeclaratorList, content_null, 1, $1);
         }
         | StructDeclaratorList COMMA StructDeclarator
         {
-            $$ = ast_expand_node($1, $3);
+            $$ = ast_expand_node(&ctx->arena, $1, $3);
         }
         ;
 
@@ -520,182 +556,182 @@ StructDeclarator
         |            COLON ConstantExpression  { $$ = $2; }
         | Declarator COLON ConstantExpression
         {
-            $$ = ast_create_node(StructDeclarator, content_null, 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, StructDeclarator, content_null, 2, $1, $3);
         }
         ;
 
 EnumSpecifier
         : ENUM            LBRACE EnumeratorList       RBRACE
         {
-            $$ = ast_create_node(EnumSpecifier, content_null, 1, $3);
+            $$ = ast_create_node(&ctx->arena, EnumSpecifier, content_null, 1, $3);
         }
         | ENUM            LBRACE EnumeratorList COMMA RBRACE
         {
-            $$ = ast_create_node(EnumSpecifier, content_null, 1, $3);
+            $$ = ast_create_node(&ctx->arena, EnumSpecifier, content_null, 1, $3);
         }
         | ENUM IDENTIFIER LBRACE EnumeratorList       RBRACE
         {
-            $$ = ast_create_node(EnumSpecifier, content_null, 2, $2, $4);
+            $$ = ast_create_node(&ctx->arena, EnumSpecifier, content_null, 2, $2, $4);
         }
         | ENUM IDENTIFIER LBRACE EnumeratorList COMMA RBRACE
         {
-            $$ = ast_create_node(EnumSpecifier, content_null, 2, $2, $4);
+            $$ = ast_create_node(&ctx->arena, EnumSpecifier, content_null, 2, $2, $4);
         }
         | ENUM IDENTIFIER
         {
-            $$ = ast_create_node(EnumSpecifier, content_null, 1, $2);
+            $$ = ast_create_node(&ctx->arena, EnumSpecifier, content_null, 1, $2);
         }
         ;
 
 EnumeratorList
         :                      Enumerator
         {
-            $$ = ast_create_node(EnumeratorList, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, EnumeratorList, content_null, 1, $1);
         }
         | EnumeratorList COMMA Enumerator
         {
-            $$ = ast_expand_node($1, $3);
+            $$ = ast_expand_node(&ctx->arena, $1, $3);
         }
         ;
 
 Enumerator
         : IDENTIFIER  // EnumerationConstant, reduce/reduce with PrimaryExpression
         {
-            $$ = ast_create_node(Enumerator, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, Enumerator, content_null, 1, $1);
         }
         | IDENTIFIER ASSIGN ConstantExpression
         {
-            $$ = ast_create_node(Enumerator, content_null, 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, Enumerator, content_null, 2, $1, $3);
         }
         ;
 
 AtomicTypeSpecifier
         : ATOMIC LPAREN TypeName RPAREN
         {
-            $$ = ast_create_node(AtomicTypeSpecifier, content_null, 1, $3);
+            $$ = ast_create_node(&ctx->arena, AtomicTypeSpecifier, content_null, 1, $3);
         }
         ;
 
 TypeQualifier
-        : CONST     { $$ = ast_create_node(TypeQualifier, content_t(CONST), 0); }
-        | RESTRICT  { $$ = ast_create_node(TypeQualifier, content_t(RESTRICT), 0); }
-        | VOLATILE  { $$ = ast_create_node(TypeQualifier, content_t(VOLATILE), 0); }
-        | ATOMIC    { $$ = ast_create_node(TypeQualifier, content_t(ATOMIC), 0); }
+        : CONST     { $$ = ast_create_node(&ctx->arena, TypeQualifier, content_t(CONST), 0); }
+        | RESTRICT  { $$ = ast_create_node(&ctx->arena, TypeQualifier, content_t(RESTRICT), 0); }
+        | VOLATILE  { $$ = ast_create_node(&ctx->arena, TypeQualifier, content_t(VOLATILE), 0); }
+        | ATOMIC    { $$ = ast_create_node(&ctx->arena, TypeQualifier, content_t(ATOMIC), 0); }
         ;
 
 FunctionSpecifier
-        : INLINE    { $$ = ast_create_node(FunctionSpecifier, content_t(INLINE), 0); }
-        | NORETURN  { $$ = ast_create_node(FunctionSpecifier, content_t(NORETURN), 0); }
+        : INLINE    { $$ = ast_create_node(&ctx->arena, FunctionSpecifier, content_t(INLINE), 0); }
+        | NORETURN  { $$ = ast_create_node(&ctx->arena, FunctionSpecifier, content_t(NORETURN), 0); }
         ;
 
 AlignmentSpecifier
         : ALIGNAS LPAREN TypeName           RPAREN
         {
-            $$ = ast_create_node(AlignmentSpecifier, content_null, 1, $3);
+            $$ = ast_create_node(&ctx->arena, AlignmentSpecifier, content_null, 1, $3);
         }
         | ALIGNAS LPAREN ConstantExpression RPAREN
         {
-            $$ = ast_create_node(AlignmentSpecifier, content_null, 1, $3);
+            $$ = ast_create_node(&ctx->arena, AlignmentSpecifier, content_null, 1, $3);
         }
         ;
 
 Declarator
         :         DirectDeclarator
         {
-            $$ = ast_create_node(Declarator, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, Declarator, content_null, 1, $1);
         }
         | Pointer DirectDeclarator
         {
-            $$ = ast_create_node(Declarator, content_null, 2, $1, $2);
+            $$ = ast_create_node(&ctx->arena, Declarator, content_null, 2, $1, $2);
         }
         ;
 
 DirectDeclarator
         : IDENTIFIER
         {
-            $$ = ast_create_node(DirectDeclarator, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, DirectDeclarator, content_null, 1, $1);
         }
         | LPAREN Declarator RPAREN
         {
-            $$ = ast_create_node(DirectDeclarator, content_t(LPAREN), 1, $2);
+            $$ = ast_create_node(&ctx->arena, DirectDeclarator, content_t(LPAREN), 1, $2);
         }
         | DirectDeclarator LBRACKET                                               RBRACKET
         {
-            $$ = ast_expand_node($1, ast_create_node(DirectDeclaratorBrackets, content_null, 0));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, DirectDeclaratorBrackets, content_null, 0));
         }
         | DirectDeclarator LBRACKET                          AssignmentExpression RBRACKET
         {
-            $$ = ast_expand_node($1, ast_create_node(DirectDeclaratorBrackets, content_null, 1, $3));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, DirectDeclaratorBrackets, content_null, 1, $3));
         }
         | DirectDeclarator LBRACKET TypeQualifierList                             RBRACKET
         {
-            $$ = ast_expand_node($1, ast_create_node(DirectDeclaratorBrackets, content_null, 1, $3));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, DirectDeclaratorBrackets, content_null, 1, $3));
         }
         | DirectDeclarator LBRACKET TypeQualifierList        AssignmentExpression RBRACKET
         {
-            $$ = ast_expand_node($1, ast_create_node(DirectDeclaratorBrackets, content_null, 2, $3, $4));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, DirectDeclaratorBrackets, content_null, 2, $3, $4));
         }
         | DirectDeclarator LBRACKET                   STATIC AssignmentExpression RBRACKET
         {
-            $$ = ast_expand_node($1, ast_create_node(DirectDeclaratorBrackets, content_t(STATIC), 1, $4));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, DirectDeclaratorBrackets, content_t(STATIC), 1, $4));
         }
         | DirectDeclarator LBRACKET STATIC TypeQualifierList AssignmentExpression RBRACKET
         {
-            $$ = ast_expand_node($1, ast_create_node(DirectDeclaratorBrackets, content_t(STATIC), 2, $4, $5));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, DirectDeclaratorBrackets, content_t(STATIC), 2, $4, $5));
         }
         | DirectDeclarator LBRACKET TypeQualifierList STATIC AssignmentExpression RBRACKET
         {
-            $$ = ast_expand_node($1, ast_create_node(DirectDeclaratorBrackets, content_t(STATIC), 2, $3, $5));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, DirectDeclaratorBrackets, content_t(STATIC), 2, $3, $5));
         }
         | DirectDeclarator LBRACKET                   ASTERISK                    RBRACKET
         {
-            $$ = ast_expand_node($1, ast_create_node(DirectDeclaratorBrackets, content_t(ASTERISK), 0));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, DirectDeclaratorBrackets, content_t(ASTERISK), 0));
         }
         | DirectDeclarator LBRACKET TypeQualifierList ASTERISK                    RBRACKET
         {
-            $$ = ast_expand_node($1, ast_create_node(DirectDeclaratorBrackets, content_t(ASTERISK), 1, $3));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, DirectDeclaratorBrackets, content_t(ASTERISK), 1, $3));
         }
         | DirectDeclarator LPAREN ParameterTypeList RPAREN
         {
-            $$ = ast_expand_node($1, ast_create_node(DirectDeclaratorParen, content_null, 1, $3));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, DirectDeclaratorParen, content_null, 1, $3));
         }
         | DirectDeclarator LPAREN                   RPAREN
         {
-            $$ = ast_expand_node($1, ast_create_node(DirectDeclaratorParen, content_null, 0));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, DirectDeclaratorParen, content_null, 0));
         }
         | DirectDeclarator LPAREN IdentifierList    RPAREN
         {
-            $$ = ast_expand_node($1, ast_create_node(DirectDeclaratorParen, content_null, 1, $3));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, DirectDeclaratorParen, content_null, 1, $3));
         }
         ;
 
 Pointer
         : ASTERISK
         {
-            $$ = ast_create_node(Pointer, content_null, 0);
+            $$ = ast_create_node(&ctx->arena, Pointer, content_null, 0);
         }
         | ASTERISK TypeQualifierList
         {
-            $$ = ast_create_node(Pointer, content_null, 1, $2);
+            $$ = ast_create_node(&ctx->arena, Pointer, content_null, 1, $2);
         }
         | ASTERISK                   Pointer
         {
-            $$ = ast_expand_node(ast_create_node(Pointer, content_null, 0), $2);
+            $$ = ast_expand_node(&ctx->arena, ast_create_node(&ctx->arena, Pointer, content_null, 0), $2);
         }
         | ASTERISK TypeQualifierList Pointer
         {
-            $$ = ast_expand_node(ast_create_node(Pointer, content_null, 1, $2), $3);
+            $$ = ast_expand_node(&ctx->arena, ast_create_node(&ctx->arena, Pointer, content_null, 1, $2), $3);
         }
         ;
 
 TypeQualifierList
         :                   TypeQualifier
         {
-            $$ = ast_create_node(TypeQualifierList, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, TypeQualifierList, content_null, 1, $1);
         }
         | TypeQualifierList TypeQualifier
         {
-            $$ = ast_expand_node($1, $2);
+            $$ = ast_expand_node(&ctx->arena, $1, $2);
         }
         ;
 
@@ -711,160 +747,160 @@ ParameterTypeList
 ParameterList
         :                     ParameterDeclaration
         {
-            $$ = ast_create_node(ParameterList, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, ParameterList, content_null, 1, $1);
         }
         | ParameterList COMMA ParameterDeclaration
         {
-            $$ = ast_expand_node($1, $3);
+            $$ = ast_expand_node(&ctx->arena, $1, $3);
         }
         ;
 
 ParameterDeclaration
         : DeclarationSpecifiers Declarator
         {
-            $$ = ast_create_node(ParameterDeclaration, content_null, 2, $1, $2);
+            $$ = ast_create_node(&ctx->arena, ParameterDeclaration, content_null, 2, $1, $2);
         }
         | DeclarationSpecifiers
         {
-            $$ = ast_create_node(ParameterDeclaration, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, ParameterDeclaration, content_null, 1, $1);
         }
         | DeclarationSpecifiers AbstractDeclarator
         {
-            $$ = ast_create_node(ParameterDeclaration, content_null, 2, $1, $2);
+            $$ = ast_create_node(&ctx->arena, ParameterDeclaration, content_null, 2, $1, $2);
         }
         ;
 
 IdentifierList
         :                      IDENTIFIER
         {
-            $$ = ast_create_node(IdentifierList, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, IdentifierList, content_null, 1, $1);
         }
         | IdentifierList COMMA IDENTIFIER
         {
-            $$ = ast_expand_node($1, $3);
+            $$ = ast_expand_node(&ctx->arena, $1, $3);
         }
         ;
 
 TypeName
         : SpecifierQualifierList
         {
-            $$ = ast_create_node(TypeName, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, TypeName, content_null, 1, $1);
         }
         | SpecifierQualifierList AbstractDeclarator
         {
-            $$ = ast_create_node(TypeName, content_null, 2, $1, $2);
+            $$ = ast_create_node(&ctx->arena, TypeName, content_null, 2, $1, $2);
         }
         ;
 
 AbstractDeclarator
         : Pointer
         {
-            $$ = ast_create_node(AbstractDeclarator, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, AbstractDeclarator, content_null, 1, $1);
         }
         |         DirectAbstractDeclarator
         {
-            $$ = ast_create_node(AbstractDeclarator, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, AbstractDeclarator, content_null, 1, $1);
         }
         | Pointer DirectAbstractDeclarator
         {
-            $$ = ast_create_node(AbstractDeclarator, content_null, 2, $1, $2);
+            $$ = ast_create_node(&ctx->arena, AbstractDeclarator, content_null, 2, $1, $2);
         }
         ;
 
 DirectAbstractDeclarator
         : LPAREN AbstractDeclarator RPAREN
         {
-            $$ = ast_create_node(DirectAbstractDeclarator, content_null, 1, $2);
+            $$ = ast_create_node(&ctx->arena, DirectAbstractDeclarator, content_null, 1, $2);
         }
         |                          LBRACKET                                               RBRACKET
         {
-            $$ = ast_create_node(DirectAbstractDeclarator, content_null, 1,
-                ast_create_node(DirectAbstractDeclaratorBrackets, content_null, 0));
+            $$ = ast_create_node(&ctx->arena, DirectAbstractDeclarator, content_null, 1,
+                ast_create_node(&ctx->arena, DirectAbstractDeclaratorBrackets, content_null, 0));
         }
         |                          LBRACKET                          AssignmentExpression RBRACKET
         {
-            $$ = ast_create_node(DirectAbstractDeclarator, content_null, 1,
-                ast_create_node(DirectAbstractDeclaratorBrackets, content_null, 1, $2));
+            $$ = ast_create_node(&ctx->arena, DirectAbstractDeclarator, content_null, 1,
+                ast_create_node(&ctx->arena, DirectAbstractDeclaratorBrackets, content_null, 1, $2));
         }
         |                          LBRACKET TypeQualifierList                             RBRACKET
         {
-            $$ = ast_create_node(DirectAbstractDeclarator, content_null, 1,
-                ast_create_node(DirectAbstractDeclaratorBrackets, content_null, 1, $2));
+            $$ = ast_create_node(&ctx->arena, DirectAbstractDeclarator, content_null, 1,
+                ast_create_node(&ctx->arena, DirectAbstractDeclaratorBrackets, content_null, 1, $2));
         }
         |                          LBRACKET TypeQualifierList        AssignmentExpression RBRACKET
         {
-            $$ = ast_create_node(DirectAbstractDeclarator, content_null, 1,
-                ast_create_node(DirectAbstractDeclaratorBrackets, content_null, 2, $2, $3));
+            $$ = ast_create_node(&ctx->arena, DirectAbstractDeclarator, content_null, 1,
+                ast_create_node(&ctx->arena, DirectAbstractDeclaratorBrackets, content_null, 2, $2, $3));
         }
         |                          LBRACKET                   STATIC AssignmentExpression RBRACKET
         {
-            $$ = ast_create_node(DirectAbstractDeclarator, content_null, 1,
-                ast_create_node(DirectAbstractDeclaratorBrackets, content_t(STATIC), 1, $3));
+            $$ = ast_create_node(&ctx->arena, DirectAbstractDeclarator, content_null, 1,
+                ast_create_node(&ctx->arena, DirectAbstractDeclaratorBrackets, content_t(STATIC), 1, $3));
         }
         |                          LBRACKET STATIC TypeQualifierList AssignmentExpression RBRACKET
         {
-            $$ = ast_create_node(DirectAbstractDeclarator, content_null, 1,
-                ast_create_node(DirectAbstractDeclaratorBrackets, content_t(STATIC), 2, $3, $4));
+            $$ = ast_create_node(&ctx->arena, DirectAbstractDeclarator, content_null, 1,
+                ast_create_node(&ctx->arena, DirectAbstractDeclaratorBrackets, content_t(STATIC), 2, $3, $4));
         }
         |                          LBRACKET TypeQualifierList STATIC AssignmentExpression RBRACKET
         {
-            $$ = ast_create_node(DirectAbstractDeclarator, content_null, 1,
-                ast_create_node(DirectAbstractDeclaratorBrackets, content_t(STATIC), 2, $2, $4));
+            $$ = ast_create_node(&ctx->arena, DirectAbstractDeclarator, content_null, 1,
+                ast_create_node(&ctx->arena, DirectAbstractDeclaratorBrackets, content_t(STATIC), 2, $2, $4));
         }
         |                          LBRACKET ASTERISK RBRACKET
         {
-            $$ = ast_create_node(DirectAbstractDeclarator, content_null, 1,
-                ast_create_node(DirectAbstractDeclaratorBrackets, content_t(ASTERISK), 0));
+            $$ = ast_create_node(&ctx->arena, DirectAbstractDeclarator, content_null, 1,
+                ast_create_node(&ctx->arena, DirectAbstractDeclaratorBrackets, content_t(ASTERISK), 0));
         }
         |                          LPAREN                   RPAREN
         {
-            $$ = ast_create_node(DirectAbstractDeclarator, content_null, 1,
-                ast_create_node(DirectAbstractDeclaratorParen, content_null, 0));
+            $$ = ast_create_node(&ctx->arena, DirectAbstractDeclarator, content_null, 1,
+                ast_create_node(&ctx->arena, DirectAbstractDeclaratorParen, content_null, 0));
         }
         |                          LPAREN ParameterTypeList RPAREN
         {
-            $$ = ast_create_node(DirectAbstractDeclarator, content_null, 1,
-                ast_create_node(DirectAbstractDeclaratorParen, content_null, 1, $2));
+            $$ = ast_create_node(&ctx->arena, DirectAbstractDeclarator, content_null, 1,
+                ast_create_node(&ctx->arena, DirectAbstractDeclaratorParen, content_null, 1, $2));
         }
         | DirectAbstractDeclarator LBRACKET                                               RBRACKET
         {
-            $$ = ast_expand_node($1, ast_create_node(DirectAbstractDeclaratorBrackets, content_null, 0));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, DirectAbstractDeclaratorBrackets, content_null, 0));
         }
         | DirectAbstractDeclarator LBRACKET                          AssignmentExpression RBRACKET
         {
-            $$ = ast_expand_node($1, ast_create_node(DirectAbstractDeclaratorBrackets, content_null, 1, $3));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, DirectAbstractDeclaratorBrackets, content_null, 1, $3));
         }
         | DirectAbstractDeclarator LBRACKET TypeQualifierList                             RBRACKET
         {
-            $$ = ast_expand_node($1, ast_create_node(DirectAbstractDeclaratorBrackets, content_null, 1, $3));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, DirectAbstractDeclaratorBrackets, content_null, 1, $3));
         }
         | DirectAbstractDeclarator LBRACKET TypeQualifierList        AssignmentExpression RBRACKET
         {
-            $$ = ast_expand_node($1, ast_create_node(DirectAbstractDeclaratorBrackets, content_null, 2, $3, $4));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, DirectAbstractDeclaratorBrackets, content_null, 2, $3, $4));
         }
         | DirectAbstractDeclarator LBRACKET                   STATIC AssignmentExpression RBRACKET
         {
-            $$ = ast_expand_node($1, ast_create_node(DirectAbstractDeclaratorBrackets, content_t(STATIC), 1, $4));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, DirectAbstractDeclaratorBrackets, content_t(STATIC), 1, $4));
         }
         | DirectAbstractDeclarator LBRACKET STATIC TypeQualifierList AssignmentExpression RBRACKET
         {
-            $$ = ast_expand_node($1, ast_create_node(DirectAbstractDeclaratorBrackets, content_t(STATIC), 2, $4, $5));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, DirectAbstractDeclaratorBrackets, content_t(STATIC), 2, $4, $5));
         }
         | DirectAbstractDeclarator LBRACKET TypeQualifierList STATIC AssignmentExpression RBRACKET
         {
-            $$ = ast_expand_node($1, ast_create_node(DirectAbstractDeclaratorBrackets, content_t(STATIC), 2, $3, $5));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, DirectAbstractDeclaratorBrackets, content_t(STATIC), 2, $3, $5));
         }
         | DirectAbstractDeclarator LBRACKET ASTERISK RBRACKET
         {
-            $$ = ast_expand_node($1, ast_create_node(DirectAbstractDeclaratorBrackets, content_t(ASTERISK), 0));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, DirectAbstractDeclaratorBrackets, content_t(ASTERISK), 0));
         }
         | DirectAbstractDeclarator LPAREN                   RPAREN
         {
-            $$ = ast_expand_node($1, ast_create_node(DirectAbstractDeclaratorParen, content_null, 0));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, DirectAbstractDeclaratorParen, content_null, 0));
         }
         | DirectAbstractDeclarator LPAREN ParameterTypeList RPAREN
         {
-            $$ = ast_expand_node($1, ast_create_node(DirectAbstractDeclaratorParen, content_null, 1, $3));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, DirectAbstractDeclaratorParen, content_null, 1, $3));
         }
         ;
 
@@ -876,34 +912,34 @@ TypedefName
 Initializer
         : AssignmentExpression
         {
-            $$ = ast_create_node(Initializer, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, Initializer, content_null, 1, $1);
         }
         | LBRACE InitializerList       RBRACE
         {
-            $$ = ast_create_node(Initializer, content_null, 1, $2);
+            $$ = ast_create_node(&ctx->arena, Initializer, content_null, 1, $2);
         }
         | LBRACE InitializerList COMMA RBRACE
         {
-            $$ = ast_create_node(Initializer, content_null, 1, $2);
+            $$ = ast_create_node(&ctx->arena, Initializer, content_null, 1, $2);
         }
         ;
 
 InitializerList
         :                                   Initializer
         {
-            $$ = ast_create_node(InitializerList, content_null, 1, ast_create_node(InitializerListElem, content_null, 1, $1));
+            $$ = ast_create_node(&ctx->arena, InitializerList, content_null, 1, ast_create_node(&ctx->arena, InitializerListElem, content_null, 1, $1));
         }
         |                       Designation Initializer
         {
-            $$ = ast_create_node(InitializerList, content_null, 1, ast_create_node(InitializerListElem, content_null, 2, $1, $2));
+            $$ = ast_create_node(&ctx->arena, InitializerList, content_null, 1, ast_create_node(&ctx->arena, InitializerListElem, content_null, 2, $1, $2));
         }
         | InitializerList COMMA             Initializer
         {
-            $$ = ast_expand_node($1, ast_create_node(InitializerListElem, content_null, 1, $3));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, InitializerListElem, content_null, 1, $3));
         }
         | InitializerList COMMA Designation Initializer
         {
-            $$ = ast_expand_node($1, ast_create_node(InitializerListElem, content_null, 2, $3, $4));
+            $$ = ast_expand_node(&ctx->arena, $1, ast_create_node(&ctx->arena, InitializerListElem, content_null, 2, $3, $4));
         }
         ;
 
@@ -914,11 +950,11 @@ Designation
 DesignatorList
         :                Designator
         {
-            $$ = ast_create_node(DesignatorList, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, DesignatorList, content_null, 1, $1);
         }
         | DesignatorList Designator
         {
-            $$ = ast_expand_node($1, $2);
+            $$ = ast_expand_node(&ctx->arena, $1, $2);
         }
         ;
 
@@ -930,7 +966,7 @@ Designator
 StaticAssertDeclaration
         : STATIC_ASSERT LPAREN ConstantExpression COMMA STRING_LITERAL RPAREN SEMICOLON
         {
-            $$ = ast_create_node(StaticAssertDeclaration, content_null, 2, $3, $5);
+            $$ = ast_create_node(&ctx->arena, StaticAssertDeclaration, content_null, 2, $3, $5);
         }
         ;
 
@@ -948,31 +984,36 @@ Statement
 LabeledStatement
         : IDENTIFIER              COLON Statement
         {
-            $$ = ast_create_node(LabeledStatement, content_null, 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, LabeledStatement, content_null, 2, $1, $3);
         }
         | CASE ConstantExpression COLON Statement
         {
-            $$ = ast_create_node(LabeledStatement, content_t(CASE), 2, $2, $4);
+            $$ = ast_create_node(&ctx->arena, LabeledStatement, content_t(CASE), 2, $2, $4);
         }
         | DEFAULT                 COLON Statement
         {
-            $$ = ast_create_node(LabeledStatement, content_t(DEFAULT), 1, $3);
+            $$ = ast_create_node(&ctx->arena, LabeledStatement, content_t(DEFAULT), 1, $3);
         }
         ;
 
 CompoundStatement
-        : LBRACE               RBRACE  { $$ = NULL; }
-        | LBRACE BlockItemList RBRACE  { $$ = $2; }
+        : BlockBegin               RBRACE  { typedef_scope_pop(&ctx->typedefs); $$ = NULL; }
+        | BlockBegin BlockItemList RBRACE  { typedef_scope_pop(&ctx->typedefs); $$ = $2; }
+        ;
+
+// Block scope of typedef-names
+BlockBegin
+        : LBRACE  { typedef_scope_push(&ctx->typedefs); }
         ;
 
 BlockItemList
         :               BlockItem
         {
-            $$ = ast_create_node(BlockItemList, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, BlockItemList, content_null, 1, $1);
         }
         | BlockItemList BlockItem
         {
-            $$ = ast_expand_node($1, $2);
+            $$ = ast_expand_node(&ctx->arena, $1, $2);
         }
         ;
 
@@ -989,57 +1030,57 @@ ExpressionStatement
 SelectionStatement
         : IF     LPAREN Expression RPAREN Statement %prec NO_ELSE
         {
-            $$ = ast_create_node(SelectionStatement, content_t(IF), 2, $3, $5);
+            $$ = ast_create_node(&ctx->arena, SelectionStatement, content_t(IF), 2, $3, $5);
         }
         | IF     LPAREN Expression RPAREN Statement ELSE Statement
         {
-            $$ = ast_create_node(SelectionStatement, content_t(IF), 3, $3, $5, $7);
+            $$ = ast_create_node(&ctx->arena, SelectionStatement, content_t(IF), 3, $3, $5, $7);
         }
         | SWITCH LPAREN Expression RPAREN Statement
         {
-            $$ = ast_create_node(SelectionStatement, content_t(SWITCH), 2, $3, $5);
+            $$ = ast_create_node(&ctx->arena, SelectionStatement, content_t(SWITCH), 2, $3, $5);
         }
         ;
 
 IterationStatement
         :              WHILE LPAREN Expression RPAREN Statement
         {
-            $$ = ast_create_node(IterationStatement, content_t(WHILE), 2, $3, $5);
+            $$ = ast_create_node(&ctx->arena, IterationStatement, content_t(WHILE), 2, $3, $5);
         }
         | DO Statement WHILE LPAREN Expression RPAREN SEMICOLON
         {
-            $$ = ast_create_node(IterationStatement, content_t(DO), 2, $5, $2);  // Expression first
+            $$ = ast_create_node(&ctx->arena, IterationStatement, content_t(DO), 2, $5, $2);  // Expression first
         }
         | FOR LPAREN ExpressionOpt SEMICOLON ExpressionOpt SEMICOLON ExpressionOpt RPAREN Statement
         {
-            $$ = ast_create_node(IterationStatement, content_t(FOR), 4, $3, $5, $7, $9);
+            $$ = ast_create_node(&ctx->arena, IterationStatement, content_t(FOR), 4, $3, $5, $7, $9);
         }
         | FOR LPAREN Declaration             ExpressionOpt SEMICOLON ExpressionOpt RPAREN Statement
         {
-            $$ = ast_create_node(IterationStatement, content_t(FOR), 3, $3, $4, $6, $8);
+            $$ = ast_create_node(&ctx->arena, IterationStatement, content_t(FOR), 3, $3, $4, $6, $8);
         }
         ;
 
 JumpStatement
         : GOTO IDENTIFIER   SEMICOLON
         {
-            $$ = ast_create_node(JumpStatement, content_t(GOTO), 1, $2);
+            $$ = ast_create_node(&ctx->arena, JumpStatement, content_t(GOTO), 1, $2);
         }
         | CONTINUE          SEMICOLON
         {
-            $$ = ast_create_node(JumpStatement, content_t(CONTINUE), 0);
+            $$ = ast_create_node(&ctx->arena, JumpStatement, content_t(CONTINUE), 0);
         }
         | BREAK             SEMICOLON
         {
-            $$ = ast_create_node(JumpStatement, content_t(BREAK), 0);
+            $$ = ast_create_node(&ctx->arena, JumpStatement, content_t(BREAK), 0);
         }
         | RETURN            SEMICOLON
         {
-            $$ = ast_create_node(JumpStatement, content_t(RETURN), 0);
+            $$ = ast_create_node(&ctx->arena, JumpStatement, content_t(RETURN), 0);
         }
         | RETURN Expression SEMICOLON
         {
-            $$ = ast_create_node(JumpStatement, content_t(RETURN), 1, $2);
+            $$ = ast_create_node(&ctx->arena, JumpStatement, content_t(RETURN), 1, $2);
         }
         ;
 
@@ -1059,11 +1100,11 @@ ExpressionOpt  // Not from a standard
 Expression
         :                  AssignmentExpression
         {
-            $$ = ast_create_node(Expression, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, Expression, content_null, 1, $1);
         }
         | Expression COMMA AssignmentExpression
         {
-            $$ = ast_expand_node($1, $3);
+            $$ = ast_expand_node(&ctx->arena, $1, $3);
         }
         ;
 
@@ -1071,29 +1112,29 @@ AssignmentExpression
         : ConditionalExpression  { $$ = $1; }
         | UnaryExpression AssignmentOperator AssignmentExpression
         {
-            $$ = ast_create_node(AssignmentExpression, content_null, 3, $1, $2, $3);
+            $$ = ast_create_node(&ctx->arena, AssignmentExpression, content_null, 3, $1, $2, $3);
         }
         ;
 
 AssignmentOperator
-        : ASSIGN        { $$ = ast_create_node(AssignmentOperator, content_t(ASSIGN), 0); }
-        | MUL_ASSIGN    { $$ = ast_create_node(AssignmentOperator, content_t(MUL_ASSIGN), 0); }
-        | DIV_ASSIGN    { $$ = ast_create_node(AssignmentOperator, content_t(DIV_ASSIGN), 0); }
-        | MOD_ASSIGN    { $$ = ast_create_node(AssignmentOperator, content_t(MOD_ASSIGN), 0); }
-        | ADD_ASSIGN    { $$ = ast_create_node(AssignmentOperator, content_t(ADD_ASSIGN), 0); }
-        | SUB_ASSIGN    { $$ = ast_create_node(AssignmentOperator, content_t(SUB_ASSIGN), 0); }
-        | LEFT_ASSIGN   { $$ = ast_create_node(AssignmentOperator, content_t(LEFT_ASSIGN), 0); }
-        | RIGHT_ASSIGN  { $$ = ast_create_node(AssignmentOperator, content_t(RIGHT_ASSIGN), 0); }
-        | AND_ASSIGN    { $$ = ast_create_node(AssignmentOperator, content_t(AND_ASSIGN), 0); }
-        | XOR_ASSIGN    { $$ = ast_create_node(AssignmentOperator, content_t(XOR_ASSIGN), 0); }
-        | OR_ASSIGN     { $$ = ast_create_node(AssignmentOperator, content_t(OR_ASSIGN), 0); }
+        : ASSIGN        { $$ = ast_create_node(&ctx->arena, AssignmentOperator, content_t(ASSIGN), 0); }
+        | MUL_ASSIGN    { $$ = ast_create_node(&ctx->arena, AssignmentOperator, content_t(MUL_ASSIGN), 0); }
+        | DIV_ASSIGN    { $$ = ast_create_node(&ctx->arena, AssignmentOperator, content_t(DIV_ASSIGN), 0); }
+        | MOD_ASSIGN    { $$ = ast_create_node(&ctx->arena, AssignmentOperator, content_t(MOD_ASSIGN), 0); }
+        | ADD_ASSIGN    { $$ = ast_create_node(&ctx->arena, AssignmentOperator, content_t(ADD_ASSIGN), 0); }
+        | SUB_ASSIGN    { $$ = ast_create_node(&ctx->arena, AssignmentOperator, content_t(SUB_ASSIGN), 0); }
+        | LEFT_ASSIGN   { $$ = ast_create_node(&ctx->arena, AssignmentOperator, content_t(LEFT_ASSIGN), 0); }
+        | RIGHT_ASSIGN  { $$ = ast_create_node(&ctx->arena, AssignmentOperator, content_t(RIGHT_ASSIGN), 0); }
+        | AND_ASSIGN    { $$ = ast_create_node(&ctx->arena, AssignmentOperator, content_t(AND_ASSIGN), 0); }
+        | XOR_ASSIGN    { $$ = ast_create_node(&ctx->arena, AssignmentOperator, content_t(XOR_ASSIGN), 0); }
+        | OR_ASSIGN     { $$ = ast_create_node(&ctx->arena, AssignmentOperator, content_t(OR_ASSIGN), 0); }
         ;
 
 ConditionalExpression
         : ArithmeticalExpression  { $$ = $1; }
         | ArithmeticalExpression QUESTION Expression COLON ConditionalExpression
         {
-            $$ = ast_create_node(ConditionalExpression, content_null, 3, $1, $3, $5);
+            $$ = ast_create_node(&ctx->arena, ConditionalExpression, content_null, 3, $1, $3, $5);
         }
         ;
 
@@ -1101,75 +1142,75 @@ ArithmeticalExpression
         : CastExpression  { $$ = $1; }
         | ArithmeticalExpression LOG_OR    ArithmeticalExpression
         {
-            $$ = ast_create_node(ArithmeticalExpression, content_t(LOG_OR), 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, ArithmeticalExpression, content_t(LOG_OR), 2, $1, $3);
         }
         | ArithmeticalExpression LOG_AND   ArithmeticalExpression
         {
-            $$ = ast_create_node(ArithmeticalExpression, content_t(LOG_AND), 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, ArithmeticalExpression, content_t(LOG_AND), 2, $1, $3);
         }
         | ArithmeticalExpression VERTICAL  ArithmeticalExpression
         {
-            $$ = ast_create_node(ArithmeticalExpression, content_t(VERTICAL), 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, ArithmeticalExpression, content_t(VERTICAL), 2, $1, $3);
         }
         | ArithmeticalExpression CARET     ArithmeticalExpression
         {
-            $$ = ast_create_node(ArithmeticalExpression, content_t(CARET), 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, ArithmeticalExpression, content_t(CARET), 2, $1, $3);
         }
         | ArithmeticalExpression AMPERSAND ArithmeticalExpression
         {
-            $$ = ast_create_node(ArithmeticalExpression, content_t(AMPERSAND), 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, ArithmeticalExpression, content_t(AMPERSAND), 2, $1, $3);
         }
         | ArithmeticalExpression EQ        ArithmeticalExpression
         {
-            $$ = ast_create_node(ArithmeticalExpression, content_t(EQ), 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, ArithmeticalExpression, content_t(EQ), 2, $1, $3);
         }
         | ArithmeticalExpression NE        ArithmeticalExpression
         {
-            $$ = ast_create_node(ArithmeticalExpression, content_t(NE), 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, ArithmeticalExpression, content_t(NE), 2, $1, $3);
         }
         | ArithmeticalExpression LS        ArithmeticalExpression
         {
-            $$ = ast_create_node(ArithmeticalExpression, content_t(LS), 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, ArithmeticalExpression, content_t(LS), 2, $1, $3);
         }
         | ArithmeticalExpression GR        ArithmeticalExpression
         {
-            $$ = ast_create_node(ArithmeticalExpression, content_t(GR), 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, ArithmeticalExpression, content_t(GR), 2, $1, $3);
         }
         | ArithmeticalExpression LE        ArithmeticalExpression
         {
-            $$ = ast_create_node(ArithmeticalExpression, content_t(LE), 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, ArithmeticalExpression, content_t(LE), 2, $1, $3);
         }
         | ArithmeticalExpression GE        ArithmeticalExpression
         {
-            $$ = ast_create_node(ArithmeticalExpression, content_t(GE), 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, ArithmeticalExpression, content_t(GE), 2, $1, $3);
         }
         | ArithmeticalExpression LSHIFT    ArithmeticalExpression
         {
-            $$ = ast_create_node(ArithmeticalExpression, content_t(LSHIFT), 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, ArithmeticalExpression, content_t(LSHIFT), 2, $1, $3);
         }
         | ArithmeticalExpression RSHIFT    ArithmeticalExpression
         {
-            $$ = ast_create_node(ArithmeticalExpression, content_t(RSHIFT), 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, ArithmeticalExpression, content_t(RSHIFT), 2, $1, $3);
         }
         | ArithmeticalExpression PLUS      ArithmeticalExpression
         {
-            $$ = ast_create_node(ArithmeticalExpression, content_t(PLUS), 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, ArithmeticalExpression, content_t(PLUS), 2, $1, $3);
         }
         | ArithmeticalExpression MINUS     ArithmeticalExpression
         {
-            $$ = ast_create_node(ArithmeticalExpression, content_t(MINUS), 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, ArithmeticalExpression, content_t(MINUS), 2, $1, $3);
         }
         | ArithmeticalExpression ASTERISK  ArithmeticalExpression
         {
-            $$ = ast_create_node(ArithmeticalExpression, content_t(ASTERISK), 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, ArithmeticalExpression, content_t(ASTERISK), 2, $1, $3);
         }
         | ArithmeticalExpression SLASH     ArithmeticalExpression
         {
-            $$ = ast_create_node(ArithmeticalExpression, content_t(SLASH), 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, ArithmeticalExpression, content_t(SLASH), 2, $1, $3);
         }
         | ArithmeticalExpression PERCENT   ArithmeticalExpression
         {
-            $$ = ast_create_node(ArithmeticalExpression, content_t(PERCENT), 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, ArithmeticalExpression, content_t(PERCENT), 2, $1, $3);
         }
         ;
 
@@ -1177,7 +1218,7 @@ CastExpression
         : UnaryExpression  { $$ = $1; }
         | LPAREN TypeName RPAREN CastExpression
         {
-            $$ = ast_create_node(CastExpression, content_null, 2, $2, $4);
+            $$ = ast_create_node(&ctx->arena, CastExpression, content_null, 2, $2, $4);
         }
         ;
 
@@ -1185,87 +1226,87 @@ UnaryExpression
         : PostfixExpression  { $$ = $1; }
         | DBL_PLUS  UnaryExpression
         {
-            $$ = ast_create_node(UnaryExpression, content_t(DBL_PLUS), 1, $2);
+            $$ = ast_create_node(&ctx->arena, UnaryExpression, content_t(DBL_PLUS), 1, $2);
         }
         | DBL_MINUS UnaryExpression
         {
-            $$ = ast_create_node(UnaryExpression, content_t(DBL_MINUS), 1, $2);
+            $$ = ast_create_node(&ctx->arena, UnaryExpression, content_t(DBL_MINUS), 1, $2);
         }
         | UnaryOperator CastExpression
         {
-            $$ = ast_create_node(UnaryExpression, content_null, 2, $1, $2);
+            $$ = ast_create_node(&ctx->arena, UnaryExpression, content_null, 2, $1, $2);
         }
         | SIZEOF  UnaryExpression
         {
-            $$ = ast_create_node(UnaryExpression, content_t(SIZEOF), 1, $2);
+            $$ = ast_create_node(&ctx->arena, UnaryExpression, content_t(SIZEOF), 1, $2);
         }
         | SIZEOF  LPAREN TypeName RPAREN
         {
-            $$ = ast_create_node(UnaryExpression, content_t(SIZEOF), 1, $3);
+            $$ = ast_create_node(&ctx->arena, UnaryExpression, content_t(SIZEOF), 1, $3);
         }
         | ALIGNOF LPAREN TypeName RPAREN
         {
-            $$ = ast_create_node(UnaryExpression, content_t(ALIGNOF), 1, $3);
+            $$ = ast_create_node(&ctx->arena, UnaryExpression, content_t(ALIGNOF), 1, $3);
         }
         ;
 
 UnaryOperator
-        : AMPERSAND    { $$ = ast_create_node(UnaryOperator, content_t(AMPERSAND), 0); }
-        | ASTERISK     { $$ = ast_create_node(UnaryOperator, content_t(ASTERISK), 0); }
-        | PLUS         { $$ = ast_create_node(UnaryOperator, content_t(PLUS), 0); }
-        | MINUS        { $$ = ast_create_node(UnaryOperator, content_t(MINUS), 0); }
-        | TILDE        { $$ = ast_create_node(UnaryOperator, content_t(TILDE), 0); }
-        | EXCLAMATION  { $$ = ast_create_node(UnaryOperator, content_t(EXCLAMATION), 0); }
+        : AMPERSAND    { $$ = ast_create_node(&ctx->arena, UnaryOperator, content_t(AMPERSAND), 0); }
+        | ASTERISK     { $$ = ast_create_node(&ctx->arena, UnaryOperator, content_t(ASTERISK), 0); }
+        | PLUS         { $$ = ast_create_node(&ctx->arena, UnaryOperator, content_t(PLUS), 0); }
+        | MINUS        { $$ = ast_create_node(&ctx->arena, UnaryOperator, content_t(MINUS), 0); }
+        | TILDE        { $$ = ast_create_node(&ctx->arena, UnaryOperator, content_t(TILDE), 0); }
+        | EXCLAMATION  { $$ = ast_create_node(&ctx->arena, UnaryOperator, content_t(EXCLAMATION), 0); }
         ;
 
 PostfixExpression
         : PrimaryExpression  { $$ = $1; }
         | PostfixExpression LBRACKET Expression RBRACKET
         {
-            $$ = ast_create_node(PostfixExpression, content_t(LBRACKET), 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, PostfixExpression, content_t(LBRACKET), 2, $1, $3);
         }
         | PostfixExpression LPAREN                        RPAREN
         {
-            $$ = ast_create_node(PostfixExpression, content_t(LPAREN), 1, $1);
+            $$ = ast_create_node(&ctx->arena, PostfixExpression, content_t(LPAREN), 1, $1);
         }
         | PostfixExpression LPAREN ArgumentExpressionList RPAREN
         {
-            $$ = ast_create_node(PostfixExpression, content_t(LPAREN), 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, PostfixExpression, content_t(LPAREN), 2, $1, $3);
         }
         | PostfixExpression DOT   IDENTIFIER
         {
-            $$ = ast_create_node(PostfixExpression, content_t(DOT), 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, PostfixExpression, content_t(DOT), 2, $1, $3);
         }
         | PostfixExpression ARROW IDENTIFIER
         {
-            $$ = ast_create_node(PostfixExpression, content_t(ARROW), 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, PostfixExpression, content_t(ARROW), 2, $1, $3);
         }
         | PostfixExpression DBL_PLUS
         {
-            $$ = ast_create_node(PostfixExpression, content_t(DBL_PLUS), 1, $1);
+            $$ = ast_create_node(&ctx->arena, PostfixExpression, content_t(DBL_PLUS), 1, $1);
         }
         | PostfixExpression DBL_MINUS
         {
-            $$ = ast_create_node(PostfixExpression, content_t(DBL_MINUS), 1, $1);
+            $$ = ast_create_node(&ctx->arena, PostfixExpression, content_t(DBL_MINUS), 1, $1);
         }
         | LPAREN TypeName RPAREN LBRACE InitializerList       RBRACE
         {
-            $$ = ast_create_node(PostfixExpression, content_null, 2, $2, $5);
+            $$ = ast_create_node(&ctx->arena, PostfixExpression, content_null, 2, $2, $5);
         }
         | LPAREN TypeName RPAREN LBRACE InitializerList COMMA RBRACE
         {
-            $$ = ast_create_node(PostfixExpression, content_null, 2, $2, $5);
+            $$ = ast_create_node(&ctx->arena, PostfixExpression, content_null, 2, $2, $5);
         }
         ;
 
 ArgumentExpressionList
         :                              AssignmentExpression
         {
-            $$ = ast_create_node(ArgumentExpressionList, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, ArgumentExpressionList, content_null, 1, $1);
         }
         | ArgumentExpressionList COMMA AssignmentExpression
         {
-            $$ = ast_expand_node($1, $3);
+            $$ = ast_expand_node(&ctx->arena, $1, $3);
         }
         ;
 
@@ -1281,38 +1322,38 @@ PrimaryExpression
 GenericSelection
         : GENERIC LPAREN AssignmentExpression COMMA GenericAssocList RPAREN
         {
-            $$ = ast_create_node(GenericSelection, content_null, 2, $3, $5);
+            $$ = ast_create_node(&ctx->arena, GenericSelection, content_null, 2, $3, $5);
         }
         ;
 
 GenericAssocList
         :                        GenericAssociation
         {
-            $$ = ast_create_node(GenericAssocList, content_null, 1, $1);
+            $$ = ast_create_node(&ctx->arena, GenericAssocList, content_null, 1, $1);
         }
         | GenericAssocList COMMA GenericAssociation
         {
-            $$ = ast_expand_node($1, $3);
+            $$ = ast_expand_node(&ctx->arena, $1, $3);
         }
         ;
 
 GenericAssociation
         : TypeName COLON AssignmentExpression
         {
-            $$ = ast_create_node(GenericAssociation, content_null, 2, $1, $3);
+            $$ = ast_create_node(&ctx->arena, GenericAssociation, content_null, 2, $1, $3);
         }
         | DEFAULT  COLON AssignmentExpression
         {
-            $$ = ast_create_node(GenericAssociation, content_t(DEFAULT), 1, $3);
+            $$ = ast_create_node(&ctx->arena, GenericAssociation, content_t(DEFAULT), 1, $3);
         }
         ;
 
 %%
 
-int yyerror(void *root, const char *str)
+int yyerror(void *scanner, PARSE_CONTEXT *ctx, const char *str)
 {
-    error_found = true;
-    fprintf(stderr, "%s\n", str);
+    ctx->error_found = true;
+    parse_message(ctx, ctx->file_name, str);
     return 0;
 }
 
@@ -1326,7 +1367,7 @@ _Bool is_typedef_used(AST_NODE *node)
     return false;
 }
 
-void collect_typedef_names(AST_NODE *node)
+void collect_typedef_names(TYPEDEF_TABLE *typedefs, AST_NODE *node)
 {
     if (node->type != InitDeclaratorList) return;
     if (node->children_number < 1) return;
@@ -1344,7 +1385,7 @@ void collect_typedef_names(AST_NODE *node)
         }
         else if (cur_direct_decl->children[0]->type == Identifier)
         {
-            put_typedef_name(cur_direct_decl->children[0]->content.value);
+            put_typedef_name(typedefs, cur_direct_decl->children[0]->content.value);
         }
     }
 }